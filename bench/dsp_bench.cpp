@@ -0,0 +1,702 @@
+// FRANC_bench: throughput of every DSP stage, as samples per second and as a
+// real-time factor against the rate the stage has to sustain on air (1200 bit/s
+// for framing, 48 kHz for audio, 2.4 MSPS for IQ). Results go to stdout as
+// a table and, with --json, to a file for regression tracking. Also reports
+// the error of the NCO backend against the sin()/cos() reference, and runs the
+// output of every modulator variant through the loopback demodulator: the
+// bench exits with 1 if an NCO error is over its limit or any variant stopped
+// producing decodable packets.
+//
+//   FRANC_bench [--json out.json] [--filter substring] [--min-time seconds]
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dsp.h"
+#include "ax25.h"
+#include "nco.h"
+#include "modulator.h"
+#include "demod.h"
+
+typedef std::chrono::steady_clock BenchClock;
+
+const double IQ_SAMPLE_RATE = (double)AUDIO_SAMPLE_RATE * INTERPOLATION;
+
+// information fields of a short status, a typical position report with
+// comment, and a long telemetry/comment packet
+static const char *const PAYLOADS[][2] = {
+    {"short", ">FRANC up"},
+    {"typical", "!4140.93N/08614.12WO/A=001234 FRANC ND Rocketry 21.4C 1013hPa"},
+    {"long", "T#042,123,045,210,077,189,10101010 FRANC flight computer telemetry, "
+             "BME688 21.43C 1013.2hPa 41.2%RH, ENS160 AQI 2, BNO055 0.01 0.02 9.81, "
+             "GPS fix 3D 9 sats HDOP 0.9"},
+};
+
+static const char *CALLSIGN = "KD9WPR";
+static const char *DEST = "APRS";
+static const char *PATH = "WIDE1-1,WIDE2-1";
+
+struct BenchResult
+{
+    std::string name;
+    uint64_t iterations;
+    double seconds;       // total over all iterations
+    double items;         // samples (or bits) per iteration
+    double realtime_rate; // items per second the stage needs on air
+    const char *unit;
+};
+
+struct Accuracy
+{
+    std::string name;
+    double max_abs_error;
+    double rms_error;
+    double limit; // of max_abs_error
+    bool pass;
+};
+
+struct DecodeResult
+{
+    std::string name;
+    int packets;         // sent through the demodulator as modulated
+    int decoded;         // ... and received with every field intact
+    uint64_t fcs_errors; // frames rejected on the way
+    int noisy_packets;   // the same with noise added
+    int noisy_decoded;
+};
+
+// loopback: the typical packet decoded again with white noise added, at
+// this SNR in the 48 kHz band the discriminator sees (the decoder's
+// threshold is ~7 dB), to catch a modulator that is still decodable but
+// degraded
+const int LOOPBACK_NOISY_TRIALS = 10;
+const double LOOPBACK_SNR_DB = 12;
+// the noise is read cyclically from one block, from a different offset
+// per trial
+const size_t LOOPBACK_NOISE_SIZE = 1 << 20;
+const size_t LOOPBACK_NOISE_STRIDE = 100003;
+
+static double min_time = 0.5;
+static std::string filter;
+
+// the result is written somewhere the optimizer can't prove unused
+static volatile float sink;
+
+/**
+ * @brief Runs body until min_time has elapsed (at least once, plus one
+ *        untimed warm-up) and records the throughput.
+ */
+static void run(std::vector<BenchResult> &results, const std::string &name, double items,
+                double realtime_rate, const char *unit, const std::function<void()> &body)
+{
+    if (!filter.empty() && name.find(filter) == std::string::npos)
+    {
+        return;
+    }
+
+    body();
+
+    uint64_t iterations = 0;
+    auto start = BenchClock::now();
+    double elapsed = 0;
+    do
+    {
+        body();
+        iterations++;
+        elapsed = std::chrono::duration<double>(BenchClock::now() - start).count();
+    } while (elapsed < min_time);
+
+    BenchResult r = {name, iterations, elapsed, items, realtime_rate, unit};
+    double rate = items * iterations / elapsed;
+    std::printf("%-44s %10llu it %12.3f us/it %14.0f %s/s %10.1fx RT\n", name.c_str(),
+                (unsigned long long)iterations, elapsed / iterations * 1e6, rate, unit, rate / realtime_rate);
+    results.push_back(r);
+}
+
+// ---------------------------------------------------------------------
+// Stages
+// ---------------------------------------------------------------------
+static void bench_framing(std::vector<BenchResult> &results)
+{
+    for (auto &payload : PAYLOADS)
+    {
+        std::string name = payload[0];
+        const char *info = payload[1];
+
+        char path[64];
+        std::strncpy(path, PATH, sizeof(path) - 1);
+        path[sizeof(path) - 1] = 0;
+        double bits = nrzi(ax25frame(CALLSIGN, DEST, path, info, false)).size();
+
+        run(results, "ax25frame+nrzi/" + name, bits, BAUD_RATE, "bit", [&]()
+            {
+                auto frame = nrzi(ax25frame(CALLSIGN, DEST, path, info, false));
+                sink = frame.size(); });
+
+        PackedBits packed;
+        run(results, "ax25frame_nrzi/" + name, bits, BAUD_RATE, "bit", [&]()
+            {
+                ax25frame_nrzi(CALLSIGN, DEST, PATH, info, packed);
+                sink = packed.size(); });
+    }
+}
+
+static void bench_afsk(std::vector<BenchResult> &results, const PackedBits &bits)
+{
+    double samples = afsk(bits).size();
+    run(results, "afsk/reference", samples, AUDIO_SAMPLE_RATE, "sample", [&]()
+        { sink = afsk(bits).back(); });
+    run(results, "afsk/nco", samples, AUDIO_SAMPLE_RATE, "sample", [&]()
+        { sink = afsk_nco(bits).back(); });
+}
+
+static void bench_fmmod(std::vector<BenchResult> &results, const std::vector<float> &wave)
+{
+    float sensitivity = 2 * M_PI * MAX_DEVIATION / (float)AUDIO_SAMPLE_RATE;
+    Ringbuffer_t ring;
+
+    for (ModulatorBackend backend : {MOD_REFERENCE, MOD_NCO})
+    {
+        auto fm = backend == MOD_NCO ? fmmod_nco : fmmod;
+        run(results, std::string("fmmod/") + (backend == MOD_NCO ? "nco" : "reference"), wave.size(),
+            AUDIO_SAMPLE_RATE, "sample", [&]()
+            {
+                float phase = 0;
+                for (size_t offset = 0; offset < wave.size(); offset += BUFSIZE)
+                {
+                    int n = std::min((size_t)BUFSIZE, wave.size() - offset);
+                    phase = fm(wave.data() + offset, n, ring, sensitivity, phase);
+                    ring.consumerClear();
+                }
+                sink = phase; });
+    }
+}
+
+static void bench_interpolate(std::vector<BenchResult> &results)
+{
+    // one ring of FM output, refilled before every pass
+    std::vector<std::complex<float>> input(BUFSIZE);
+    for (size_t i = 0; i < input.size(); i++)
+    {
+        input[i] = std::polar(1.0f, (float)(0.3 * i));
+    }
+
+    for (FirKernel kernel : {FIR_SCALAR, FIR_SSE, FIR_AVX2, FIR_NEON})
+    {
+        if (!fir_kernel_supported(kernel))
+        {
+            continue;
+        }
+        FIRInterpolator interp(INTERPOLATION, modulator_taps());
+        interp.set_kernel(kernel);
+        Ringbuffer_t ring;
+        std::vector<std::complex<float>> out;
+        out.reserve(input.size() * INTERPOLATION);
+        std::vector<int8_t> s8(input.size() * INTERPOLATION * 2);
+        double pairs = (double)(input.size() - (interp.taps_per_branch() - 1)) * INTERPOLATION;
+
+        run(results, std::string("interpolate/f32/") + fir_kernel_name(kernel), pairs, IQ_SAMPLE_RATE,
+            "pair", [&]()
+            {
+                ring.consumerClear();
+                ring.writeBuff(input.data(), input.size());
+                out.clear();
+                sink = interp.interpolate(ring, out); });
+
+        run(results, std::string("interpolate/s8/") + fir_kernel_name(kernel), pairs, IQ_SAMPLE_RATE,
+            "pair", [&]()
+            {
+                ring.consumerClear();
+                ring.writeBuff(input.data(), input.size());
+                sink = interp.interpolate(ring, s8.data(), s8.size() / 2, SCHAR_MAX); });
+    }
+}
+
+static void bench_resample(std::vector<BenchResult> &results)
+{
+    // the same ring of FM output through the whole chain to each TX rate,
+    // one polyphase stage against the cheapest plan
+    std::vector<std::complex<float>> input(BUFSIZE);
+    for (size_t i = 0; i < input.size(); i++)
+    {
+        input[i] = std::polar(1.0f, (float)(0.3 * i));
+    }
+
+    for (double rate : {2e6, 2.4e6, 8e6})
+    {
+        for (int stages : {1, RESAMPLER_MAX_STAGES})
+        {
+            Resampler resampler(plan_resampler(AUDIO_SAMPLE_RATE, rate, stages));
+            Ringbuffer_t ring;
+            std::vector<int8_t> s8(resampler.block_size() * 2);
+            char name[64];
+            std::snprintf(name, sizeof(name), "resample/s8/%.1fM/%s", rate / 1e6, stages == 1 ? "single" : "auto");
+
+            run(results, name, resampler.output_count(input.size()), rate, "pair", [&]()
+                {
+                    ring.consumerClear();
+                    resampler.reset();
+                    ring.writeBuff(input.data(), input.size());
+                    size_t n, total = 0;
+                    while ((n = resampler.process(ring, s8.data(), s8.size() / 2, SCHAR_MAX)) > 0)
+                    {
+                        total += n;
+                    }
+                    sink = total; });
+        }
+    }
+}
+
+static void bench_fm_chain(std::vector<BenchResult> &results)
+{
+    // one block of AFSK-like audio to int8 IQ at each TX rate: FM at 48 kHz
+    // through the cheapest resampler plan, against the CIC chain
+    std::vector<float> audio(BUFSIZE);
+    for (size_t i = 0; i < audio.size(); i++)
+    {
+        audio[i] = std::sin((float)(2 * M_PI * (i < audio.size() / 2 ? 1200 : 2200) * i / AUDIO_SAMPLE_RATE));
+    }
+    const float sensitivity = 2 * M_PI * MAX_DEVIATION / (float)AUDIO_SAMPLE_RATE;
+
+    for (double rate : {2e6, 2.4e6, 8e6})
+    {
+        ResamplerPlan plan = plan_resampler(AUDIO_SAMPLE_RATE, rate);
+        char name[64];
+
+        Resampler resampler(plan);
+        Ringbuffer_t ring;
+        std::vector<int8_t> s8(resampler.block_size() * 2);
+        std::snprintf(name, sizeof(name), "fm_chain/s8/%.1fM/iq", rate / 1e6);
+        run(results, name, resampler.output_count(audio.size()), rate, "pair", [&]()
+            {
+                ring.consumerClear();
+                resampler.reset();
+                fmmod_nco(audio.data(), audio.size(), ring, sensitivity, 0);
+                size_t n, total = 0;
+                while ((n = resampler.process(ring, s8.data(), s8.size() / 2, SCHAR_MAX)) > 0)
+                {
+                    total += n;
+                }
+                sink = total; });
+
+        CicFmInterpolator cic(plan.interpolation(), plan.decimation(), sensitivity);
+        std::vector<int8_t> cic_s8(cic.output_count(audio.size(), 0) * 2);
+        std::snprintf(name, sizeof(name), "fm_chain/s8/%.1fM/cic", rate / 1e6);
+        run(results, name, cic.output_count(audio.size(), 0), rate, "pair", [&]()
+            {
+                cic.reset();
+                sink = cic.process(audio.data(), audio.size(), cic_s8.data()); });
+    }
+}
+
+static void bench_f32_to_s8(std::vector<BenchResult> &results)
+{
+    std::vector<std::complex<float>> iq((size_t)BUFSIZE * INTERPOLATION);
+    for (size_t i = 0; i < iq.size(); i++)
+    {
+        iq[i] = std::polar(0.99f, (float)(0.01 * i));
+    }
+    std::vector<int8_t> out(iq.size() * 2);
+    run(results, "f32_to_s8", iq.size(), IQ_SAMPLE_RATE, "pair", [&]()
+        {
+            f32_to_s8(iq.data(), iq.size(), out.data());
+            sink = out.back(); });
+}
+
+static void bench_modulate(std::vector<BenchResult> &results)
+{
+    for (ModulatorBackend backend : {MOD_REFERENCE, MOD_NCO})
+    {
+        const char *backend_name = backend == MOD_NCO ? "nco" : "reference";
+        Modulator modulator(backend);
+
+        for (auto &payload : PAYLOADS)
+        {
+            const char *info = payload[1];
+            PackedBits bits;
+            ax25frame_nrzi(CALLSIGN, DEST, PATH, info, bits);
+            std::vector<float> wave = backend == MOD_NCO ? afsk_nco(bits) : afsk(bits);
+
+            for (OutputFormat fmt : {IQ_S8, IQ_F32})
+            {
+                std::string suffix = std::string(fmt == IQ_S8 ? "s8/" : "f32/") + backend_name + "/" + payload[0];
+                double pairs = modulator.packet_size(CALLSIGN, DEST, PATH, info, fmt) /
+                               (fmt == IQ_S8 ? 2.0 : sizeof(std::complex<float>));
+                size_t bytes = 0;
+                IQWriter count = [&bytes](const void *, size_t size)
+                { bytes += size; };
+
+                // the whole chain from an AFSK waveform, as the old per-packet path did
+                run(results, "modulate/" + suffix, pairs, IQ_SAMPLE_RATE, "pair", [&]()
+                    {
+                        modulator.modulate(wave, count, fmt);
+                        sink = bytes; });
+
+                // framing + AFSK + FM + interpolation, with the preamble cache warm
+                run(results, "modulate_packet/" + suffix, pairs, IQ_SAMPLE_RATE, "pair", [&]()
+                    {
+                        modulator.modulate_packet(CALLSIGN, DEST, PATH, info, count, fmt);
+                        sink = bytes; });
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------
+// Loopback: modulator output decoded by AfskDemodulator
+// ---------------------------------------------------------------------
+static std::vector<uint8_t> modulated(Modulator &modulator, const char *info, OutputFormat fmt)
+{
+    std::vector<uint8_t> bytes;
+    modulator.modulate_packet(CALLSIGN, DEST, PATH, info, [&bytes](const void *data, size_t size)
+                              {
+                                  const uint8_t *p = static_cast<const uint8_t *>(data);
+                                  bytes.insert(bytes.end(), p, p + size); }, fmt);
+    return bytes;
+}
+
+static size_t pairs_of(const std::vector<uint8_t> &bytes, OutputFormat fmt)
+{
+    return bytes.size() / (fmt == IQ_S8 ? 2 : sizeof(std::complex<float>));
+}
+
+static void demodulate(AfskDemodulator &demod, const std::vector<uint8_t> &bytes, OutputFormat fmt)
+{
+    demod.reset();
+    if (fmt == IQ_S8)
+    {
+        demod.process(reinterpret_cast<const int8_t *>(bytes.data()), pairs_of(bytes, fmt));
+    }
+    else
+    {
+        demod.process(reinterpret_cast<const std::complex<float> *>(bytes.data()), pairs_of(bytes, fmt));
+    }
+}
+
+static bool received(const AfskDemodulator &demod, const char *info)
+{
+    if (demod.packets().size() != 1)
+    {
+        return false;
+    }
+    const Ax25Packet &p = demod.packets()[0];
+    return p.callsign == CALLSIGN && p.dest == DEST && p.path == PATH && p.info == info;
+}
+
+static void bench_demodulate(std::vector<BenchResult> &results)
+{
+    // the demodulator's cost only depends on the rate and the input format
+    for (double rate : {2e6, 2.4e6, 8e6})
+    {
+        Modulator modulator(MOD_NCO, AX25_PREAMBLE_FLAGS, SILENCE_MS, rate);
+        AfskDemodulator demod(modulator.sample_rate());
+        for (OutputFormat fmt : {IQ_S8, IQ_F32})
+        {
+            std::vector<uint8_t> bytes = modulated(modulator, PAYLOADS[1][1], fmt);
+            char name[64];
+            std::snprintf(name, sizeof(name), "demodulate/%s/%.1fM", fmt == IQ_S8 ? "s8" : "f32", rate / 1e6);
+            run(results, name, pairs_of(bytes, fmt), rate, "pair", [&]()
+                {
+                    demodulate(demod, bytes, fmt);
+                    sink = demod.packets().size(); });
+        }
+    }
+}
+
+static void loopback(std::vector<DecodeResult> &decodes)
+{
+    // unit variance
+    std::vector<std::complex<float>> noise(LOOPBACK_NOISE_SIZE);
+    std::mt19937 rng(1);
+    std::normal_distribution<float> gauss(0, 1);
+    for (auto &n : noise)
+    {
+        n = std::complex<float>(gauss(rng), gauss(rng));
+    }
+
+    for (double rate : {2e6, 2.4e6, 8e6})
+    {
+        for (ModulatorChain chain : {CHAIN_IQ, CHAIN_CIC})
+        {
+            for (ModulatorBackend backend : {MOD_REFERENCE, MOD_NCO})
+            {
+                Modulator modulator(backend, AX25_PREAMBLE_FLAGS, SILENCE_MS, rate, RESAMPLER_MAX_STAGES, chain);
+                AfskDemodulator demod(modulator.sample_rate());
+                // noise per IQ sample for LOOPBACK_SNR_DB after averaging decimation() of them
+                float sigma = std::sqrt(demod.decimation() / std::pow(10.0f, (float)LOOPBACK_SNR_DB / 10) / 2);
+
+                for (OutputFormat fmt : {IQ_S8, IQ_F32})
+                {
+                    char name[64];
+                    std::snprintf(name, sizeof(name), "loopback/%s/%s/%s/%.1fM", fmt == IQ_S8 ? "s8" : "f32",
+                                  backend == MOD_NCO ? "nco" : "reference", chain == CHAIN_CIC ? "cic" : "iq",
+                                  rate / 1e6);
+                    if (!filter.empty() && std::string(name).find(filter) == std::string::npos)
+                    {
+                        continue;
+                    }
+
+                    DecodeResult r = {name, 0, 0, 0, 0, 0};
+                    for (auto &payload : PAYLOADS)
+                    {
+                        const char *info = payload[1];
+                        std::vector<uint8_t> bytes = modulated(modulator, info, fmt);
+                        demodulate(demod, bytes, fmt);
+                        r.packets++;
+                        r.decoded += received(demod, info);
+                        r.fcs_errors += demod.fcs_errors();
+                        if (payload[1] != PAYLOADS[1][1])
+                        {
+                            continue;
+                        }
+
+                        // the same samples as the demodulator sees them, plus noise
+                        std::vector<std::complex<float>> iq(pairs_of(bytes, fmt));
+                        const int8_t *s8 = reinterpret_cast<const int8_t *>(bytes.data());
+                        for (size_t i = 0; i < iq.size(); i++)
+                        {
+                            iq[i] = fmt == IQ_S8 ? std::complex<float>(s8[2 * i], s8[2 * i + 1]) / 127.0f
+                                                 : reinterpret_cast<const std::complex<float> *>(bytes.data())[i];
+                        }
+                        std::vector<std::complex<float>> noisy(iq.size());
+                        for (int trial = 0; trial < LOOPBACK_NOISY_TRIALS; trial++)
+                        {
+                            size_t offset = trial * LOOPBACK_NOISE_STRIDE;
+                            for (size_t i = 0; i < iq.size(); i++)
+                            {
+                                noisy[i] = iq[i] + sigma * noise[(offset + i) % LOOPBACK_NOISE_SIZE];
+                            }
+                            demod.reset();
+                            demod.process(noisy.data(), noisy.size());
+                            r.noisy_packets++;
+                            r.noisy_decoded += received(demod, info);
+                        }
+                    }
+                    std::printf("%-44s %d/%d decoded, %llu FCS errors, %5.1f%% at %.0f dB SNR\n", name, r.decoded,
+                                r.packets, (unsigned long long)r.fcs_errors, 100.0 * r.noisy_decoded / r.noisy_packets,
+                                LOOPBACK_SNR_DB);
+                    decodes.push_back(r);
+                }
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------
+// NCO accuracy against the sin()/cos() reference
+// ---------------------------------------------------------------------
+// max_abs_error limits, with some margin over what the 1024 entry table
+// with linear interpolation gives (7.7e-4, 1.1e-3 and 7.8e-4)
+const double NCO_SINCOS_LIMIT = 1e-3;
+const double NCO_AFSK_LIMIT = 2e-3;
+const double NCO_FMMOD_LIMIT = 1.5e-3;
+
+static Accuracy error_of(const std::string &name, const std::vector<float> &a, const std::vector<float> &b,
+                         double limit)
+{
+    double max_err = 0, sum_sq = 0;
+    size_t n = std::min(a.size(), b.size());
+    for (size_t i = 0; i < n; i++)
+    {
+        double e = std::fabs((double)a[i] - b[i]);
+        max_err = std::max(max_err, e);
+        sum_sq += e * e;
+    }
+    return {name, max_err, n ? std::sqrt(sum_sq / n) : 0, limit, max_err <= limit};
+}
+
+static void nco_accuracy(std::vector<Accuracy> &accuracy, const PackedBits &bits, const std::vector<float> &wave)
+{
+    if (!filter.empty() && std::string("accuracy").find(filter) == std::string::npos)
+    {
+        return;
+    }
+
+    // table lookup over one turn, far off the table grid
+    const float *table = nco_sin_table();
+    std::vector<float> ref, nco;
+    const uint32_t step = 0x9E3779B9u >> 8;
+    for (uint32_t i = 0, phase = 0; i < (1u << 20); i++, phase += step)
+    {
+        ref.push_back(std::sin(nco_radians(phase)));
+        nco.push_back(nco_sin(table, phase));
+        ref.push_back(std::cos(nco_radians(phase)));
+        nco.push_back(nco_cos(table, phase));
+    }
+    accuracy.push_back(error_of("nco/sincos", ref, nco, NCO_SINCOS_LIMIT));
+
+    accuracy.push_back(error_of("afsk/nco_vs_reference", wave, afsk_nco(bits), NCO_AFSK_LIMIT));
+
+    // FM: I/Q of both backends over the same audio
+    float sensitivity = 2 * M_PI * MAX_DEVIATION / (float)AUDIO_SAMPLE_RATE;
+    std::vector<float> fm[2];
+    for (int backend = 0; backend < 2; backend++)
+    {
+        Ringbuffer_t ring;
+        float phase = 0;
+        for (size_t offset = 0; offset < wave.size(); offset += BUFSIZE)
+        {
+            int n = std::min((size_t)BUFSIZE, wave.size() - offset);
+            phase = (backend ? fmmod_nco : fmmod)(wave.data() + offset, n, ring, sensitivity, phase);
+            std::complex<float> s;
+            while (ring.remove(s))
+            {
+                fm[backend].push_back(s.real());
+                fm[backend].push_back(s.imag());
+            }
+        }
+    }
+    accuracy.push_back(error_of("fmmod/nco_vs_reference", fm[0], fm[1], NCO_FMMOD_LIMIT));
+
+    for (auto &a : accuracy)
+    {
+        std::printf("%-44s max %.3e rms %.3e (limit %.1e) %s\n", ("accuracy/" + a.name).c_str(), a.max_abs_error,
+                    a.rms_error, a.limit, a.pass ? "ok" : "FAIL");
+    }
+}
+
+// ---------------------------------------------------------------------
+// JSON report
+// ---------------------------------------------------------------------
+static bool write_json(const std::string &path, const std::vector<BenchResult> &results,
+                       const std::vector<Accuracy> &accuracy, const std::vector<DecodeResult> &decodes)
+{
+    FILE *f = std::fopen(path.c_str(), "w");
+    if (!f)
+    {
+        std::fprintf(stderr, "Cannot write '%s'\n", path.c_str());
+        return false;
+    }
+
+    std::time_t now = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    std::fprintf(f, "{\n  \"context\": {\n");
+    std::fprintf(f, "    \"date\": \"%s\",\n", date);
+#ifdef BUILD_DATE
+    std::fprintf(f, "    \"build_date\": \"%s\",\n", BUILD_DATE);
+#endif
+    std::fprintf(f, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+    std::fprintf(f, "    \"fir_kernel\": \"%s\",\n", fir_kernel_name(fir_best_kernel()));
+    std::fprintf(f, "    \"iq_sample_rate\": %.0f,\n", IQ_SAMPLE_RATE);
+    std::fprintf(f, "    \"min_time_s\": %g\n  },\n", min_time);
+
+    std::fprintf(f, "  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult &r = results[i];
+        double rate = r.items * r.iterations / r.seconds;
+        std::fprintf(f, "    {\"name\": \"%s\", \"iterations\": %llu, \"time_per_iteration_ns\": %.1f, "
+                        "\"items_per_iteration\": %.0f, \"unit\": \"%s\", \"items_per_second\": %.1f, "
+                        "\"realtime_factor\": %.3f}%s\n",
+                     r.name.c_str(), (unsigned long long)r.iterations, r.seconds / r.iterations * 1e9, r.items,
+                     r.unit, rate, rate / r.realtime_rate, i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(f, "  ],\n  \"accuracy\": [\n");
+    for (size_t i = 0; i < accuracy.size(); i++)
+    {
+        const Accuracy &a = accuracy[i];
+        std::fprintf(f, "    {\"name\": \"%s\", \"max_abs_error\": %.6e, \"rms_error\": %.6e, \"limit\": %.6e, "
+                        "\"pass\": %s}%s\n",
+                     a.name.c_str(), a.max_abs_error, a.rms_error, a.limit, a.pass ? "true" : "false",
+                     i + 1 < accuracy.size() ? "," : "");
+    }
+    std::fprintf(f, "  ],\n  \"decode\": [\n");
+    for (size_t i = 0; i < decodes.size(); i++)
+    {
+        const DecodeResult &d = decodes[i];
+        std::fprintf(f, "    {\"name\": \"%s\", \"packets\": %d, \"decoded\": %d, \"fcs_errors\": %llu, "
+                        "\"noisy_snr_db\": %.1f, \"noisy_packets\": %d, \"noisy_decoded\": %d}%s\n",
+                     d.name.c_str(), d.packets, d.decoded, (unsigned long long)d.fcs_errors, LOOPBACK_SNR_DB,
+                     d.noisy_packets, d.noisy_decoded, i + 1 < decodes.size() ? "," : "");
+    }
+    std::fprintf(f, "  ]\n}\n");
+    std::fclose(f);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string json;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!std::strcmp(argv[i], "--json") && i + 1 < argc)
+        {
+            json = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--filter") && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--min-time") && i + 1 < argc)
+        {
+            min_time = std::atof(argv[++i]);
+        }
+        else
+        {
+            std::fprintf(stderr, "Usage: %s [--json out.json] [--filter substring] [--min-time seconds]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::printf("FRANC_bench: FIR kernel %s, real time = %d bit/s, %d Hz audio, %.0f IQ pairs/s\n\n",
+                fir_kernel_name(fir_best_kernel()), BAUD_RATE, AUDIO_SAMPLE_RATE, IQ_SAMPLE_RATE);
+
+    // the typical packet drives the per-stage benchmarks
+    PackedBits bits;
+    ax25frame_nrzi(CALLSIGN, DEST, PATH, PAYLOADS[1][1], bits);
+    std::vector<float> wave = afsk(bits);
+
+    std::vector<BenchResult> results;
+    bench_framing(results);
+    bench_afsk(results, bits);
+    bench_fmmod(results, wave);
+    bench_interpolate(results);
+    bench_resample(results);
+    bench_fm_chain(results);
+    bench_f32_to_s8(results);
+    bench_modulate(results);
+    bench_demodulate(results);
+
+    std::vector<Accuracy> accuracy;
+    nco_accuracy(accuracy, bits, wave);
+
+    std::vector<DecodeResult> decodes;
+    loopback(decodes);
+
+    if (!json.empty() && !write_json(json, results, accuracy, decodes))
+    {
+        return 1;
+    }
+    for (auto &a : accuracy)
+    {
+        if (!a.pass)
+        {
+            std::fprintf(stderr, "%s: max error %.3e over the limit of %.1e\n", a.name.c_str(), a.max_abs_error,
+                         a.limit);
+            return 1;
+        }
+    }
+    for (auto &d : decodes)
+    {
+        if (d.decoded < d.packets)
+        {
+            std::fprintf(stderr, "%s: %d of %d packets not decoded\n", d.name.c_str(), d.packets - d.decoded,
+                         d.packets);
+            return 1;
+        }
+    }
+    return 0;
+}
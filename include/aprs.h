@@ -6,20 +6,50 @@
 #include <unistd.h>
 #include <cstdint>
 #include <climits>
+#include <functional>
 #include "ax25.h"
 #include "dsp.h"
-
-typedef enum
-{
-    IQ_S8,
-    IQ_F32,
-    PCM_F32,
-} OutputFormat;
+#include "modulator.h"
+#include "iqstream.h"
 
 void usage();
-std::vector<int8_t> f32_to_s8(const std::vector<std::complex<float>> &input);
-void modulate(const std::vector<float> &waveform, FILE *fout, OutputFormat iq_sf);
+
+// one-shot helpers on the calling thread's default_modulator()
+void modulate(const std::vector<float> &waveform, const IQWriter &write, OutputFormat iq_sf,
+              ModulatorBackend backend = MOD_REFERENCE);
+void modulate(const std::vector<float> &waveform, FILE *fout, OutputFormat iq_sf,
+              ModulatorBackend backend = MOD_REFERENCE);
+// IQ_S8 only: feeds the samples to the HackRF TX callback and closes the stream when done
+void modulate(const std::vector<float> &waveform, IQStream &stream,
+              ModulatorBackend backend = MOD_REFERENCE);
 
 extern "C" {
+    // legacy: malloc()ed IQ_S8 packet, caller free()s it; prefer the gen_iq_s8_ctx API below
     int8_t *gen_iq_s8(const char *callsign, const char *user_path, const char *info, int32_t *total);
+
+    /*
+     * Reusable IQ_S8 generator: keeps its own Modulator (preamble cache, FIR
+     * state, block buffers), so repeated packets do not allocate. One context
+     * per thread; destination is always "APRS", as in gen_iq_s8().
+     *
+     * Sizes are in bytes (two per I/Q pair). Functions returning int64_t
+     * return -1 on a NULL context or argument.
+     */
+    typedef struct gen_iq_s8_ctx gen_iq_s8_ctx;
+
+    gen_iq_s8_ctx *gen_iq_s8_create(void);
+    void gen_iq_s8_destroy(gen_iq_s8_ctx *ctx);
+
+    // exact output size of the packet, without modulating it
+    int64_t gen_iq_s8_size(gen_iq_s8_ctx *ctx, const char *callsign, const char *user_path, const char *info);
+
+    // whole packet into out; returns its size, or -size (writing nothing) if
+    // capacity is too small
+    int64_t gen_iq_s8_generate_into(gen_iq_s8_ctx *ctx, const char *callsign, const char *user_path,
+                                    const char *info, int8_t *out, int64_t capacity);
+
+    // chunked output: begin returns the packet size, then read fills up to
+    // capacity bytes per call and returns the count, 0 once the packet is done
+    int64_t gen_iq_s8_begin(gen_iq_s8_ctx *ctx, const char *callsign, const char *user_path, const char *info);
+    int64_t gen_iq_s8_read(gen_iq_s8_ctx *ctx, int8_t *out, int64_t capacity);
 }
\ No newline at end of file
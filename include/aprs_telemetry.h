@@ -0,0 +1,113 @@
+#ifndef APRS_TELEMETRY_H
+#define APRS_TELEMETRY_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "master_sensor_struct.h"
+
+// analog channels of an APRS telemetry report, fixed by the format
+const int APRS_TELEMETRY_CHANNELS = 5;
+// digital channels (the bbbbbbbb field)
+const int APRS_TELEMETRY_BITS = 8;
+// AX.25 information field limit
+const size_t APRS_INFO_MAX = 256;
+// default deadband, in quantization steps of each field: 0.5 re-formats a
+// field exactly when its rounded value changes, more adds hysteresis
+const float APRS_TELEMETRY_DEADBAND = 0.5f;
+// PARM/UNIT/EQNS/BITS are repeated every this many reports
+const int APRS_METADATA_EVERY = 20;
+
+/**
+ * @brief Builds APRS telemetry from MasterSensorData, re-formatting only
+ *        what changed.
+ *
+ * report() gives the "T#sss,aaa,aaa,aaa,aaa,aaa,bbbbbbbb" report. Every
+ * field has a fixed-width slot in one buffer (analog values are 8-bit
+ * counts, scaled by the EQNS message), and a slot is rewritten only when
+ * its value moved more than the deadband away from the count it was last
+ * written with. The
+ * separators never move.
+ *
+ * status() gives the same fields at display resolution as a ">" status,
+ * in place of a position report (the flight computer has no GPS fix in
+ * MasterSensorData). Each field keeps its text; only changed fields are
+ * re-formatted, then the texts are joined into a fixed buffer.
+ *
+ * metadata() holds the PARM/UNIT/EQNS/BITS messages that tell receivers
+ * how to read the report. They are addressed to the sending station and
+ * rebuilt only when its callsign changes.
+ *
+ * Numbers are formatted with std::to_chars on scaled integers; nothing is
+ * allocated after construction. Every returned string stays valid until
+ * the next call that rebuilds it, and is meant to be passed straight to
+ * ax25frame()/modulate_packet().
+ */
+class AprsTelemetry
+{
+public:
+    explicit AprsTelemetry(float deadband = APRS_TELEMETRY_DEADBAND);
+
+    // in quantization steps; negative values are treated as 0 (always re-format)
+    void set_deadband(float steps);
+    float deadband() const { return deadband_steps; }
+
+    // station the metadata messages are addressed to (the sending callsign)
+    void set_addressee(const char *callsign);
+
+    // telemetry report of data with the next sequence number
+    const char *report(const MasterSensorData &data);
+
+    // status text of data
+    const char *status(const MasterSensorData &data);
+
+    // PARM, UNIT, EQNS and BITS messages, in that order
+    static const int METADATA_COUNT = 4;
+    const char *metadata(int index) const { return meta[index]; }
+
+    // true if the report about to be built should be preceded by metadata
+    bool metadata_due(int every) const { return sequence == 0 || (every > 0 && sequence % every == 0); }
+
+    // fields re-formatted and fields left as they were, over all calls
+    uint64_t formatted() const { return formatted_count; }
+    uint64_t skipped() const { return skipped_count; }
+
+private:
+    struct Held
+    {
+        long long count; // quantization steps the text/count was made from
+        bool valid;      // false until the first finite value
+    };
+    // true if steps (a value in quantization steps) moved more than the
+    // deadband away from the held count; the held count is then its rounding
+    bool changed(Held &held, double steps);
+    void build_metadata();
+
+    float deadband_steps;
+    unsigned sequence; // 0..999
+
+    char addressee[10]; // callsign, 9 characters space padded
+    char meta[METADATA_COUNT][APRS_INFO_MAX];
+
+    // report: "T#" + 3 digit sequence + 5 * ",ccc" + "," + 8 bits
+    char report_buf[2 + 3 + APRS_TELEMETRY_CHANNELS * 4 + 1 + APRS_TELEMETRY_BITS + 1];
+    Held analog[APRS_TELEMETRY_CHANNELS];
+    int bits[APRS_TELEMETRY_BITS];
+
+    // status: one text per field, joined on every call
+    static const int STATUS_FIELDS = 5;
+    static const int STATUS_FIELD_MAX = 24;
+    struct StatusField
+    {
+        Held held;
+        char text[STATUS_FIELD_MAX];
+        size_t length;
+    };
+    StatusField fields[STATUS_FIELDS];
+    char status_buf[APRS_INFO_MAX];
+
+    uint64_t formatted_count;
+    uint64_t skipped_count;
+};
+
+#endif // APRS_TELEMETRY_H
@@ -1,8 +1,50 @@
 #ifndef __AX25_H__
 #define __AX25_H__
 #include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "packed_bits.h"
 
+// zero bits (alternating tones after NRZI) sent ahead of the flags for clock sync
+const int AX25_SYNC_BITS = 20;
+// 0x7e flags sent ahead of the frame
+const int AX25_PREAMBLE_FLAGS = 100;
+// frame sizes between flags, FCS included: dest + source + control +
+// protocol + FCS at least, 8 digipeaters and 256 info bytes at most
+const size_t AX25_MIN_FRAME = 7 * 2 + 2 + 2;
+const size_t AX25_MAX_FRAME = 7 * 10 + 2 + 256 + 2;
+
+// reference implementation: one std::vector<bool> per stage
 std::vector<bool> ax25frame(const char *callsign, const char *dest, char *path, const char *info, bool debug);
 std::vector<bool> nrzi(const std::vector<bool> &data);
 
+// table-driven CRC-16/X.25, the AX.25 frame check sequence
+uint16_t ax25_fcs(const uint8_t *data, size_t len);
+
+// nrzi(ax25frame(...)) in a single pass: the frame bytes are bit stuffed and
+// NRZI encoded straight into `out` (cleared first). `path` is not modified.
+void ax25frame_nrzi(const char *callsign, const char *dest, const char *path, const char *info,
+                    PackedBits &out, int preamble_flags = AX25_PREAMBLE_FLAGS);
+
+// ax25frame_nrzi() split in two, so the constant preamble can be generated
+// once: the sync bits + flags, and the stuffed frame + closing flag starting
+// from the NRZI level the preamble ended on. Both return the final NRZI level.
+bool ax25preamble_nrzi(PackedBits &out, int preamble_flags = AX25_PREAMBLE_FLAGS);
+bool ax25payload_nrzi(const char *callsign, const char *dest, const char *path, const char *info,
+                      PackedBits &out, bool level);
+
+// the fields of a received UI frame, in the form ax25frame() takes them
+struct Ax25Packet
+{
+    std::string callsign;
+    std::string dest;
+    std::string path; // "WIDE1-1,WIDE2-1", empty without digipeaters
+    std::string info;
+};
+
+// splits a frame (between the flags, FCS included but not checked) into its
+// fields; false if the address field is malformed or no UI frame follows it
+bool ax25_parse(const uint8_t *frame, size_t len, Ax25Packet &packet);
+
 #endif
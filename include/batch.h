@@ -0,0 +1,66 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "logger.h"
+#include "modulator.h"
+
+/**
+ * @brief Modulates a queue of APRS packets in parallel into one continuous burst.
+ *
+ * Every packet is encoded and modulated by one of `workers` threads, each with
+ * its own Modulator (FIR history, FM phase, preamble cache), into its own
+ * buffer. The calling thread writes the packets out in queue order as soon as
+ * each one is done, so TX can start while later packets are still modulating.
+ *
+ * Packets are separated by gap_ms of unmodulated carrier (each packet is
+ * framed with gap_ms / 2 of silence on both sides) and the burst as a whole
+ * keeps silence_ms of carrier at both ends, so the transmitter keys up once.
+ */
+class BatchEncoder
+{
+public:
+    // workers <= 0 uses one thread per core; sample_rate, resampler_stages and
+    // chain as for Modulator
+    BatchEncoder(quill::Logger *logger, ModulatorBackend backend, int preamble_flags, int silence_ms,
+                 int gap_ms, int workers, double sample_rate = DEFAULT_IQ_RATE,
+                 int resampler_stages = RESAMPLER_MAX_STAGES, ModulatorChain chain = CHAIN_IQ);
+    ~BatchEncoder();
+
+    BatchEncoder(const BatchEncoder &) = delete;
+    BatchEncoder &operator=(const BatchEncoder &) = delete;
+
+    /**
+     * @brief Modulates one packet per entry of infos and hands the burst to
+     *        write in order. Returns the number of bytes written.
+     */
+    size_t encode(const char *callsign, const char *dest, const char *path,
+                  const std::vector<std::string> &infos, const IQWriter &write, OutputFormat iq_sf);
+
+private:
+    // size bytes of unit (one period of the last/first samples) repeated,
+    // starting offset bytes into the period
+    void write_carrier(const uint8_t *unit, size_t unit_size, size_t offset, size_t size, const IQWriter &write);
+
+    quill::Logger *logger;
+    ModulatorBackend backend;
+    int preamble_flags;
+    int packet_silence_ms; // per packet, half the gap
+    int pad_ms;            // extra carrier at both ends of the burst
+    size_t workers;
+    double sample_rate;
+    int resampler_stages;
+    ModulatorChain chain;
+
+    // created on first use, at most one per packet in flight
+    std::vector<std::unique_ptr<Modulator>> modulators;
+    // per-packet output, capacity kept across bursts
+    std::vector<std::vector<uint8_t>> outputs;
+    std::vector<uint8_t> carrier;
+};
+
+#endif // BATCH_H
@@ -0,0 +1,71 @@
+#ifndef CIC_H
+#define CIC_H
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+
+// order of the CIC interpolator; images of the 1200/2200 Hz tones around
+// multiples of 48 kHz come out ~80 dB down. process() has the closed form
+// of exactly three integrators.
+const int CIC_ORDER = 3;
+
+/**
+ * @brief FM modulation at the output rate: the real audio is interpolated
+ *        by a CIC and integrated into an NCO phase sample by sample.
+ *
+ * The alternative to FM at 48 kHz + complex polyphase FIR (Resampler). The
+ * audio is narrowband, so interpolating it instead of the IQ costs a few
+ * integer adds per output: a 3 tap inverse-sinc FIR at the input rate undoes
+ * the CIC droop, the combs run at the input rate, and per tick of the
+ * interpolation grid the integrators (and the phase, a 4th integrator) only
+ * ever add a zero-stuffed input, so they are evaluated in closed form on the
+ * ticks that land on the output grid: with decimation > 1 (rational L/M
+ * rates) the ticks in between cost nothing.
+ *
+ * All of it is wrapping 64-bit integer arithmetic, exact modulo 2^64, so the
+ * CIC never drifts; the last integrator is scaled to be the phase step in
+ * nco.h accumulator units << 32.
+ * No history is dropped: n inputs from reset() give output_count(n) outputs.
+ */
+class CicFmInterpolator
+{
+public:
+    // sensitivity: radians per unit of input per input sample, as for fmmod()
+    CicFmInterpolator(int interpolation, int decimation, float sensitivity);
+
+    // modulates count input samples, returns output_count(count) outputs
+    size_t process(const float *input, size_t count, std::complex<float> *output);
+    // interleaved int8 I/Q, the same values f32_to_s8() gives for the above
+    size_t process(const float *input, size_t count, int8_t *output);
+
+    // outputs for count more inputs from the current grid position
+    size_t output_count(size_t count) const { return output_count(count, st.grid); }
+    size_t output_count(size_t count, int grid) const;
+
+    struct State
+    {
+        float history[2];            // compensation FIR input
+        uint64_t comb[CIC_ORDER];    // previous input of every comb
+        uint64_t integ[CIC_ORDER];   // integrators, wrapping
+        uint64_t phase;              // NCO accumulator << 32
+        int grid;                    // position on the output grid, 0 <= grid < decimation
+    };
+    const State &state() const { return st; }
+    void set_state(const State &state) { st = state; }
+    void reset();
+
+    int interpolation() const { return l; }
+    int decimation() const { return m; }
+
+private:
+    int l;
+    int m;
+    double input_scale; // audio -> fixed point, so the last integrator is phase step << 32
+    State st;
+
+    template <typename T>
+    size_t run(const float *input, size_t count, T *output, const T *table);
+};
+
+#endif // CIC_H
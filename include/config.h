@@ -2,9 +2,20 @@
 #define CONFIG_H
 
 #include <string>
+#include <vector>
 #include "aprs.h"
 #include "logger.h"
 
+/**
+ * @brief How modulated packets reach the HackRF.
+ */
+typedef enum
+{
+    TX_STREAM, // modulate into memory and feed the TX callback directly
+    TX_FILE,   // write config.output, then transmit from that file
+    TX_PIPELINE, // acquire / modulate / TX on separate threads, on a fixed beacon grid
+} TxMode;
+
 /**
  * @brief Configuration struct for the entire program.
  */
@@ -18,12 +29,68 @@ struct Config
     std::string output;
     std::string info;
     OutputFormat iq_sf;
+    TxMode tx_mode;
+    bool iq_tap; // TX_STREAM only: also write the samples to `output` for debugging
+    ModulatorBackend modulator;
+    ModulatorChain chain; // iq: FIR resampler, cic: FM after a CIC at the output rate
+    int preamble_flags; // AX.25 flags sent ahead of every frame
+    int silence_ms;     // silence before and after every packet
+    bool binary_link;   // offer the FlatBuffers SensorBatch link in the handshake
+    int beacon_interval_ms; // TX_PIPELINE: time between beacon slots
+    int encode_lead_ms;     // TX_PIPELINE: telemetry is polled this long before its slot
+    quill::LogLevel log_level; // text log; samples go to the telemetry log instead
 
     // "hackrf" section, for example
     double frequency;  // e.g. 144390000 for 144.39 MHz (you can store in Hz)
-    double sampleRate; // e.g. 2e6 = 2 MHz sample rate, etc.
+    double sampleRate; // e.g. 2e6 = 2 MHz sample rate, etc.; the modulator outputs this rate
+    int resampler_stages; // filter chain length limit, 1 = single polyphase stage
     int amplifier;
     int txvga_gain;
+    int tx_idle_ms; // TX_PIPELINE: TX kept keyed (silent) after a burst for the next one, see tx_queue.h
+
+    // "serial" section (Teensy interconnect)
+    std::string serial_port;
+    int serial_baud;
+    int serial_timeout_ms;   // wait for a telemetry reply
+    int handshake_timeout_ms;
+
+    // "batch" section: packets sent back to back in one burst instead of `info`
+    std::vector<std::string> batch_info; // one entry per info = line, in order
+    int batch_gap_ms;                    // carrier between two packets of the burst
+    int batch_workers;                   // modulator threads, 0 = one per core
+
+    // "telemetry_log" section: binary record of every sample, see telemetry_log.h
+    bool telemetry_log;
+    std::string telemetry_log_path;
+    uint64_t telemetry_log_max_bytes; // rotate once the file reaches this size
+    int telemetry_log_keep;           // rotated files kept (path.1 ... path.N)
+    int telemetry_log_fsync_ms;       // fdatasync() at most this often
+
+    // "cache" section: modulated packets kept for repeats, see iq_cache.h
+    int iq_cache_mb; // 0 disables the cache
+
+    // "aprs_telemetry" section: T# reports built from the sensor data, see aprs_telemetry.h
+    bool aprs_telemetry;         // send telemetry instead of `info` while the Teensy answers
+    float aprs_deadband;         // in quantization steps of each field
+    int aprs_metadata_every;     // PARM/UNIT/EQNS/BITS + status every this many reports
+
+    // "flight" section: beacon rate and events by flight phase, see flight_phase.h
+    int flight_pad_ms;            // time between beacon cycles on the pad
+    int flight_boost_ms;          // ... during boost
+    int flight_coast_ms;          // ... from burnout to apogee
+    int flight_descent_ms;        // ... after apogee
+    int flight_landed_ms;         // ... once landed
+    float flight_launch_accel;    // m/s2, acceleration magnitude that means launch
+    int flight_launch_window_ms;  // ... when held over this long
+    float flight_launch_altitude; // m above the pad that means launch
+    float flight_apogee_drop;     // m below the highest altitude that means descent
+    float flight_landed_band;     // m of altitude spread that means landed
+    bool flight_events;           // send a status packet on every phase change
+
+    // "stress" section: modulator throughput measurement, see stress.h
+    bool stress;           // set by --stress: measure and exit instead of beaconing
+    int stress_threads;    // 0: one per core
+    double stress_seconds; // per thread count
 };
 
 /**
@@ -35,6 +102,21 @@ struct Config
  */
 Config load_config(const std::string &cfgFile, quill::Logger *logger);
 
+/**
+ * @brief Checks what load_config() cannot: addresses AX.25 can encode,
+ *        [hackrf] values the device accepts, non-negative sizes.
+ *        Every problem is logged.
+ * @return false if the config must not be used.
+ */
+bool validate_config(const Config &config, quill::Logger *logger);
+
+/**
+ * @brief Copies the settings that only take effect at startup (modulator
+ *        chain, sample rate, serial link, threads, caches, ...) from running
+ *        into next, logging each one that differed.
+ */
+void keep_restart_only(Config &next, const Config &running, quill::Logger *logger);
+
 /**
  * @brief Prints out the loaded configuration (for debugging).
  */
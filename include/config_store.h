@@ -0,0 +1,94 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "config.h"
+
+// a burst of writes (editor save, rename into place) is reloaded once
+const int CONFIG_RELOAD_SETTLE_MS = 200;
+
+typedef std::shared_ptr<const Config> ConfigSnapshot;
+
+/**
+ * @brief The current Config as an immutable snapshot, reloaded when the file
+ *        changes.
+ *
+ * Readers call current() once per packet/cycle and keep the returned snapshot
+ * for as long as they use it: one atomic load, no string copies, and a reload
+ * in the meantime never changes a snapshot someone holds. A reload parses the
+ * file again, applies the same adjustments as at startup (command line
+ * overrides), keeps the settings the running objects were built from (see
+ * keep_restart_only()) and publishes the result only if validate_config()
+ * accepts it; otherwise the previous snapshot stays.
+ *
+ * watch() follows the file with inotify on its directory, so editors that
+ * save by renaming a new file into place are seen too.
+ */
+class ConfigStore
+{
+public:
+    // applied to every freshly parsed Config before it is validated
+    typedef std::function<void(Config &)> Adjust;
+    // called on the watcher thread after a new snapshot was published
+    typedef std::function<void(const Config &)> Listener;
+
+    ConfigStore(quill::Logger *logger, const std::string &path, Adjust adjust = Adjust());
+    ~ConfigStore();
+
+    ConfigStore(const ConfigStore &) = delete;
+    ConfigStore &operator=(const ConfigStore &) = delete;
+
+    /**
+     * @brief Parses and validates the file (defaults if it is missing) and
+     *        publishes the first snapshot.
+     * @return false if the config is invalid; nothing is published then.
+     */
+    bool load();
+
+    /**
+     * @brief Parses the file again and publishes it if it is valid.
+     * @return true if a new snapshot was published.
+     */
+    bool reload();
+
+    ConfigSnapshot current() const { return std::atomic_load_explicit(&snapshot, std::memory_order_acquire); }
+
+    // bumped on every publish, cheap to poll
+    uint64_t generation() const { return published.load(std::memory_order_acquire); }
+
+    void set_listener(Listener listener) { on_reload = listener; }
+
+    /**
+     * @brief Starts the watcher thread.
+     * @return false if inotify is unavailable; the config then stays as loaded.
+     */
+    bool watch();
+
+    // stops and joins the watcher thread
+    void stop();
+
+private:
+    void watch_loop();
+    void publish(const ConfigSnapshot &next);
+
+    quill::Logger *logger;
+    std::string path;
+    std::string directory;
+    std::string filename;
+    Adjust adjust;
+    Listener on_reload;
+
+    ConfigSnapshot snapshot;
+    std::atomic<uint64_t> published{0};
+
+    int inotify_fd;
+    int stop_fd; // eventfd, wakes the watcher for stop()
+    std::thread watcher;
+};
+
+#endif // CONFIG_STORE_H
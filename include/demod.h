@@ -0,0 +1,98 @@
+#ifndef DEMOD_H
+#define DEMOD_H
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ax25.h"
+
+// DPLL gain: fraction of the bit clock error corrected per tone transition
+const float DEMOD_PLL_GAIN = 0.25f;
+
+/**
+ * @brief Receives the IQ Modulator produces: FM discriminator, Bell 202
+ *        tone correlator, bit clock recovery, NRZI decoding, HDLC
+ *        unstuffing and the FCS check, the inverse of every step of
+ *        ax25frame_nrzi() + afsk() + modulate().
+ *
+ * The IQ is first averaged down to ~48 kHz (a boxcar over sample_rate / 48k
+ * samples, its first null sits on the modulator's first image), then the
+ * phase step between two consecutive averages is the instantaneous
+ * frequency, i.e. the AFSK audio. Mark and space energy are correlated
+ * over a sliding window of one bit; the sign of their difference is the
+ * NRZI level, sampled once per bit by a DPLL that is pulled towards the
+ * level transitions. Five ones and a zero drop the zero, 0x7e delimits a
+ * frame, seven ones abort one.
+ *
+ * Only frames whose FCS matches and that ax25_parse() accepts come out
+ * of packets(); the rest are counted. State carries over from one
+ * process() call to the next, so the input can come in any block size.
+ * Not thread safe.
+ */
+class AfskDemodulator
+{
+public:
+    explicit AfskDemodulator(double sample_rate);
+
+    void process(const std::complex<float> *iq, size_t count);
+    // interleaved int8 I/Q (IQ_S8), count pairs
+    void process(const int8_t *iq, size_t count);
+
+    // back to the state after construction, packets and counters included
+    void reset();
+
+    const std::vector<Ax25Packet> &packets() const { return received; }
+    void clear_packets() { received.clear(); }
+
+    // frames of a plausible size whose FCS did not match
+    uint64_t fcs_errors() const { return fcs_error_count; }
+    // frames with a good FCS that are no UI frame
+    uint64_t bad_frames() const { return bad_frame_count; }
+
+    // rate the discriminator runs at, sample_rate / decimation()
+    double audio_rate() const { return rate / decim; }
+    int decimation() const { return decim; }
+
+private:
+    void audio_sample(std::complex<float> z);
+    void bit(bool level);
+    void frame_end();
+
+    double rate;
+    int decim;
+
+    // decimator
+    std::complex<float> acc;
+    int acc_count;
+    std::complex<float> prev;
+
+    // mark/space correlators: window of products and running sums
+    int window;
+    size_t pos;
+    std::vector<std::complex<float>> mark_products;
+    std::vector<std::complex<float>> space_products;
+    std::complex<double> mark_sum;
+    std::complex<double> space_sum;
+    std::complex<float> mark_osc, mark_step;
+    std::complex<float> space_osc, space_step;
+
+    // bit clock
+    float pll_phase; // 0..1, a bit is sampled on every wrap
+    float pll_step;
+    bool level;      // last sign of mark - space
+    bool last_bit_level;
+
+    // HDLC
+    uint32_t shift; // last bits, newest in bit 0
+    bool in_frame;
+    size_t frame_bits;
+    uint8_t byte;
+    std::vector<uint8_t> frame;
+
+    std::vector<Ax25Packet> received;
+    uint64_t fcs_error_count;
+    uint64_t bad_frame_count;
+};
+
+#endif // DEMOD_H
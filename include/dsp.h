@@ -3,22 +3,62 @@
 
 #include <vector>
 #include <complex>
+#include <cstdint>
 #include "ringbuffer.hpp"
+#include "aligned_allocator.h"
+#include "fir_kernels.h"
+#include "packed_bits.h"
 
 const int BUFSIZE = 4096;
 
 typedef jnk0le::Ringbuffer<std::complex<float>, BUFSIZE*2> Ringbuffer_t;
 
+// input samples per block on the int8 interpolation path; at 50 branches
+// the float staging is 16 * 50 * 8 = 6.4 KiB
+const int FIR_S8_BLOCK = 16;
+
 const int AUDIO_SAMPLE_RATE = 48000;
+// AFSK bit rate, AUDIO_SAMPLE_RATE / BAUD_RATE audio samples per bit
+const int BAUD_RATE = 1200;
+// Bell 202 tones: a 1 bit (NRZI level) is mark, a 0 bit space
+const int MARK_HZ = 1200;
+const int SPACE_HZ = 2200;
+
+// Which implementation generates the AFSK tones and the FM phase.
+typedef enum
+{
+    MOD_REFERENCE, // sin()/cos() per sample, floating point phase
+    MOD_NCO,       // 32-bit phase accumulator + sine table, see nco.h
+} ModulatorBackend;
 
 // AFSK modulation
 std::vector<float> afsk(const std::vector<bool> &data);
+std::vector<float> afsk(const PackedBits &data);
+// same as afsk(), but tones come from an NCO instead of sin()
+std::vector<float> afsk_nco(const std::vector<bool> &data);
+std::vector<float> afsk_nco(const PackedBits &data);
+
+// AFSK tone phase carried from one afsk_append() call to the next
+struct AfskState
+{
+    float phase = 0;        // MOD_REFERENCE
+    uint32_t nco_phase = 0; // MOD_NCO
+};
+
+// appends the tones for `data` (no silence) to `wave`, continuing from `state`;
+// afsk() == silence + afsk_append(data) from a fresh state + silence
+void afsk_append(const PackedBits &data, std::vector<float> &wave, AfskState &state, ModulatorBackend backend);
 
 // lowpass FIR filter
 std::vector<float> lowpass(double gain, double sampling_freq, double cutoff_freq, double transition_width);
+// length lowpass() picks for that design, without computing the taps
+int lowpass_ntaps(double sampling_freq, double transition_width);
 
 // FM modulator
 float fmmod(const float *input, size_t input_size, Ringbuffer_t &output, float sensitivity, float last_phase);
+// same as fmmod(), but the phase is integrated in a wrapping 32-bit accumulator
+// and cos/sin come from a table
+float fmmod_nco(const float *input, size_t input_size, Ringbuffer_t &output, float sensitivity, float last_phase);
 
 // used only for tests
 void naive_interpolate(const std::vector<std::complex<float>> &input,
@@ -29,11 +69,67 @@ void naive_interpolate(const std::vector<std::complex<float>> &input,
 class FIRInterpolator
 {
 public:
-    FIRInterpolator(int interpolation, const std::vector<float> &taps);
+    // picks the fastest kernel for this CPU, see fir_best_kernel(); with
+    // decimation > 1 only every decimation'th output of the x interpolation
+    // grid is computed (rational L/M resampling), see resample()
+    FIRInterpolator(int interpolation, const std::vector<float> &taps, int decimation = 1);
+
+    // appends interpolation * processed samples to output
     int interpolate(Ringbuffer_t &input, std::vector<std::complex<float>> &output);
+    // writes into a caller-supplied span, processing only as many input samples as fit
+    int interpolate(Ringbuffer_t &input, std::complex<float> *output, size_t capacity);
+    // same, quantized straight to interleaved int8 I/Q (capacity in I/Q pairs):
+    // the filter runs in blocks small enough to stay in L1 and each block is
+    // scaled, rounded and saturated right away, see fir_quantize_fn
+    int interpolate(Ringbuffer_t &input, int8_t *output, size_t capacity, float scale);
+
+    // the above for any decimation: returns the input samples processed,
+    // `produced` is the number of outputs written (at most capacity). The
+    // position on the output grid carries over from call to call.
+    int resample(Ringbuffer_t &input, std::complex<float> *output, size_t capacity, size_t &produced);
+    int resample(Ringbuffer_t &input, int8_t *output, size_t capacity, float scale, size_t &produced);
+
+    // outputs for `processed` more inputs from grid position `phase`
+    size_t output_count(size_t processed, int phase = 0) const;
+
+    // output grid position of the next input, 0 <= phase < decimation
+    int phase() const { return grid_phase; }
+    void set_phase(int phase) { grid_phase = phase; }
+
+    int interpolation() const { return nfilters; }
+    int decimation() const { return decim; }
+    // taps per polyphase branch, i.e. the number of input samples each output depends on
+    int taps_per_branch() const { return taps_count; }
+
+    FirKernel kernel() const { return kernel_id; }
+    void set_kernel(FirKernel kernel);
 
 private:
-    // these are the taps for the polyphase filers
-    std::vector<std::vector<float>> xtaps;
+    // copies the readable part of the ring into the contiguous window
+    int load_window(Ringbuffer_t &input);
+
+    // the taps of all polyphase filters in one buffer, branch after branch,
+    // each pre-reversed, duplicated for I/Q and zero-padded to padded_len
+    // (see fir_kernels.h), so the kernel walks them front to back
+    AlignedVector<float> xtaps;
+    std::vector<const float *> xtap_ptrs; // branch starts in xtaps
+    int nfilters;
+    int taps_count;
+    int padded_len;
+
+    // contiguous copy of the input so kernels never index through the ring mask
+    AlignedVector<std::complex<float>> window;
+
+    // L1-sized float staging for the int8 path
+    AlignedVector<std::complex<float>> block;
+
+    // decimation: the branches that land on the output grid, per phase
+    int decim;
+    int grid_phase;
+    std::vector<std::vector<const float *>> phase_ptrs;
+
+    FirKernel kernel_id;
+    fir_kernel_fn kernel_fn; // unrolled for padded_len where possible
+    fir_quantize_fn quantize_fn;
 };
 #endif
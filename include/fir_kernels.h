@@ -0,0 +1,68 @@
+#ifndef __FIR_KERNELS_H__
+#define __FIR_KERNELS_H__
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+
+// Inner loop of FIRInterpolator::interpolate(), one implementation per
+// instruction set. All of them compute, for i < n_out and j < branches,
+//
+//   out[i * branches + j] = sum_{m < len/2} in[i + m] * taps[j][m]
+//
+// where `in` is a contiguous complex<float> window and every branch of `taps`
+// is stored pre-reversed with each tap duplicated for I and Q
+// ({t0, t0, t1, t1, ...}), zero-padded to `len` floats (a multiple of
+// FIR_TAP_ALIGN) and aligned to FIR_TAP_ALIGN floats; FIRInterpolator keeps
+// the branches back to back in one buffer. `in` must stay readable for len
+// floats past the start of the last output.
+typedef void (*fir_kernel_fn)(const std::complex<float> *in, size_t n_out,
+                              const float *const *taps, int branches, int len,
+                              std::complex<float> *out);
+
+// branch length granularity in floats (one AVX register)
+const int FIR_TAP_ALIGN = 8;
+
+// Branch lengths the kernels are also compiled for with a constant trip
+// count: the padded length of every first resampler stage (33 taps, this
+// includes the default single stage x50 filter) and of the image rejection
+// stages after it (6..8 taps), see resampler.cpp.
+const int FIR_FIXED_LEN_FIRST = 72;
+const int FIR_FIXED_LEN_IMAGE = 16;
+
+typedef enum
+{
+    FIR_SCALAR,
+    FIR_SSE,
+    FIR_AVX2,
+    FIR_NEON,
+} FirKernel;
+
+// the fastest kernel supported by the CPU we are running on
+FirKernel fir_best_kernel();
+
+// whether this build and this CPU can run the kernel
+bool fir_kernel_supported(FirKernel kernel);
+
+// the kernel implementation, falls back to FIR_SCALAR if unsupported
+fir_kernel_fn fir_kernel(FirKernel kernel);
+// the same kernel unrolled for calls with exactly this len, if it is one of
+// the fixed lengths above; otherwise fir_kernel(kernel)
+fir_kernel_fn fir_kernel(FirKernel kernel, int len);
+
+const char *fir_kernel_name(FirKernel kernel);
+
+// Float to int8 quantizer for the IQ_S8 output, again one implementation
+// per instruction set:
+//
+//   out[i] = saturate_int8(round_nearest(in[i] * scale))
+//
+// Rounding follows the current FP rounding mode (nearest-even by default),
+// except on 32-bit NEON, which has no such conversion and rounds half away
+// from zero. NaN input is undefined.
+typedef void (*fir_quantize_fn)(const float *in, size_t count, float scale, int8_t *out);
+
+// the quantizer for the kernel's instruction set, falls back to scalar
+fir_quantize_fn fir_quantizer(FirKernel kernel);
+
+#endif
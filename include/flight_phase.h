@@ -0,0 +1,144 @@
+#ifndef FLIGHT_PHASE_H
+#define FLIGHT_PHASE_H
+
+#include <chrono>
+#include <cstdint>
+
+#include "config.h"
+#include "logger.h"
+#include "sensor_history.h"
+
+/**
+ * @brief Where the rocket is in its flight, as seen from the sensor data.
+ */
+typedef enum
+{
+    PHASE_PAD,     // on the rail, waiting for launch
+    PHASE_BOOST,   // motor burning
+    PHASE_COAST,   // climbing unpowered, up to apogee
+    PHASE_DESCENT, // past apogee, under drogue/main
+    PHASE_LANDED,  // altitude steady again after a descent
+} FlightPhase;
+
+const int FLIGHT_PHASE_COUNT = PHASE_LANDED + 1;
+
+// [flight] defaults: beacon interval per phase, fast where the data moves
+const int FLIGHT_PAD_INTERVAL_MS = 5000;
+const int FLIGHT_BOOST_INTERVAL_MS = 500;
+const int FLIGHT_COAST_INTERVAL_MS = 500;
+const int FLIGHT_DESCENT_INTERVAL_MS = 1000;
+const int FLIGHT_LANDED_INTERVAL_MS = 10000;
+
+// [flight] defaults: detection thresholds
+const float FLIGHT_LAUNCH_ACCEL = 25.0f;    // m/s2 including gravity, about 2.5 g
+const float FLIGHT_LAUNCH_ALTITUDE = 30.0f; // m above the pad, for a boost between two samples
+const float FLIGHT_APOGEE_DROP = 10.0f;     // m below the highest altitude seen
+const float FLIGHT_LANDED_BAND = 3.0f;      // m, altitude spread over FLIGHT_LANDED_MS
+
+// the pad altitude is the mean of this window while on the pad
+const unsigned long FLIGHT_GROUND_MS = 10000;
+// landed once the altitude stayed within FLIGHT_LANDED_BAND this long
+const unsigned long FLIGHT_LANDED_MS = 10000;
+// ... over at least this many samples
+const size_t FLIGHT_LANDED_SAMPLES = 5;
+// consecutive samples the acceleration has to stay above launch_accel for
+const size_t FLIGHT_LAUNCH_SAMPLES = 2;
+// [flight] default: ... all of them within this long; has to hold them at
+// the pad interval, in case they do not come faster
+const int FLIGHT_LAUNCH_WINDOW_MS = (int)(FLIGHT_LAUNCH_SAMPLES - 1) * FLIGHT_PAD_INTERVAL_MS;
+
+const char *flight_phase_name(FlightPhase phase);
+
+// [flight] <phase>_interval_ms of config
+int flight_interval_ms(const Config &config, FlightPhase phase);
+
+/**
+ * @brief Flight phase state machine fed from a SensorHistory.
+ *
+ * update() is called after every sample added to the history and moves
+ * through PAD -> BOOST -> COAST -> DESCENT -> LANDED, never back:
+ *
+ * - PAD -> BOOST when the acceleration magnitude stayed above launch_accel
+ *   on the last FLIGHT_LAUNCH_SAMPLES samples, taken within
+ *   launch_window_ms, so a single bump on the rail is no launch. While such
+ *   a launch waits for confirmation, interval_ms() is the boost one, so the
+ *   confirming samples come fast. A boost that fell between (slow, pad
+ *   rate) samples is caught by the altitude instead: more than
+ *   launch_altitude above the pad goes to COAST directly, or to BOOST if
+ *   the acceleration is still above launch_accel.
+ * - BOOST -> COAST when the acceleration drops below launch_accel again.
+ * - COAST (or BOOST) -> DESCENT when the altitude is apogee_drop below the
+ *   highest one seen; that highest altitude is the apogee.
+ * - DESCENT -> LANDED when the altitude spread over FLIGHT_LANDED_MS is
+ *   below landed_band.
+ *
+ * Altitude is the MPL3115A2 reading, or the BME688 one while the MPL has
+ * none; acceleration is the LSM6DSOX magnitude, or the BNO055 linear
+ * acceleration plus gravity. A history cleared by a Teensy restart keeps
+ * the phase. Thresholds are read from the Config passed in, so a reload
+ * applies on the next sample.
+ */
+class FlightPhaseTracker
+{
+public:
+    explicit FlightPhaseTracker(quill::Logger *logger);
+
+    // true if this sample changed the phase; event() then describes it
+    bool update(const SensorHistory &history, const Config &config);
+
+    FlightPhase phase() const { return current; }
+
+    // on the pad, the last sample was above launch_accel but is no launch yet
+    bool launch_pending() const { return pending; }
+
+    // time to the next beacon cycle: flight_interval_ms() of the phase, or
+    // the boost one while a launch is pending
+    int interval_ms(const Config &config) const;
+
+    // APRS status text of the last transition, e.g. ">Apogee 1234 m AGL"
+    const char *event() const { return event_buf; }
+
+    // m, NaN until known
+    float ground_altitude() const { return ground; }
+    float apogee_altitude() const { return apogee; }
+
+private:
+    void enter(FlightPhase next, float altitude);
+
+    quill::Logger *logger;
+    FlightPhase current;
+    bool pending;
+    float ground; // pad altitude
+    float apogee; // highest altitude since launch
+    char event_buf[64];
+};
+
+/**
+ * @brief Starts beacon cycles on deadlines instead of sleeping a fixed time
+ *        after each one.
+ *
+ * The next cycle starts `interval` after the start of the previous one, so
+ * the time spent polling and transmitting is not added to the period. A
+ * cycle that overran its interval is followed by the next one right away;
+ * the missed deadlines are dropped, not caught up on. The interval may
+ * change from one call to the next (flight phase).
+ */
+class BeaconScheduler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    BeaconScheduler();
+
+    // blocks until the cycle after the current one is due
+    void wait(int interval_ms);
+
+    // cycles that started late because the previous one overran
+    uint64_t overruns() const { return overrun_count; }
+
+private:
+    Clock::time_point started; // of the current cycle
+    uint64_t overrun_count;
+};
+
+#endif // FLIGHT_PHASE_H
@@ -0,0 +1,80 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <chrono>
+#include <cstdint>
+
+// Hot-path latency instrumentation, built only with -DFRANC_INSTRUMENT
+// (CMake option FRANC_INSTRUMENT). Otherwise FRANC_TIMED() and
+// FRANC_INSTRUMENT_REPORT() expand to nothing and no recording code is built.
+//
+//   void stage() { FRANC_TIMED(STAGE_AFSK); ... }   // times the enclosing scope
+//   FRANC_INSTRUMENT_REPORT(logger);                  // logs percentiles since the last report
+//
+// Every thread records into its own histograms (single writer, relaxed
+// atomics, no locks on the hot path); the report sums all threads. Stages
+// nest: STAGE_MODULATE includes STAGE_AX25_FRAME and STAGE_AFSK, and
+// STAGE_BEACON_CYCLE includes everything else in that cycle.
+
+typedef enum
+{
+    STAGE_SERIAL_REQUEST,   // SEND/SENDFB round trip to the Teensy
+    STAGE_TELEMETRY_DECODE, // JSON parse or SensorBatch verify + read
+    STAGE_AX25_FRAME,       // framing, bit stuffing, NRZI of one packet
+    STAGE_AFSK,             // AFSK tones of one packet
+    STAGE_MODULATE,         // one whole packet through modulate()/modulate_packet()
+    STAGE_FILE_WRITE,       // one block of output written to config.output
+    STAGE_TRANSMIT,         // one HackRF burst, start to end of streaming
+    STAGE_BEACON_CYCLE,     // one iteration of the main loop, without its sleep
+    STAGE_COUNT,
+} InstrumentStage;
+
+const char *instrument_stage_name(InstrumentStage stage);
+
+#ifdef FRANC_INSTRUMENT
+
+#include "logger.h"
+
+// adds one sample to the calling thread's histogram for stage
+void instrument_record(InstrumentStage stage, uint64_t ns);
+
+// count, mean and p50/p90/p99/max per stage since the previous call
+void instrument_report(quill::Logger *logger);
+
+/**
+ * @brief Records the lifetime of the object as one sample of its stage.
+ */
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(InstrumentStage stage)
+        : stage(stage), start(std::chrono::steady_clock::now())
+    {
+    }
+    ~ScopedTimer()
+    {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        instrument_record(stage, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    InstrumentStage stage;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define FRANC_TIMER_NAME2(line) franc_timer_##line
+#define FRANC_TIMER_NAME(line) FRANC_TIMER_NAME2(line)
+#define FRANC_TIMED(stage) ScopedTimer FRANC_TIMER_NAME(__LINE__)(stage)
+#define FRANC_INSTRUMENT_REPORT(logger) instrument_report(logger)
+
+#else
+
+#define FRANC_TIMED(stage) ((void)0)
+#define FRANC_INSTRUMENT_REPORT(logger) ((void)0)
+
+#endif // FRANC_INSTRUMENT
+
+#endif // INSTRUMENT_H
@@ -2,16 +2,95 @@
 #define INTERCONNECT_H
 
 #include <string>
+#include <vector>
+#include <cstdint>
+#include <chrono>
 #include "logger.h"
+#include "ringbuffer.hpp"
 
-// Performs the handshake over the serial port. Returns a valid file descriptor on success.
-int interconnect_handshake(quill::Logger *logger);
+// Telemetry format agreed on during the handshake.
+typedef enum
+{
+    LINK_JSON,        // "SEND\n" -> one JSON line
+    LINK_FLATBUFFERS, // "SENDFB\n" -> one framed SensorBatch
+} LinkMode;
 
-// Reads from the serial port until a newline is encountered and returns the line.
-std::string interconnect_bus(int fd);
+// SensorBatch frame on the wire: LINK_FRAME_MAGIC, then the FlatBuffers
+// size-prefixed buffer (uint32 little-endian length + SensorBatch).
+const uint8_t LINK_FRAME_MAGIC[2] = {0xFB, 0x5B};
+const uint32_t LINK_FRAME_MAX = 4096;
 
-// Sends a command ("SEND\n") to the Teensy, waits for a valid JSON message (from '{' to '}'),
-// then sends an ACK ("ACK\n") and returns the JSON string.
-std::string request_json(int fd);
+// Longest JSON line accepted before it is treated as garbage.
+const size_t LINK_LINE_MAX = 4096;
+
+/**
+ * @brief Serial link to the Teensy.
+ *
+ * Received bytes go into a persistent ring, so anything that arrives after
+ * a line or frame is kept for the next read instead of being dropped, and
+ * lines/frames split across read() calls are reassembled. Reads block in
+ * poll() until data arrives or the timeout passes, so latency is bounded by
+ * the Teensy, not by a fixed sleep.
+ */
+class SerialLink
+{
+public:
+    explicit SerialLink(quill::Logger *logger);
+    ~SerialLink();
+
+    /**
+     * @brief Opens and configures the port and performs the handshake. When
+     *        offer_binary is set, also offers the FlatBuffers link
+     *        ("HELLO FB1\n"); mode() is LINK_FLATBUFFERS only if the Teensy
+     *        answered "ACKHELLO FB1". Older firmware answers "ACKHELLO" and
+     *        stays on JSON.
+     */
+    bool open(const std::string &port, int baud, bool offer_binary);
+    void close();
+    bool is_open() const { return fd >= 0; }
+
+    LinkMode mode() const { return link_mode; }
+
+    // per request: how long to wait for the reply after SEND/SENDFB
+    void set_timeout(int ms) { timeout_ms = ms; }
+    // how long open() waits for ACKHELLO
+    void set_handshake_timeout(int ms) { handshake_timeout_ms = ms; }
+
+    /**
+     * @brief Sends "SEND\n", waits for a JSON line (from '{' to '}') and sends
+     *        "ACK\n". Returns false on timeout.
+     */
+    bool request_json(std::string &json);
+
+    /**
+     * @brief Sends "SENDFB\n", waits for one SensorBatch frame and sends
+     *        "ACK\n". On success `frame` holds the size-prefixed buffer, ready
+     *        for sensor_data_from_batch(); the vector is reused across calls
+     *        so steady state does not allocate.
+     */
+    bool request_batch(std::vector<uint8_t> &frame);
+
+    // Next complete line (without "\r\n") or false once the timeout passes.
+    bool read_line(std::string &line, int timeout_ms);
+
+    // Next complete SensorBatch frame or false once the timeout passes.
+    bool read_frame(std::vector<uint8_t> &frame, int timeout_ms);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    bool send(const char *cmd);
+    // waits until more bytes arrived (or the deadline passed), appends them to rx
+    bool fill(Clock::time_point deadline);
+    // drops whatever is buffered, e.g. leftovers of the previous reply
+    void discard();
+
+    quill::Logger *logger;
+    int fd;
+    LinkMode link_mode;
+    int timeout_ms;
+    int handshake_timeout_ms;
+    jnk0le::Ringbuffer<uint8_t, 8192> rx;
+};
 
 #endif // INTERCONNECT_H
@@ -0,0 +1,66 @@
+#ifndef IQ_CACHE_H
+#define IQ_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "modulator.h"
+
+/**
+ * @brief LRU cache of fully modulated packets, keyed by their content.
+ *
+ * The key is everything the output depends on: callsign, destination, path,
+ * info, output format, modulator backend, framing and resampler chain. A
+ * repeated packet (status, fixed position on the pad, canned messages) is
+ * written straight from memory with no DSP work; a new one is modulated once
+ * and captured on the way out. Least recently sent packets are evicted to stay under
+ * max_bytes; a single packet larger than that is never cached.
+ *
+ * Not thread safe: use it from the one thread that modulates.
+ */
+class IQCache
+{
+public:
+    explicit IQCache(size_t max_bytes);
+
+    /**
+     * @brief Same output as modulator.modulate_packet(...), from the cache if
+     *        possible. Returns true on a cache hit.
+     */
+    bool modulate_packet(Modulator &modulator, const char *callsign, const char *dest, const char *path,
+                         const char *info, const IQWriter &write, OutputFormat iq_sf);
+
+    void clear();
+
+    size_t size() const { return bytes; }
+    size_t entries() const { return lru.size(); }
+    uint64_t hits() const { return hit_count; }
+    uint64_t misses() const { return miss_count; }
+
+private:
+    struct Entry
+    {
+        std::string key;
+        std::vector<uint8_t> iq;
+    };
+    typedef std::list<Entry> EntryList;
+
+    void make_key(const Modulator &modulator, const char *callsign, const char *dest, const char *path,
+                  const char *info, OutputFormat iq_sf);
+    void evict_to(size_t limit);
+
+    size_t max_bytes;
+    size_t bytes;
+    EntryList lru; // most recently used first
+    std::unordered_map<std::string, EntryList::iterator> index;
+    std::string key; // scratch, reused between lookups
+
+    uint64_t hit_count;
+    uint64_t miss_count;
+};
+
+#endif // IQ_CACHE_H
@@ -0,0 +1,88 @@
+#ifndef IQSTREAM_H
+#define IQSTREAM_H
+
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+#include "ringbuffer.hpp"
+
+// 4 MiB of interleaved I/Q bytes, a little under one second of RF at 2.4 MSPS
+const size_t IQSTREAM_SIZE = 1 << 22;
+
+// largest write() that reaches the ring as one piece; a quarter of the ring,
+// so a blocked producer never waits for the TX side to drain it completely
+const size_t IQSTREAM_WRITE_BLOCK = IQSTREAM_SIZE / 4;
+
+typedef jnk0le::MpscRingbuffer<int8_t, IQSTREAM_SIZE> IQRing_t;
+
+/**
+ * @brief In-memory IQ_S8 stream between the modulator and the HackRF TX callback.
+ *
+ * Any number of producers (modulator/encoder threads calling write()) and a
+ * single consumer (the libhackrf USB thread calling read()). Producers block
+ * while the ring is full; the consumer never blocks. Every write() of up to
+ * IQSTREAM_WRITE_BLOCK bytes lands in the stream as one piece; longer ones are
+ * split into blocks of that size, in order, which other producers' writes can
+ * fall between. An optional debug tap receives a copy of everything that is
+ * written, so the old pkt8.s8 file can still be produced.
+ */
+class IQStream
+{
+public:
+    IQStream();
+
+    /**
+     * @brief Prepares the stream for a new burst. Must not be called while a
+     *        producer or consumer is active.
+     */
+    void reset();
+
+    /**
+     * @brief Appends samples, blocking while the ring is full. Thread safe.
+     * @return Number of bytes written; less than count only if the stream was aborted.
+     */
+    size_t write(const int8_t *data, size_t count);
+
+    /**
+     * @brief Reads up to count bytes without blocking.
+     * @return Number of bytes copied into data.
+     */
+    size_t read(int8_t *data, size_t count);
+
+    /**
+     * @brief Producer side: no more samples will be written for this burst.
+     */
+    void close();
+
+    /**
+     * @brief Consumer side: stop accepting samples and release a blocked producer.
+     */
+    void abort();
+
+    bool closed() const { return is_closed.load(std::memory_order_acquire); }
+    bool aborted() const { return is_aborted.load(std::memory_order_acquire); }
+    size_t available() const { return ring->readAvailable(); }
+
+    /**
+     * @brief True once the producer has closed the stream and everything was read.
+     */
+    bool drained() const { return closed() && ring->isEmpty(); }
+
+    /**
+     * @brief Mirrors every written byte into fp (nullptr disables the tap).
+     *        The caller keeps ownership of the FILE. With several producers
+     *        the tap shows each one's data in order, not the stream's.
+     */
+    void set_tap(FILE *fp) { tap = fp; }
+
+private:
+    std::unique_ptr<IQRing_t> ring;
+    std::atomic<bool> is_closed;
+    std::atomic<bool> is_aborted;
+    FILE *tap;
+};
+
+#endif // IQSTREAM_H
@@ -0,0 +1,205 @@
+#ifndef MODULATOR_H
+#define MODULATOR_H
+
+#include <vector>
+#include <complex>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include "dsp.h"
+#include "ax25.h"
+#include "iqstream.h"
+#include "resampler.h"
+#include "cic.h"
+
+typedef enum
+{
+    IQ_S8,
+    IQ_F32,
+    PCM_F32,
+} OutputFormat;
+
+// how the AFSK audio becomes IQ at the output rate
+typedef enum
+{
+    CHAIN_IQ,  // FM at 48 kHz, then the complex polyphase Resampler
+    CHAIN_CIC, // audio interpolated by a CIC, FM at the output rate, see cic.h
+} ModulatorChain;
+
+// receives each block of modulated samples as raw bytes in the selected format
+typedef std::function<void(const void *data, size_t size)> IQWriter;
+
+// 5kHz FM deviation
+const float MAX_DEVIATION = 5000;
+// the original single stage: 48000 * 50 = 2400000
+const int INTERPOLATION = 50;
+// output rate when none is given; the TX path uses config.sampleRate
+const double DEFAULT_IQ_RATE = (double)AUDIO_SAMPLE_RATE * INTERPOLATION;
+// silence before and after each packet
+const int SILENCE_MS = 500;
+
+// scales [-1, 1] floats to signed 8 bit I/Q
+std::vector<int8_t> f32_to_s8(const std::vector<std::complex<float>> &input);
+void f32_to_s8(const std::complex<float> *input, size_t count, int8_t *output);
+
+/**
+ * @brief Taps of the x50 interpolation low-pass.
+ *
+ * The Kaiser design (and its Izero() series per tap) only depends on
+ * constants, so it runs once per process on first use.
+ */
+const std::vector<float> &modulator_taps();
+
+/**
+ * @brief Reusable FM modulation + resampling pipeline, from the audio rate to
+ *        sample_rate through the cheapest chain plan_resampler() finds
+ *        (resampler_stages = 1 keeps a single polyphase filter).
+ *
+ * The filter designs, their polyphase split and all block buffers are set up
+ * once, so modulate() only does the per-sample work. CHAIN_CIC swaps the
+ * complex FIR for CicFmInterpolator at the same output rate; the backend
+ * still picks how the AFSK tones are made. Not thread safe: give every
+ * thread its own instance (or use default_modulator()).
+ *
+ * modulate_packet() additionally caches the leading silence + AX.25 preamble,
+ * which is identical for every packet: the first call per output format
+ * modulates it and snapshots the pipeline state (AFSK/FM phase, NRZI level,
+ * FIR history); later calls replay the cached IQ and only modulate the frame.
+ */
+class Modulator
+{
+public:
+    explicit Modulator(ModulatorBackend backend = MOD_REFERENCE,
+                       int preamble_flags = AX25_PREAMBLE_FLAGS,
+                       int silence_ms = SILENCE_MS,
+                       double sample_rate = DEFAULT_IQ_RATE,
+                       int resampler_stages = RESAMPLER_MAX_STAGES,
+                       ModulatorChain chain = CHAIN_IQ);
+
+    /**
+     * @brief Modulates one complete AFSK waveform, starting from zero phase
+     *        and an empty filter history, and hands each block to write.
+     */
+    void modulate(const std::vector<float> &waveform, const IQWriter &write, OutputFormat iq_sf);
+
+    /**
+     * @brief IQ_S8 into the TX stream; closes the stream when done.
+     */
+    void modulate(const std::vector<float> &waveform, IQStream &stream);
+
+    /**
+     * @brief Encodes and modulates one APRS packet: silence, sync bits and
+     *        flags, the bit stuffed frame, silence. Output is the same as
+     *        modulate(afsk(nrzi(ax25frame(...)))) for the default framing.
+     */
+    void modulate_packet(const char *callsign, const char *dest, const char *path, const char *info,
+                         const IQWriter &write, OutputFormat iq_sf);
+    void modulate_packet(const char *callsign, const char *dest, const char *path, const char *info,
+                         IQStream &stream);
+
+    /**
+     * @brief Pull-style modulate_packet(): encodes the packet and returns the
+     *        exact number of output bytes it will produce. The samples are then
+     *        taken with next_chunk() or read_packet() until they report the end.
+     *        Starting another packet (or calling set_framing/set_backend)
+     *        abandons the current one.
+     */
+    size_t begin_packet(const char *callsign, const char *dest, const char *path, const char *info,
+                        OutputFormat iq_sf);
+
+    // next block of the current packet; points into internal buffers that
+    // stay valid until the next call, false once the packet is complete
+    bool next_chunk(const void *&data, size_t &size);
+
+    // copies up to capacity bytes of the current packet into out, returns the
+    // count copied, 0 once the packet is complete
+    size_t read_packet(void *out, size_t capacity);
+
+    // exact output size of a packet without modulating it (no cache fill)
+    size_t packet_size(const char *callsign, const char *dest, const char *path, const char *info,
+                       OutputFormat iq_sf);
+
+    ModulatorBackend backend() const { return mod_backend; }
+    ModulatorChain chain() const { return mod_chain; }
+    void set_backend(ModulatorBackend backend);
+
+    // preamble length in flags and leading/trailing silence; drops the cache if changed
+    void set_framing(int preamble_flags, int silence_ms);
+    int preamble_flag_count() const { return preamble_flags; }
+    int silence_sample_count() const { return silence_samples; }
+
+    // the rate actually produced may differ from the requested one by a few
+    // ppm if the ratio had to be approximated, see plan_resampler()
+    double sample_rate() const { return iq_resampler.plan().output_rate; }
+    const ResamplerPlan &resampler_plan() const { return iq_resampler.plan(); }
+    Resampler &resampler() { return iq_resampler; }
+    const Resampler &resampler() const { return iq_resampler; }
+
+private:
+    // silence + preamble, modulated once per output format
+    struct PrefixCache
+    {
+        bool valid = false;
+        std::vector<uint8_t> samples;             // output bytes in that format
+        std::vector<std::complex<float>> history; // FIR input not consumed yet
+        Resampler::State resampler_state;         // and inside the stage chain
+        CicFmInterpolator::State cic_state;       // or all of it, for CHAIN_CIC
+        float fm_phase = 0;
+        AfskState afsk;
+        bool nrzi_level = true;
+        size_t audio_samples = 0; // audio the prefix was modulated from
+    };
+
+    enum PullStage
+    {
+        PULL_IDLE,
+        PULL_PCM,     // the whole audio buffer, once
+        PULL_PREFIX,  // cached prefix samples
+        PULL_PAYLOAD, // block by block from `audio`
+    };
+
+    void begin();
+    void feed(const float *audio, size_t count, const IQWriter &write, OutputFormat iq_sf);
+    // modulates from audio[offset] on until one block of output is ready
+    bool feed_block(const float *audio, size_t count, size_t &offset, OutputFormat iq_sf,
+                    const void *&data, size_t &size);
+    bool feed_block_cic(const float *audio, size_t count, size_t &offset, OutputFormat iq_sf,
+                        const void *&data, size_t &size);
+    size_t output_size(size_t audio_samples, OutputFormat iq_sf) const;
+    const PrefixCache &prefix_for(OutputFormat iq_sf);
+    void invalidate_prefix();
+
+    ModulatorBackend mod_backend;
+    float sensitivity;
+    Resampler iq_resampler;
+    ModulatorChain mod_chain;
+    CicFmInterpolator cic;
+    Ringbuffer_t mod_buf;
+    float fm_phase;
+
+    int preamble_flags;
+    int silence_samples;
+    PrefixCache prefix[2]; // IQ_S8, IQ_F32
+
+    // block buffers, reused across blocks and packets
+    std::vector<std::complex<float>> interp_buf;
+    std::vector<int8_t> s8_buf;
+    PackedBits bits;
+    PackedBits size_bits;
+    std::vector<float> audio;
+
+    // begin_packet() / next_chunk() state
+    PullStage stage;
+    OutputFormat pull_fmt;
+    const PrefixCache *pull_prefix;
+    size_t pull_offset;
+    const uint8_t *pending; // rest of the block read_packet() is copying
+    size_t pending_size;
+};
+
+/**
+ * @brief The calling thread's Modulator, created on first use.
+ */
+Modulator &default_modulator();
+
+#endif // MODULATOR_H
@@ -0,0 +1,30 @@
+#ifndef __PACKED_BITS_H__
+#define __PACKED_BITS_H__
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// A bit sequence packed LSB first into bytes (bit i is bytes[i/8] >> (i%8)),
+// in transmission order. Drop-in for the std::vector<bool> frames where only
+// indexing and size() are needed; clear() keeps the allocation so one
+// instance can be reused for every packet.
+struct PackedBits
+{
+    std::vector<uint8_t> bytes;
+    size_t count = 0;
+
+    void clear()
+    {
+        bytes.clear();
+        count = 0;
+    }
+
+    void reserve(size_t bits) { bytes.reserve((bits + 7) / 8); }
+
+    size_t size() const { return count; }
+
+    bool operator[](size_t i) const { return (bytes[i >> 3] >> (i & 7)) & 1; }
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "logger.h"
+#include "config.h"
+#include "modulator.h"
+#include "telemetry.h"
+#include "transmitter.h"
+#include "tx_queue.h"
+#include "ringbuffer.hpp"
+#include "master_sensor_struct.h"
+
+typedef std::chrono::steady_clock PipelineClock;
+
+/**
+ * @brief One telemetry poll as handed from acquisition to the encoder.
+ */
+struct TelemetrySample
+{
+    MasterSensorData data;
+    bool valid = false; // false if the poll failed; the packet still goes out
+    PipelineClock::time_point acquired;
+};
+
+/**
+ * @brief A fully modulated IQ_S8 packet waiting for its beacon slot.
+ */
+struct Burst
+{
+    std::vector<int8_t> iq;
+    PipelineClock::time_point acquired;
+};
+
+/**
+ * @brief Builds and modulates the packet for one sample, writing IQ_S8 bytes.
+ */
+typedef std::function<void(const TelemetrySample &, Modulator &, const IQWriter &)> PacketEncoder;
+
+/**
+ * @brief Acquisition, encode/modulate and HackRF TX on their own threads.
+ *
+ * The stages are connected by SPSC rings. The TX thread is the scheduler:
+ * bursts start on an absolute grid of beacon_interval_ms ticks (a slot still
+ * busy with the previous burst is skipped, not shifted), and acquisition polls
+ * the Teensy on the same grid, one encode-lead ahead of the slot it feeds.
+ * Under backpressure the encoder coalesces queued samples (only the newest
+ * is encoded), the TX thread discards older ready bursts, and bursts older
+ * than two intervals are dropped as stale. The sample ring itself only
+ * fills up if the encoder is stuck; acquisition then drops the new samples
+ * (only the consumer may remove from an SPSC ring) and counts them.
+ *
+ * Bursts go out through a TxQueue, so a slot that follows the previous one
+ * within [hackrf] tx_idle_ms stays in the same streaming session.
+ */
+class BeaconPipeline
+{
+public:
+    BeaconPipeline(quill::Logger *logger, const Config &config, TelemetryReader &telemetry,
+                   Modulator &modulator, HackRfTransmitter &transmitter, PacketEncoder encoder);
+    ~BeaconPipeline();
+
+    BeaconPipeline(const BeaconPipeline &) = delete;
+    BeaconPipeline &operator=(const BeaconPipeline &) = delete;
+
+    // Starts the three threads; returns immediately.
+    void start();
+    // Stops and joins them; the burst on air is finished first.
+    void stop();
+    // start() and block until stop() is called from elsewhere.
+    void run();
+
+private:
+    static const int POOL_SIZE = 3; // one on air, one ready, one being encoded
+
+    void acquire_loop();
+    void encode_loop();
+    void transmit_loop();
+    void release(Burst *burst);
+    bool sleep_until(PipelineClock::time_point when);
+    void log_stats();
+
+    quill::Logger *logger;
+    TelemetryReader &telemetry;
+    Modulator &modulator;
+    HackRfTransmitter &transmitter;
+    TxQueue tx;
+    PacketEncoder encoder;
+
+    PipelineClock::duration interval;
+    PipelineClock::duration lead; // acquisition runs this far ahead of the TX slot
+    PipelineClock::time_point epoch;
+
+    jnk0le::Ringbuffer<TelemetrySample, 4> samples;  // acquire -> encode
+    jnk0le::Ringbuffer<Burst *, 4> ready;            // encode -> TX
+    jnk0le::Ringbuffer<Burst *, 4> free_bursts;      // TX -> encode
+    Burst pool[POOL_SIZE];
+
+    std::atomic<bool> running;
+    std::thread acquire_thread;
+    std::thread encode_thread;
+    std::thread transmit_thread;
+
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> failed{0};
+    std::atomic<uint64_t> missed_slots{0};
+    std::atomic<uint64_t> dropped_samples{0};
+    std::atomic<uint64_t> coalesced_samples{0};
+    std::atomic<uint64_t> stale_bursts{0};
+};
+
+#endif // PIPELINE_H
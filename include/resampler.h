@@ -0,0 +1,110 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "dsp.h"
+
+// stages the planner may chain by default; 1 forces a single polyphase filter
+const int RESAMPLER_MAX_STAGES = 3;
+// largest interpolation of the whole chain, keeps tap counts sane
+const int RESAMPLER_MAX_INTERPOLATION = 4096;
+// largest decimation tried when the rate ratio has to be approximated
+const int RESAMPLER_MAX_DECIMATION = 64;
+
+struct ResamplerStage
+{
+    int interpolation;
+    int decimation; // > 1 only on the last stage
+};
+
+/**
+ * @brief How the FM baseband gets from the audio rate to the TX rate.
+ *
+ * The rate ratio L/M is split into a chain of polyphase interpolators, the
+ * last one also decimating by M. The first stage does the band limiting
+ * (passband 0.4, stopband 0.5 of its input rate, like the original x50
+ * filter); later ones only have to remove images, so their transition band
+ * is wide and their filters short. cost is the complex MACs per second the
+ * chain spends, which is what plan_resampler() minimises.
+ */
+struct ResamplerPlan
+{
+    int input_rate = 0;
+    double output_rate = 0; // actual rate, input_rate * L / M
+    std::vector<ResamplerStage> stages;
+    double cost = 0;
+
+    bool valid() const { return !stages.empty(); }
+    int interpolation() const;
+    int decimation() const;
+};
+
+/**
+ * @brief Cheapest chain of at most max_stages stages from input_rate to
+ *        output_rate (both in S/s, output above input).
+ *
+ * Rates with an exact ratio whose L exceeds RESAMPLER_MAX_INTERPOLATION are
+ * approximated by the closest L/M with M <= RESAMPLER_MAX_DECIMATION; the
+ * plan's output_rate says what was picked. Returns an invalid (empty) plan
+ * for output_rate <= input_rate.
+ */
+ResamplerPlan plan_resampler(int input_rate, double output_rate, int max_stages = RESAMPLER_MAX_STAGES);
+
+// e.g. "48000 -> 2000000 S/s: x5, x25/3 (25.1 MMAC/s)"
+std::string resampler_plan_string(const ResamplerPlan &plan);
+
+/**
+ * @brief The stages of a ResamplerPlan chained through internal rings.
+ *
+ * process() pulls input from the caller's ring and returns as soon as the
+ * last stage produced something; 0 means the chain is drained and needs more
+ * input. The filter history (every ring plus the decimation phase) can be
+ * saved and restored, so a cached prefix can be continued seamlessly.
+ */
+class Resampler
+{
+public:
+    explicit Resampler(const ResamplerPlan &plan);
+
+    // outputs written, at most capacity; consumes what it processed from input
+    size_t process(Ringbuffer_t &input, std::complex<float> *output, size_t capacity);
+    // fused int8 output (capacity and result in I/Q pairs), see FIRInterpolator
+    size_t process(Ringbuffer_t &input, int8_t *output, size_t capacity, float scale);
+
+    // empty history, output grid back at phase 0
+    void reset();
+
+    struct State
+    {
+        std::vector<std::vector<std::complex<float>>> rings;
+        std::vector<int> phases;
+    };
+    void save(State &state) const;
+    void restore(const State &state);
+
+    // exact output count for input_samples fed from reset() and drained
+    size_t output_count(size_t input_samples) const;
+    // output capacity process() can use in one call
+    size_t block_size() const;
+    // output samples after which the response to a constant input repeats
+    size_t period() const;
+
+    const ResamplerPlan &plan() const { return resampler_plan; }
+
+private:
+    // runs every stage but the last once, true if any of them moved data
+    bool pump(Ringbuffer_t &input);
+    Ringbuffer_t &last_input(Ringbuffer_t &input);
+
+    ResamplerPlan resampler_plan;
+    std::vector<std::unique_ptr<FIRInterpolator>> stages;
+    std::vector<std::unique_ptr<Ringbuffer_t>> rings; // rings[s]: stage s output, stage s + 1 input
+    std::vector<std::complex<float>> scratch;
+};
+
+#endif // RESAMPLER_H
@@ -15,6 +15,8 @@
 #include <stddef.h>
 #include <limits>
 #include <atomic>
+#include <algorithm>
+#include <thread>
 
 namespace jnk0le
 {
@@ -266,6 +268,55 @@ namespace jnk0le
 				return data_buff[(tail.load(std::memory_order_relaxed) + index) & buffer_mask];
 			}
 
+			/*!
+			 * \brief Contiguous region of the internal buffer
+			 */
+			struct Span
+			{
+				T* data;
+				size_t size;
+			};
+
+			/*!
+			 * \brief Gets the readable elements as at most two contiguous regions, oldest first
+			 *
+			 * It is safe to use the regions only on consumer side, until the elements are removed with remove(cnt)
+			 *
+			 * \param[out] first Region starting at the consumed side
+			 * \param[out] second Region continuing after the wrap point, empty if there is none
+			 * \return Number of elements in both regions, same as readAvailable()
+			 */
+			size_t readSpans(Span& first, Span& second) {
+				index_t tmp_tail = tail.load(std::memory_order_relaxed);
+				index_t avail = head.load(index_acquire_barrier) - tmp_tail;
+				return spans(tmp_tail, avail, first, second);
+			}
+
+			/*!
+			 * \brief Gets the free slots as at most two contiguous regions, in write order
+			 *
+			 * Elements stored there become visible to the consumer only after commit()
+			 * It is safe to use the regions only on producer side
+			 *
+			 * \param[out] first Region starting at the produced side
+			 * \param[out] second Region continuing after the wrap point, empty if there is none
+			 * \return Number of free slots in both regions, same as writeAvailable()
+			 */
+			size_t writeSpans(Span& first, Span& second) {
+				index_t tmp_head = head.load(std::memory_order_relaxed);
+				index_t avail = buffer_size - (tmp_head - tail.load(index_acquire_barrier));
+				return spans(tmp_head, avail, first, second);
+			}
+
+			/*!
+			 * \brief Publishes elements stored through writeSpans()
+			 * \param cnt Number of elements written, at most the size writeSpans() returned
+			 */
+			void commit(size_t cnt) {
+				std::atomic_signal_fence(std::memory_order_release);
+				head.store(head.load(std::memory_order_relaxed) + cnt, index_release_barrier);
+			}
+
 			/*!
 			 * \brief Insert multiple elements into internal buffer without blocking
 			 *
@@ -322,6 +373,14 @@ namespace jnk0le
 			size_t readBuff(T* buff, size_t count, size_t count_to_callback, void (*execute_data_callback)(void));
 
 		private:
+			size_t spans(index_t start, index_t count, Span& first, Span& second) {
+				size_t offset = start & buffer_mask;
+				size_t linear = (count < buffer_size - offset) ? count : buffer_size - offset;
+				first = Span{&data_buff[offset], linear};
+				second = Span{&data_buff[0], count - linear};
+				return count;
+			}
+
 			constexpr static index_t buffer_mask = buffer_size-1; //!< bitwise mask for a given buffer size
 			constexpr static std::memory_order index_acquire_barrier = fake_tso ?
 					  std::memory_order_relaxed
@@ -360,9 +419,12 @@ namespace jnk0le
 			if(available < count) // do not write more than we can
 				to_write = available;
 
-			// maybe divide it into 2 separate writes
-			for(size_t i = 0; i < to_write; i++)
-				data_buff[tmp_head++ & buffer_mask] = buff[i];
+			// at most 2 separate writes, split at the wrap point
+			size_t offset = tmp_head & buffer_mask;
+			size_t linear = (to_write < buffer_size - offset) ? to_write : buffer_size - offset;
+			std::copy(buff, buff + linear, &data_buff[offset]);
+			std::copy(buff + linear, buff + to_write, &data_buff[0]);
+			tmp_head += to_write;
 
 			std::atomic_signal_fence(std::memory_order_release);
 			head.store(tmp_head, index_release_barrier);
@@ -419,9 +481,12 @@ namespace jnk0le
 			if(available < count) // do not read more than we can
 				to_read = available;
 
-			// maybe divide it into 2 separate reads
-			for(size_t i = 0; i < to_read; i++)
-				buff[i] = data_buff[tmp_tail++ & buffer_mask];
+			// at most 2 separate reads, split at the wrap point
+			size_t offset = tmp_tail & buffer_mask;
+			size_t linear = (to_read < buffer_size - offset) ? to_read : buffer_size - offset;
+			std::copy(&data_buff[offset], &data_buff[offset] + linear, buff);
+			std::copy(&data_buff[0], &data_buff[0] + (to_read - linear), buff + linear);
+			tmp_tail += to_read;
 
 			std::atomic_signal_fence(std::memory_order_release);
 			tail.store(tmp_tail, index_release_barrier);
@@ -466,6 +531,165 @@ namespace jnk0le
 			return read;
 		}
 
+	/*!
+	 * \brief Lock free ringbuffer with multiple producers and a single consumer
+	 *
+	 * Producers reserve a block of slots with a CAS on the reserve index, copy their data without holding anything
+	 * and then publish in reservation order: a producer whose block follows one that is still being copied waits
+	 * (yielding) for it. Every writeBuff() is all or nothing, so the elements of one call are never interleaved with
+	 * another producer's. The consumer side is the same as Ringbuffer's.
+	 *
+	 * \tparam T Type of buffered elements
+	 * \tparam buffer_size Size of the buffer. Must be a power of 2.
+	 * \tparam cacheline_size Size of the cache line, to insert appropriate padding in between indexes and buffer.
+	 * Must be a power of 2; the indexes are written from several threads, so unlike Ringbuffer there is no unpadded
+	 * default.
+	 * \tparam index_t Type of array indexing type.
+	 */
+	template<typename T, size_t buffer_size = 16, size_t cacheline_size = 64, typename index_t = size_t>
+		class MpscRingbuffer
+		{
+		public:
+			/*!
+			 * \brief Contiguous region of the internal buffer
+			 */
+			struct Span
+			{
+				T* data;
+				size_t size;
+			};
+
+			MpscRingbuffer() : reserve(0), head(0), tail(0) {}
+
+			/*!
+			 * \brief Clear buffer from consumer side
+			 * \warning Must not be called while a producer is between reserving and publishing
+			 */
+			void consumerClear(void) {
+				tail.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			}
+
+			bool isEmpty(void) const {
+				return readAvailable() == 0;
+			}
+
+			/*!
+			 * \brief Check how many published elements can be read from the buffer
+			 */
+			index_t readAvailable(void) const {
+				return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed);
+			}
+
+			/*!
+			 * \brief Check how many slots are neither reserved nor unread
+			 */
+			index_t writeAvailable(void) const {
+				return buffer_size - (reserve.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire));
+			}
+
+			/*!
+			 * \brief Insert count elements as one contiguous block, from any thread, without blocking on space
+			 * \param[in] buff Pointer to buffer with data to be inserted from
+			 * \param count Number of elements to write, at most buffer_size
+			 * \return count if the block was written, 0 if there was not enough space for all of it
+			 */
+			size_t writeBuff(const T* buff, size_t count);
+
+			/*!
+			 * \brief Load multiple elements from internal buffer without blocking (consumer only)
+			 * \return Number of elements that were read from internal buffer
+			 */
+			size_t readBuff(T* buff, size_t count);
+
+			/*!
+			 * \brief Gets the published elements as at most two contiguous regions, see Ringbuffer::readSpans()
+			 */
+			size_t readSpans(Span& first, Span& second) {
+				index_t tmp_tail = tail.load(std::memory_order_relaxed);
+				index_t avail = head.load(std::memory_order_acquire) - tmp_tail;
+				size_t offset = tmp_tail & buffer_mask;
+				size_t linear = (avail < buffer_size - offset) ? avail : buffer_size - offset;
+				first = Span{&data_buff[offset], linear};
+				second = Span{&data_buff[0], avail - linear};
+				return avail;
+			}
+
+			/*!
+			 * \brief Removes multiple elements without reading (consumer only)
+			 * \return Number of removed elements
+			 */
+			size_t remove(size_t cnt) {
+				index_t tmp_tail = tail.load(std::memory_order_relaxed);
+				index_t avail = head.load(std::memory_order_acquire) - tmp_tail;
+
+				cnt = (cnt > avail) ? avail : cnt;
+
+				tail.store(tmp_tail + cnt, std::memory_order_release);
+				return cnt;
+			}
+
+		private:
+			constexpr static index_t buffer_mask = buffer_size-1; //!< bitwise mask for a given buffer size
+
+			alignas(cacheline_size) std::atomic<index_t> reserve; //!< end of the slots claimed by producers
+			alignas(cacheline_size) std::atomic<index_t> head; //!< end of the published slots
+			alignas(cacheline_size) std::atomic<index_t> tail; //!< tail index
+
+			alignas(cacheline_size) T data_buff[buffer_size]; //!< actual buffer
+
+			static_assert((buffer_size != 0), "buffer cannot be of zero size");
+			static_assert((buffer_size & buffer_mask) == 0, "buffer size is not a power of 2");
+			static_assert(cacheline_size != 0 && (cacheline_size & (cacheline_size - 1)) == 0,
+				"cache line size is not a power of 2");
+			static_assert(std::numeric_limits<index_t>::is_integer, "indexing type is not integral type");
+			static_assert(!(std::numeric_limits<index_t>::is_signed), "indexing type shall not be signed");
+			static_assert(buffer_mask <= ((std::numeric_limits<index_t>::max)() >> 1),
+				"buffer size is too large for a given indexing type (maximum size for n-bit type is 2^(n-1))");
+		};
+
+	template<typename T, size_t buffer_size, size_t cacheline_size, typename index_t>
+		size_t MpscRingbuffer<T, buffer_size, cacheline_size, index_t>::writeBuff(const T* buff, size_t count)
+		{
+			if(count == 0 || count > buffer_size)
+				return 0;
+
+			// claim [start, start + count) unless the consumer still owns part of it
+			index_t start = reserve.load(std::memory_order_relaxed);
+			do
+			{
+				if(buffer_size - (start - tail.load(std::memory_order_acquire)) < count)
+					return 0;
+			} while(!reserve.compare_exchange_weak(start, start + count, std::memory_order_relaxed));
+
+			size_t offset = start & buffer_mask;
+			size_t linear = (count < buffer_size - offset) ? count : buffer_size - offset;
+			std::copy(buff, buff + linear, &data_buff[offset]);
+			std::copy(buff + linear, buff + count, &data_buff[0]);
+
+			// publish in reservation order
+			while(head.load(std::memory_order_acquire) != start)
+				std::this_thread::yield();
+			head.store(start + count, std::memory_order_release);
+
+			return count;
+		}
+
+	template<typename T, size_t buffer_size, size_t cacheline_size, typename index_t>
+		size_t MpscRingbuffer<T, buffer_size, cacheline_size, index_t>::readBuff(T* buff, size_t count)
+		{
+			index_t tmp_tail = tail.load(std::memory_order_relaxed);
+			index_t available = head.load(std::memory_order_acquire) - tmp_tail;
+			size_t to_read = (available < count) ? available : count;
+
+			size_t offset = tmp_tail & buffer_mask;
+			size_t linear = (to_read < buffer_size - offset) ? to_read : buffer_size - offset;
+			std::copy(&data_buff[offset], &data_buff[offset] + linear, buff);
+			std::copy(&data_buff[0], &data_buff[0] + (to_read - linear), buff + linear);
+
+			tail.store(tmp_tail + to_read, std::memory_order_release);
+			return to_read;
+		}
+
 } // namespace
 
 #endif //RINGBUFFER_HPP
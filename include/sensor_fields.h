@@ -0,0 +1,162 @@
+#ifndef SENSOR_FIELDS_H
+#define SENSOR_FIELDS_H
+
+#include <cstddef>
+#include <cstdint>
+#include "master_sensor_struct.h"
+
+// Field table for MasterSensorData: one row per member with its JSON key,
+// its offset/type in the struct, and where it lives in sensors.fbs (union
+// member + field index in that table). Both telemetry decoders are driven
+// by it, so adding a sensor field means a struct member plus one row here
+// (and the schema, for the binary link).
+
+typedef enum
+{
+    FIELD_ULONG, // unsigned long
+    FIELD_INT,   // int
+    FIELD_FLOAT, // float
+    FIELD_U8,    // uint8_t (FlatBuffers `byte`)
+} SensorFieldType;
+
+// which sensors.fbs table a field is read from; values match SensorDataUnion
+typedef enum
+{
+    FB_SENSOR_BATCH = 0, // SensorBatch itself
+    FB_BME688 = 1,
+    FB_ENS160 = 2,
+    FB_LSM6D032 = 3,
+    FB_MPL_ALTIMETER = 4,
+    FB_BNO055 = 5,
+} SensorFieldTable;
+
+struct SensorField
+{
+    const char *name;
+    size_t offset;
+    SensorFieldType type;
+    SensorFieldTable table;
+    uint8_t fb_index; // field index inside `table` (declaration order in the schema)
+};
+
+#define SENSOR_FIELD(name, type, table, index) {#name, offsetof(MasterSensorData, name), type, table, index}
+
+// Sorted by name, which sensor_field_find() relies on (checked below).
+constexpr SensorField SENSOR_FIELDS[] = {
+    SENSOR_FIELD(bme_altitude, FIELD_FLOAT, FB_BME688, 4),
+    SENSOR_FIELD(bme_gas_resistance, FIELD_FLOAT, FB_BME688, 3),
+    SENSOR_FIELD(bme_humidity, FIELD_FLOAT, FB_BME688, 2),
+    SENSOR_FIELD(bme_pressure, FIELD_FLOAT, FB_BME688, 1),
+    SENSOR_FIELD(bme_temperature, FIELD_FLOAT, FB_BME688, 0),
+    SENSOR_FIELD(bno_accel_x, FIELD_FLOAT, FB_BNO055, 0),
+    SENSOR_FIELD(bno_accel_y, FIELD_FLOAT, FB_BNO055, 1),
+    SENSOR_FIELD(bno_accel_z, FIELD_FLOAT, FB_BNO055, 2),
+    SENSOR_FIELD(bno_calibration_accel, FIELD_U8, FB_BNO055, 20),
+    SENSOR_FIELD(bno_calibration_gyro, FIELD_U8, FB_BNO055, 19),
+    SENSOR_FIELD(bno_calibration_mag, FIELD_U8, FB_BNO055, 21),
+    SENSOR_FIELD(bno_calibration_system, FIELD_U8, FB_BNO055, 18),
+    SENSOR_FIELD(bno_euler_heading, FIELD_FLOAT, FB_BNO055, 9),
+    SENSOR_FIELD(bno_euler_pitch, FIELD_FLOAT, FB_BNO055, 11),
+    SENSOR_FIELD(bno_euler_roll, FIELD_FLOAT, FB_BNO055, 10),
+    SENSOR_FIELD(bno_gravity_x, FIELD_FLOAT, FB_BNO055, 15),
+    SENSOR_FIELD(bno_gravity_y, FIELD_FLOAT, FB_BNO055, 16),
+    SENSOR_FIELD(bno_gravity_z, FIELD_FLOAT, FB_BNO055, 17),
+    SENSOR_FIELD(bno_gyro_x, FIELD_FLOAT, FB_BNO055, 6),
+    SENSOR_FIELD(bno_gyro_y, FIELD_FLOAT, FB_BNO055, 7),
+    SENSOR_FIELD(bno_gyro_z, FIELD_FLOAT, FB_BNO055, 8),
+    SENSOR_FIELD(bno_linear_accel_x, FIELD_FLOAT, FB_BNO055, 12),
+    SENSOR_FIELD(bno_linear_accel_y, FIELD_FLOAT, FB_BNO055, 13),
+    SENSOR_FIELD(bno_linear_accel_z, FIELD_FLOAT, FB_BNO055, 14),
+    SENSOR_FIELD(bno_mag_x, FIELD_FLOAT, FB_BNO055, 3),
+    SENSOR_FIELD(bno_mag_y, FIELD_FLOAT, FB_BNO055, 4),
+    SENSOR_FIELD(bno_mag_z, FIELD_FLOAT, FB_BNO055, 5),
+    SENSOR_FIELD(ens_aqi, FIELD_INT, FB_ENS160, 0),
+    SENSOR_FIELD(ens_eco2, FIELD_INT, FB_ENS160, 2),
+    SENSOR_FIELD(ens_hp0, FIELD_FLOAT, FB_ENS160, 3),
+    SENSOR_FIELD(ens_hp1, FIELD_FLOAT, FB_ENS160, 4),
+    SENSOR_FIELD(ens_hp2, FIELD_FLOAT, FB_ENS160, 5),
+    SENSOR_FIELD(ens_hp3, FIELD_FLOAT, FB_ENS160, 6),
+    SENSOR_FIELD(ens_tvoc, FIELD_INT, FB_ENS160, 1),
+    SENSOR_FIELD(lsm_accel_x, FIELD_FLOAT, FB_LSM6D032, 0),
+    SENSOR_FIELD(lsm_accel_y, FIELD_FLOAT, FB_LSM6D032, 1),
+    SENSOR_FIELD(lsm_accel_z, FIELD_FLOAT, FB_LSM6D032, 2),
+    SENSOR_FIELD(lsm_gyro_x, FIELD_FLOAT, FB_LSM6D032, 3),
+    SENSOR_FIELD(lsm_gyro_y, FIELD_FLOAT, FB_LSM6D032, 4),
+    SENSOR_FIELD(lsm_gyro_z, FIELD_FLOAT, FB_LSM6D032, 5),
+    SENSOR_FIELD(mpl_altitude, FIELD_FLOAT, FB_MPL_ALTIMETER, 1),
+    SENSOR_FIELD(mpl_pressure, FIELD_FLOAT, FB_MPL_ALTIMETER, 0),
+    SENSOR_FIELD(timestamp, FIELD_ULONG, FB_SENSOR_BATCH, 0),
+};
+
+#undef SENSOR_FIELD
+
+constexpr size_t SENSOR_FIELD_COUNT = sizeof(SENSOR_FIELDS) / sizeof(SENSOR_FIELDS[0]);
+
+constexpr int sensor_field_strcmp(const char *a, const char *b, size_t b_len)
+{
+    size_t i = 0;
+    for (; i < b_len && a[i] != '\0'; i++)
+    {
+        if (a[i] != b[i])
+        {
+            return (unsigned char)a[i] < (unsigned char)b[i] ? -1 : 1;
+        }
+    }
+    if (i == b_len)
+    {
+        return a[i] == '\0' ? 0 : 1;
+    }
+    return -1;
+}
+
+constexpr size_t sensor_field_strlen(const char *s)
+{
+    size_t n = 0;
+    while (s[n] != '\0')
+    {
+        n++;
+    }
+    return n;
+}
+
+constexpr bool sensor_fields_sorted()
+{
+    for (size_t i = 1; i < SENSOR_FIELD_COUNT; i++)
+    {
+        const char *prev = SENSOR_FIELDS[i - 1].name;
+        const char *cur = SENSOR_FIELDS[i].name;
+        if (sensor_field_strcmp(prev, cur, sensor_field_strlen(cur)) >= 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(sensor_fields_sorted(), "SENSOR_FIELDS must be sorted by name");
+
+// Binary search on the key (not NUL terminated); nullptr if unknown.
+constexpr const SensorField *sensor_field_find(const char *key, size_t len)
+{
+    size_t lo = 0, hi = SENSOR_FIELD_COUNT;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        int c = sensor_field_strcmp(SENSOR_FIELDS[mid].name, key, len);
+        if (c == 0)
+        {
+            return &SENSOR_FIELDS[mid];
+        }
+        if (c < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return nullptr;
+}
+
+#endif // SENSOR_FIELDS_H
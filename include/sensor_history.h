@@ -0,0 +1,95 @@
+#ifndef SENSOR_HISTORY_H
+#define SENSOR_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "aligned_allocator.h"
+#include "master_sensor_struct.h"
+#include "sensor_fields.h"
+
+// samples kept by default: 17 minutes at one poll per second
+const size_t SENSOR_HISTORY_CAPACITY = 1024;
+
+// columns computed from others on append(), after the SENSOR_FIELDS ones
+const char *const SENSOR_DERIVED_COLUMNS[] = {
+    "lsm_accel_magnitude",        // |lsm_accel|, m/s2 including gravity
+    "bno_linear_accel_magnitude", // |bno_linear_accel|, m/s2 without gravity
+};
+const size_t SENSOR_DERIVED_COUNT = sizeof(SENSOR_DERIVED_COLUMNS) / sizeof(SENSOR_DERIVED_COLUMNS[0]);
+
+/**
+ * @brief Aggregates of one column over a time window. NaN readings are
+ *        skipped; with no valid reading count is 0 and the rest is NaN.
+ */
+struct SensorStats
+{
+    size_t count;
+    float min;
+    float max;
+    float mean;
+    float slope; // least squares, units per second; NaN below two readings
+};
+
+/**
+ * @brief The most recent MasterSensorData samples, one contiguous float
+ *        column per field.
+ *
+ * Every SENSOR_FIELDS row except the timestamp is a column (integer fields
+ * are converted to float), followed by SENSOR_DERIVED_COLUMNS. The columns
+ * are a ring of capacity() samples each: append() writes one slot per
+ * column and overwrites the oldest sample once full, so it is O(1) and
+ * never allocates.
+ *
+ * Samples are keyed by their timestamp, which has to increase. A repeated
+ * timestamp is the same sample polled twice and is ignored; a smaller one
+ * means the Teensy restarted, which clears the history.
+ *
+ * stats() walks the window as at most two contiguous runs per column, in
+ * independent SIMD-width lanes the compiler vectorizes without needing
+ * -ffast-math. Not thread safe.
+ */
+class SensorHistory
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit SensorHistory(size_t capacity = SENSOR_HISTORY_CAPACITY);
+
+    // false if the sample was ignored, see above
+    bool append(const MasterSensorData &data);
+    void clear();
+
+    size_t size() const { return count; }
+    size_t capacity() const { return mask + 1; }
+    bool empty() const { return count == 0; }
+
+    // column of a SENSOR_FIELDS or SENSOR_DERIVED_COLUMNS name, -1 if unknown
+    // (or "timestamp")
+    static int column(const char *name);
+    static size_t column_count() { return COLUMN_COUNT; }
+
+    // timestamp and value `age` samples before the newest one (age < size())
+    unsigned long timestamp(size_t age = 0) const;
+    float value(int column, size_t age = 0) const;
+
+    // over the samples no more than span_ms older than the newest one
+    SensorStats stats(int column, unsigned long span_ms) const;
+
+private:
+    static const size_t COLUMN_COUNT = SENSOR_FIELD_COUNT - 1 + SENSOR_DERIVED_COUNT;
+
+    // physical slot of the sample `index` samples after the oldest one
+    size_t slot(size_t index) const { return (head - count + index) & mask; }
+    // index (from the oldest) of the first sample at or after t
+    size_t lower_bound(unsigned long t) const;
+
+    size_t mask;
+    size_t head;  // next slot to write
+    size_t count; // samples held
+
+    std::vector<unsigned long> timestamps;
+    AlignedVector<float> columns; // column c starts at c * capacity()
+};
+
+#endif // SENSOR_HISTORY_H
@@ -0,0 +1,28 @@
+#ifndef STRESS_H
+#define STRESS_H
+
+#include "config.h"
+#include "logger.h"
+
+// default run time of every thread count
+const double STRESS_SECONDS = 5.0;
+
+/**
+ * @brief Measures how much modulation one board sustains in parallel.
+ *
+ * Runs ax25frame -> afsk -> modulate on synthetic packets in 1, 2, 4, ...
+ * up to config.stress_threads worker threads (0: one per core), each thread
+ * with its own Modulator and pinned to its own core, for
+ * config.stress_seconds per thread count. The output goes to /dev/null,
+ * so only the DSP is measured. Modulation settings (backend, chain, rate,
+ * sample format, framing) come from config.
+ *
+ * Every thread count logs aggregate MSPS, packets per second, how many
+ * real-time channels that is, per-packet latency percentiles and the
+ * scaling efficiency against one thread.
+ *
+ * @return 0, or 1 if /dev/null cannot be opened.
+ */
+int run_stress(quill::Logger *logger, const Config &config);
+
+#endif // STRESS_H
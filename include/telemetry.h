@@ -0,0 +1,62 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "master_sensor_struct.h"
+#include "interconnect.h"
+#include "logger.h"
+#include "telemetry_log.h"
+
+// Decoders from the two Teensy wire formats into MasterSensorData.
+
+typedef enum
+{
+    SENSOR_JSON_OK,
+    SENSOR_JSON_NOT_SENSOR, // valid JSON object, but no "timestamp"
+    SENSOR_JSON_MALFORMED,
+} SensorJsonStatus;
+
+// Parses one flat JSON telemetry object into `out` (float fields it does
+// not mention are NaN, the others 0). Single pass, no allocation, driven by SENSOR_FIELDS;
+// error_offset, if given, receives the byte where parsing failed.
+SensorJsonStatus sensor_data_from_json(const char *msg, size_t len, MasterSensorData &out,
+                                       size_t *error_offset = nullptr);
+
+// Verifies and reads a size-prefixed FlatBuffers SensorBatch in place (no
+// copy of the buffer, no allocation), using the vtable slots in SENSOR_FIELDS. The float fields of sensors without
+// a message in the batch are NaN. Returns false if the buffer does not verify or this build has no FlatBuffers
+// support.
+bool sensor_data_from_batch(const uint8_t *buf, size_t len, MasterSensorData &out);
+
+// Whether this build can decode SensorBatch frames at all.
+bool sensor_batch_supported();
+
+/**
+ * @brief One telemetry poll over the link in whichever format was
+ *        negotiated. Keeps the receive buffers between polls.
+ */
+class TelemetryReader
+{
+public:
+    TelemetryReader(quill::Logger *logger, SerialLink &link);
+
+    // Requests and decodes one sample; logs and returns false on failure.
+    // Decoded samples are also appended to the telemetry log, if one is set.
+    bool poll(MasterSensorData &out);
+
+    void set_log(TelemetryLog *log) { sink = log; }
+
+private:
+    bool request(MasterSensorData &out);
+
+    quill::Logger *logger;
+    SerialLink &link;
+    std::string json_msg;
+    std::vector<uint8_t> frame;
+    TelemetryLog *sink;
+};
+
+#endif // TELEMETRY_H
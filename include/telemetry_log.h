@@ -0,0 +1,113 @@
+#ifndef TELEMETRY_LOG_H
+#define TELEMETRY_LOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "logger.h"
+#include "ringbuffer.hpp"
+#include "master_sensor_struct.h"
+
+// On-disk format, native byte order (the files are read back on the same
+// kind of host). Every file starts with a TelemetryLogHeader followed by
+// fixed-size records: a TelemetryRecordHeader and the raw MasterSensorData.
+// A record whose CRC does not match, or a short tail after a power cut, is
+// dropped when the file is reopened or read.
+
+const char TELEMETRY_LOG_MAGIC[8] = {'F', 'R', 'A', 'N', 'C', 'T', 'L', '1'};
+const uint32_t TELEMETRY_LOG_VERSION = 1;
+
+struct TelemetryLogHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size; // sizeof(TelemetryRecordHeader) + data_size
+    uint32_t data_size;   // sizeof(MasterSensorData) of the writer
+    uint32_t reserved[3];
+};
+
+struct TelemetryRecordHeader
+{
+    uint32_t seq;     // per process, from 0; gaps mean dropped records
+    uint16_t flags;   // reserved, 0
+    uint16_t crc;     // ax25_fcs() of the MasterSensorData bytes
+    int64_t unix_ns;  // wall clock when the sample was logged
+};
+
+struct TelemetryRecord
+{
+    TelemetryRecordHeader header;
+    MasterSensorData data;
+};
+
+/**
+ * @brief Append-only binary log of every telemetry sample, written by its
+ *        own thread.
+ *
+ * append() only copies the record into a lock-free SPSC ring (one producer:
+ * whoever polls the Teensy) and never blocks or touches the disk; records
+ * are dropped and counted if the writer falls a whole ring behind. The
+ * writer thread batches queued records into one write(), fdatasync()s at
+ * most every fsync_ms, and rotates `path` to path.1 ... path.<keep_files>
+ * once it reaches max_bytes. An existing file with the same layout is
+ * appended to, so a restart doesn't lose the flight so far.
+ */
+class TelemetryLog
+{
+public:
+    TelemetryLog(quill::Logger *logger, const std::string &path, uint64_t max_bytes, int keep_files,
+                 int fsync_ms);
+    ~TelemetryLog();
+
+    TelemetryLog(const TelemetryLog &) = delete;
+    TelemetryLog &operator=(const TelemetryLog &) = delete;
+
+    // Opens the file and starts the writer thread.
+    bool start();
+    // Writes what is queued, syncs, closes.
+    void stop();
+
+    // Producer side, non-blocking; false if the record was dropped.
+    bool append(const MasterSensorData &data);
+
+    uint64_t written() const { return records_written.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return records_dropped.load(std::memory_order_relaxed); }
+
+private:
+    void writer_loop();
+    bool open_file();
+    void close_file();
+    void rotate();
+    bool write_all(const void *data, size_t size);
+
+    quill::Logger *logger;
+    std::string path;
+    uint64_t max_bytes;
+    int keep_files;
+    int fsync_ms;
+
+    static const size_t QUEUE_SIZE = 256; // records, ~4 minutes at 1 Hz
+
+    jnk0le::Ringbuffer<TelemetryRecord, QUEUE_SIZE> queue;
+    std::vector<TelemetryRecord> staging;
+    uint32_t next_seq;
+
+    int fd;
+    uint64_t file_size;
+    bool dirty; // written since the last fdatasync
+
+    std::atomic<bool> running;
+    std::mutex wake_lock;
+    std::condition_variable wake;
+    std::thread writer;
+
+    std::atomic<uint64_t> records_written{0};
+    std::atomic<uint64_t> records_dropped{0};
+};
+
+#endif // TELEMETRY_LOG_H
@@ -1,19 +1,151 @@
 #ifndef HACKRF_TRANSMITTER_H
 #define HACKRF_TRANSMITTER_H
 
+#include <hackrf.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 
 #include "logger.h"
 #include "config.h"
+#include "iqstream.h"
+
+// bytes libhackrf asks for per TX callback (one USB transfer)
+const size_t HACKRF_TRANSFER_SIZE = 262144;
+
+// how often a burst in progress checks that streaming is still alive; the
+// normal end of a burst is signalled by its callback
+const int HACKRF_STREAM_CHECK_MS = 50;
+
+struct HackRfBurstEnd;
+
+/**
+ * @brief Long-lived HackRF session.
+ *
+ * Opened once from the [hackrf] config section; the device stays initialized,
+ * tuned and gain-configured between bursts, so each transmission only starts
+ * and stops TX streaming. If a burst fails with a USB error the session is
+ * torn down and rebuilt (hackrf_exit/init/open + configure) automatically.
+ */
+class HackRfTransmitter
+{
+public:
+    explicit HackRfTransmitter(quill::Logger *logger);
+    ~HackRfTransmitter();
+
+    HackRfTransmitter(const HackRfTransmitter &) = delete;
+    HackRfTransmitter &operator=(const HackRfTransmitter &) = delete;
+
+    /**
+     * @brief Remembers the [hackrf] settings and opens the device.
+     * @return false if the device could not be opened; a later burst retries.
+     */
+    bool open(const Config &config);
+
+    /**
+     * @brief Takes over frequency, amplifier and TX VGA gain from a reloaded
+     *        config. Thread safe; applied before the next burst starts (the
+     *        sample rate only changes on open()).
+     */
+    void update(const Config &config);
+
+    /**
+     * @brief Closes the device and releases libhackrf.
+     */
+    void close();
+
+    bool is_open() const { return device != nullptr; }
+
+    /**
+     * @brief Transmit an IQ_S8 file in one burst. A reader thread keeps the
+     *        file ahead of the USB callback through an IQStream, as in
+     *        transmit_stream().
+     */
+    bool transmit_file(const std::string &filename);
+
+    /**
+     * @brief Transmit IQ_S8 samples straight from memory, see transmit_s8_iq_stream().
+     */
+    bool transmit_stream(IQStream &stream);
+
+    /**
+     * @brief Transmit a complete IQ_S8 burst that is already in memory.
+     */
+    bool transmit_buffer(const int8_t *data, size_t size);
+
+    /**
+     * @brief Fills one USB transfer of `size` bytes; false ends the session
+     *        after this transfer (which must still be filled). Runs on the
+     *        libhackrf transfer thread.
+     */
+    typedef std::function<bool(int8_t *buffer, size_t size)> TxSource;
+
+    /**
+     * @brief One streaming session for as long as fill keeps returning true,
+     *        see TxQueue.
+     */
+    bool transmit_source(const TxSource &fill);
+
+    double sample_rate() const { return sampleRate; }
+
+    // USB transfers that had to be padded because the samples were late,
+    // over all stream and file bursts
+    uint64_t underruns() const { return total_underruns; }
+
+private:
+    bool reopen();
+    bool configure();
+    bool take_update();
+    bool run_burst(hackrf_sample_block_cb_fn callback, void *ctx, HackRfBurstEnd &end);
+
+    quill::Logger *logger;
+    hackrf_device *device;
+
+    // [hackrf] settings applied on every (re)open
+    uint64_t frequency;
+    double sampleRate;
+    int amplifier;
+    int txvga_gain;
+
+    // update() from another thread, taken over by the TX thread
+    std::mutex update_lock;
+    bool update_pending;
+    uint64_t next_frequency;
+    int next_amplifier;
+    int next_txvga_gain;
+
+    // read-ahead ring for transmit_file(), created on first use
+    std::unique_ptr<IQStream> file_stream;
+    uint64_t total_underruns;
+};
+
 /**
  * @brief Transmit an IQ_S8 file (int8_t I/Q interleaved) using HackRF.
  *
  * Replicates the behavior of:
  *   hackrf_transfer -f 144390000 -s 2400000 -t pkt.s8 -a 1 -x 40
  *
+ * Opens and closes a one-shot HackRfTransmitter; long-running callers should
+ * keep their own HackRfTransmitter instead.
+ *
  * @param filename Path to the .s8 file containing interleaved I/Q samples (signed 8-bit).
  * @return true if transmission completed successfully, false otherwise.
  */
-bool transmit_s8_iq_file(const std::string &filename, quill::Logger *logger, Config config);
+bool transmit_s8_iq_file(const std::string &filename, quill::Logger *logger, const Config &config);
+
+/**
+ * @brief Transmit IQ_S8 samples straight from memory, as the modulator produces them.
+ *
+ * Waits for the stream to prefill one USB transfer, then streams until the
+ * producer closes it and it is drained. On failure the stream is aborted so a
+ * producer blocked in IQStream::write() returns.
+ *
+ * @param stream Stream filled concurrently by modulate(waveform, stream).
+ * @return true if transmission completed successfully, false otherwise.
+ */
+bool transmit_s8_iq_stream(IQStream &stream, quill::Logger *logger, const Config &config);
 
 #endif // HACKRF_TRANSMITTER_H
@@ -0,0 +1,106 @@
+#ifndef TX_QUEUE_H
+#define TX_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "logger.h"
+#include "transmitter.h"
+
+// default time TX stays keyed, silent, after the last queued packet
+const int TX_IDLE_MS = 250;
+// results kept for wait(): tickets this far behind the newest completed one
+// are forgotten, so tickets nobody waits on do not pile up
+const uint64_t TX_RESULTS_KEPT = 1024;
+
+/**
+ * @brief Queue of IQ_S8 packets sent through one HackRF streaming session.
+ *
+ * submit() copies a packet into the queue. A session starts only when
+ * packets are waiting, not per packet, and the USB callback takes them
+ * back to back. Packets queued while a session is on air join it. Once
+ * the queue runs dry the transfers are padded with zero samples: TX stays
+ * keyed but silent (zero amplitude, only LO leakage, no carrier). After
+ * idle_ms of that the session ends and TX is keyed off until the next
+ * submit().
+ *
+ * wait() blocks on a condition variable until the packet was handed to
+ * libhackrf in full, or dropped because its session failed. Then the
+ * packet's last byte is at most a few USB transfers from the antenna.
+ * Waiting is optional; a ticket's result is kept until TX_RESULTS_KEPT
+ * later tickets completed.
+ */
+class TxQueue
+{
+public:
+    TxQueue(quill::Logger *logger, HackRfTransmitter &transmitter, int idle_ms = TX_IDLE_MS);
+    ~TxQueue();
+
+    TxQueue(const TxQueue &) = delete;
+    TxQueue &operator=(const TxQueue &) = delete;
+
+    /**
+     * @brief Queues a copy of the packet. Thread safe.
+     * @return Ticket for wait(), increasing in submit order.
+     */
+    uint64_t submit(const int8_t *data, size_t size);
+
+    /**
+     * @brief Blocks until the packet of ticket is done.
+     * @return true if it was sent, false if its session failed, the queue
+     *         was stopped first, or the result was already forgotten.
+     */
+    bool wait(uint64_t ticket);
+
+    // sends what is queued, then ends the session and joins the TX thread
+    void stop();
+
+    uint64_t sessions() const;
+    uint64_t packets() const;
+
+private:
+    struct Packet
+    {
+        uint64_t ticket;
+        std::vector<int8_t> iq;
+    };
+
+    void session_loop();
+    // HackRfTransmitter::TxSource, on the libhackrf thread
+    bool fill(int8_t *buffer, size_t size);
+    // marks ticket done; the lock must be held
+    void complete(uint64_t ticket, bool sent);
+
+    quill::Logger *logger;
+    HackRfTransmitter &transmitter;
+    int idle_ms;
+    size_t idle_limit; // bytes of padding after which a session ends
+
+    mutable std::mutex lock;
+    std::condition_variable queued; // submit() / stop() -> session thread
+    std::condition_variable done;   // packet done -> wait()
+    std::deque<Packet> pending;
+    uint64_t next_ticket;
+    std::set<uint64_t> outstanding; // submitted, not done yet
+    std::set<uint64_t> failed;      // done, but not sent, newer than forgotten
+    uint64_t forgotten;             // results of tickets up to this one are dropped
+    bool stopping;
+
+    // owned by the libhackrf thread while a session is on air
+    Packet current;
+    size_t current_offset;
+    bool have_current;
+    size_t idle_bytes;
+
+    uint64_t session_count;
+    uint64_t packet_count;
+    std::thread session_thread;
+};
+
+#endif // TX_QUEUE_H
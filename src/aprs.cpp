@@ -1,5 +1,7 @@
 #include "aprs.h"
 
+#include <new>
+
 void usage()
 {
     fprintf(stderr, "Usage: aprs -c <callsign> [-d <destination>] [-p <path>] [-o <output>] [-f <format>] <message>\n"
@@ -12,81 +14,109 @@ void usage()
     exit(1);
 }
 
-std::vector<int8_t> f32_to_s8(const std::vector<std::complex<float>> &input)
+void modulate(const std::vector<float> &waveform, const IQWriter &write, OutputFormat iq_sf,
+              ModulatorBackend backend)
 {
-    std::vector<int8_t> result(input.size() * 2);
-    for (int i = 0; i < (int)input.size(); i++)
-    {
-        result[i * 2] = input[i].real() * SCHAR_MAX;
-        result[i * 2 + 1] = input[i].imag() * SCHAR_MAX;
-    }
-    return result;
+    Modulator &modulator = default_modulator();
+    modulator.set_backend(backend);
+    modulator.modulate(waveform, write, iq_sf);
+}
+
+void modulate(const std::vector<float> &waveform, FILE *fout, OutputFormat iq_sf,
+              ModulatorBackend backend)
+{
+    modulate(waveform, [fout](const void *data, size_t size)
+             { fwrite(data, 1, size, fout); }, iq_sf, backend);
 }
 
-// FM modulation + interpolation (x50)
-// output sample rate: 48000 * 50 = 2400000
-void modulate(const std::vector<float> &waveform, FILE *fout, OutputFormat iq_sf)
+void modulate(const std::vector<float> &waveform, IQStream &stream, ModulatorBackend backend)
 {
-    float max_deviation = 5000; // 5kHz deviation
-    float sensitivity = 2 * M_PI * max_deviation / (float)AUDIO_SAMPLE_RATE;
-    float factor = 50.0;
-    float fractional_bw = 0.4;
-    float halfband = 0.5;
-    float trans_width = halfband - fractional_bw;
-    float mid_transition_band = halfband - trans_width / 2.0;
-    std::vector<float> taps = lowpass(factor, factor, mid_transition_band, trans_width);
+    Modulator &modulator = default_modulator();
+    modulator.set_backend(backend);
+    modulator.modulate(waveform, stream);
+}
+
+struct gen_iq_s8_ctx
+{
+    Modulator modulator;
+};
 
-    Ringbuffer_t mod_buf;
-    FIRInterpolator interp(factor, taps);
-    float last_phase = 0;
-    int offset = 0;
-    while (offset < (int)waveform.size())
+static const char *GEN_IQ_S8_DEST = "APRS";
+
+extern "C"
+{
+    int8_t *gen_iq_s8(const char *callsign, const char *user_path, const char *info, int32_t *total)
     {
-        int input_size = std::min(BUFSIZE, (int)waveform.size() - offset);
-        last_phase = fmmod(waveform.data() + offset, input_size, mod_buf, sensitivity, last_phase);
+        static thread_local gen_iq_s8_ctx ctx;
 
-        std::vector<std::complex<float>> interp_buf;
-        int processed = interp.interpolate(mod_buf, interp_buf);
-        if (!processed)
+        int64_t size = gen_iq_s8_begin(&ctx, callsign, user_path, info);
+        if (size < 0 || size > INT32_MAX)
         {
-            break;
+            return 0;
         }
-        mod_buf.remove(processed);
-        if (iq_sf == IQ_S8)
+        int8_t *samples = (int8_t *)malloc(size);
+        if (!samples)
         {
-            auto samples_s8 = f32_to_s8(interp_buf);
-            fwrite(samples_s8.data(), sizeof(int8_t), samples_s8.size(), fout);
+            return 0;
         }
-        else
+        *total = (int32_t)ctx.modulator.read_packet(samples, size);
+        return samples;
+    }
+
+    gen_iq_s8_ctx *gen_iq_s8_create(void)
+    {
+        return new (std::nothrow) gen_iq_s8_ctx;
+    }
+
+    void gen_iq_s8_destroy(gen_iq_s8_ctx *ctx)
+    {
+        delete ctx;
+    }
+
+    int64_t gen_iq_s8_size(gen_iq_s8_ctx *ctx, const char *callsign, const char *user_path, const char *info)
+    {
+        if (!ctx || !callsign || !user_path || !info)
         {
-            fwrite(interp_buf.data(), sizeof(std::complex<float>), interp_buf.size(), fout);
+            return -1;
         }
-        offset += input_size;
+        return ctx->modulator.packet_size(callsign, GEN_IQ_S8_DEST, user_path, info, IQ_S8);
     }
-}
 
-extern "C"
-{
-    int8_t *gen_iq_s8(const char *callsign, const char *user_path, const char *info, int32_t *total)
+    int64_t gen_iq_s8_generate_into(gen_iq_s8_ctx *ctx, const char *callsign, const char *user_path,
+                                    const char *info, int8_t *out, int64_t capacity)
     {
-        const char *dest = "APRS";
-        char path[64];
-        strncpy(path, user_path, 63);
+        if (!out || capacity < 0)
+        {
+            return -1;
+        }
+        // begin_packet() frames the packet once and already knows its size
+        int64_t size = gen_iq_s8_begin(ctx, callsign, user_path, info);
+        if (size < 0)
+        {
+            return -1;
+        }
+        if (size > capacity)
+        {
+            return -size;
+        }
+        return ctx->modulator.read_packet(out, capacity);
+    }
 
-        auto frame = ax25frame(callsign, dest, path, info, false);
-        auto frame_nrzi = nrzi(frame);
-        auto wave = afsk(frame_nrzi);
+    int64_t gen_iq_s8_begin(gen_iq_s8_ctx *ctx, const char *callsign, const char *user_path, const char *info)
+    {
+        if (!ctx || !callsign || !user_path || !info)
+        {
+            return -1;
+        }
+        return ctx->modulator.begin_packet(callsign, GEN_IQ_S8_DEST, user_path, info, IQ_S8);
+    }
 
-        // interpolation factor is 50 and each sample is 2 bytes
-        *total = wave.size() * 50 * 2;
-        int8_t *samples = (int8_t *)malloc(*total);
-        if (!samples)
+    int64_t gen_iq_s8_read(gen_iq_s8_ctx *ctx, int8_t *out, int64_t capacity)
+    {
+        if (!ctx || !out || capacity < 0)
         {
-            return 0;
+            return -1;
         }
-        FILE *f = fmemopen(samples, *total, "wb");
-        modulate(wave, f, IQ_S8);
-        fclose(f);
-        return samples;
+        return ctx->modulator.read_packet(out, capacity);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,248 @@
+#include "aprs_telemetry.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+
+// one analog channel: count = (value - offset) / step, received as
+// value = step * count + offset (EQNS a = 0)
+struct AnalogChannel
+{
+    const char *name;
+    const char *unit;
+    float MasterSensorData::*field;
+    float step;
+    float offset;
+};
+
+const AnalogChannel ANALOG[APRS_TELEMETRY_CHANNELS] = {
+    {"Temp", "C", &MasterSensorData::bme_temperature, 0.5f, -50.0f},   // -50 .. 77.5 C
+    {"Press", "hPa", &MasterSensorData::bme_pressure, 5.0f, 0.0f},     // 0 .. 1275 hPa
+    {"Hum", "%", &MasterSensorData::bme_humidity, 0.5f, 0.0f},         // 0 .. 127.5 %
+    {"Alt", "m", &MasterSensorData::mpl_altitude, 20.0f, -100.0f},     // -100 .. 5000 m
+    {"AccZ", "m/s2", &MasterSensorData::lsm_accel_z, 0.5f, -64.0f},    // +-64 m/s2
+};
+
+// digital channels: BNO055 subsystems reporting full calibration (3)
+const char *const BIT_NAMES[APRS_TELEMETRY_BITS] = {"SysCal", "GyrCal", "AccCal", "MagCal", "", "", "", ""};
+const uint8_t MasterSensorData::*const BIT_FIELDS[4] = {
+    &MasterSensorData::bno_calibration_system, &MasterSensorData::bno_calibration_gyro,
+    &MasterSensorData::bno_calibration_accel, &MasterSensorData::bno_calibration_mag};
+
+// status fields: value, decimals shown, unit
+struct StatusChannel
+{
+    float MasterSensorData::*field;
+    int decimals;
+    const char *suffix;
+};
+
+const StatusChannel STATUS[] = {
+    {&MasterSensorData::bme_temperature, 1, "C"},
+    {&MasterSensorData::bme_pressure, 1, "hPa"},
+    {&MasterSensorData::bme_humidity, 1, "%RH"},
+    {&MasterSensorData::mpl_altitude, 0, "m"},
+    {&MasterSensorData::lsm_accel_z, 1, "m/s2"},
+};
+
+// keeps the scaled integer (and the text) in range for garbage readings
+const float STATUS_LIMIT = 1e9f;
+
+const int POW10[] = {1, 10, 100, 1000};
+
+// value limited to lo..hi; NaN and infinities pass, changed() drops them
+double clamp_finite(double value, double lo, double hi)
+{
+    return std::isfinite(value) ? std::min(hi, std::max(lo, value)) : value;
+}
+
+// scaled / 10^decimals with `decimals` places
+char *format_fixed(char *p, char *end, long long scaled, int decimals)
+{
+    if (scaled < 0)
+    {
+        *p++ = '-';
+        scaled = -scaled;
+    }
+    p = std::to_chars(p, end, scaled / POW10[decimals]).ptr;
+    if (decimals > 0)
+    {
+        *p++ = '.';
+        long long frac = scaled % POW10[decimals];
+        for (int d = decimals - 1; d >= 0; d--)
+        {
+            p[d] = (char)('0' + frac % 10);
+            frac /= 10;
+        }
+        p += decimals;
+    }
+    return p;
+}
+
+// n digits, zero padded, value < 10^n
+void format_padded(char *p, unsigned value, int n)
+{
+    for (int d = n - 1; d >= 0; d--)
+    {
+        p[d] = (char)('0' + value % 10);
+        value /= 10;
+    }
+}
+
+} // namespace
+
+AprsTelemetry::AprsTelemetry(float deadband)
+    : deadband_steps(std::max(0.0f, deadband)),
+      sequence(0),
+      formatted_count(0),
+      skipped_count(0)
+{
+    static_assert(sizeof(STATUS) / sizeof(STATUS[0]) == STATUS_FIELDS, "one StatusField per STATUS entry");
+
+    std::memset(meta, 0, sizeof(meta));
+    std::memset(analog, 0, sizeof(analog));
+    std::memset(fields, 0, sizeof(fields));
+    std::fill(bits, bits + APRS_TELEMETRY_BITS, 0);
+
+    // the separators are written once; report() only fills the slots
+    std::memcpy(report_buf, "T#000", 5);
+    char *p = report_buf + 5;
+    for (int c = 0; c < APRS_TELEMETRY_CHANNELS; c++, p += 4)
+    {
+        std::memcpy(p, ",000", 4);
+    }
+    *p++ = ',';
+    std::memset(p, '0', APRS_TELEMETRY_BITS);
+    p[APRS_TELEMETRY_BITS] = '\0';
+
+    status_buf[0] = '\0';
+    set_addressee("");
+}
+
+void AprsTelemetry::set_deadband(float steps)
+{
+    deadband_steps = std::max(0.0f, steps);
+}
+
+void AprsTelemetry::set_addressee(const char *callsign)
+{
+    char padded[10];
+    std::snprintf(padded, sizeof(padded), "%-9.9s", callsign);
+    if (meta[0][0] != '\0' && std::strcmp(padded, addressee) == 0)
+    {
+        return;
+    }
+    std::memcpy(addressee, padded, sizeof(addressee));
+    build_metadata();
+}
+
+void AprsTelemetry::build_metadata()
+{
+    // :ADDRESSEE:PARM.name,...  (one message per line of the definition)
+    char *parm = meta[0], *unit = meta[1], *eqns = meta[2], *bitsense = meta[3];
+    int np = std::snprintf(parm, APRS_INFO_MAX, ":%s:PARM.", addressee);
+    int nu = std::snprintf(unit, APRS_INFO_MAX, ":%s:UNIT.", addressee);
+    int ne = std::snprintf(eqns, APRS_INFO_MAX, ":%s:EQNS.", addressee);
+    for (int c = 0; c < APRS_TELEMETRY_CHANNELS; c++)
+    {
+        const char *sep = c ? "," : "";
+        np += std::snprintf(parm + np, APRS_INFO_MAX - np, "%s%s", sep, ANALOG[c].name);
+        nu += std::snprintf(unit + nu, APRS_INFO_MAX - nu, "%s%s", sep, ANALOG[c].unit);
+        ne += std::snprintf(eqns + ne, APRS_INFO_MAX - ne, "%s0,%g,%g", sep, ANALOG[c].step, ANALOG[c].offset);
+    }
+    for (int b = 0; b < APRS_TELEMETRY_BITS && BIT_NAMES[b][0]; b++)
+    {
+        np += std::snprintf(parm + np, APRS_INFO_MAX - np, ",%s", BIT_NAMES[b]);
+        nu += std::snprintf(unit + nu, APRS_INFO_MAX - nu, ",cal");
+    }
+    std::snprintf(bitsense, APRS_INFO_MAX, ":%s:BITS.11111111,FRANC telemetry", addressee);
+}
+
+bool AprsTelemetry::changed(Held &held, double steps)
+{
+    // a dropped reading keeps the last good one
+    if (!std::isfinite(steps))
+    {
+        return false;
+    }
+    if (held.valid && std::fabs(steps - (double)held.count) <= deadband_steps)
+    {
+        return false;
+    }
+    held.count = std::llround(steps);
+    held.valid = true;
+    return true;
+}
+
+const char *AprsTelemetry::report(const MasterSensorData &data)
+{
+    format_padded(report_buf + 2, sequence, 3);
+    sequence = (sequence + 1) % 1000;
+
+    for (int c = 0; c < APRS_TELEMETRY_CHANNELS; c++)
+    {
+        const AnalogChannel &ch = ANALOG[c];
+        // counts outside the 8-bit range all read as its end
+        double steps = clamp_finite(((double)(data.*ch.field) - ch.offset) / ch.step, 0, 255);
+        if (!changed(analog[c], steps))
+        {
+            skipped_count++;
+            continue;
+        }
+        format_padded(report_buf + 5 + 4 * c + 1, (unsigned)analog[c].count, 3);
+        formatted_count++;
+    }
+
+    char *digital = report_buf + 5 + 4 * APRS_TELEMETRY_CHANNELS + 1;
+    for (int b = 0; b < 4; b++)
+    {
+        int bit = data.*BIT_FIELDS[b] == 3;
+        if (bit != bits[b])
+        {
+            bits[b] = bit;
+            digital[b] = (char)('0' + bit);
+        }
+    }
+    return report_buf;
+}
+
+const char *AprsTelemetry::status(const MasterSensorData &data)
+{
+    char *out = status_buf;
+    *out++ = '>';
+    for (int f = 0; f < STATUS_FIELDS; f++)
+    {
+        const StatusChannel &ch = STATUS[f];
+        StatusField &field = fields[f];
+        double value = clamp_finite(data.*ch.field, -STATUS_LIMIT, STATUS_LIMIT);
+        if (changed(field.held, value * POW10[ch.decimals]))
+        {
+            char *p = format_fixed(field.text, field.text + STATUS_FIELD_MAX, field.held.count, ch.decimals);
+            size_t n = std::strlen(ch.suffix);
+            std::memcpy(p, ch.suffix, n);
+            field.length = p + n - field.text;
+            formatted_count++;
+        }
+        else
+        {
+            skipped_count++;
+        }
+        if (field.length == 0)
+        {
+            continue; // no reading yet
+        }
+        if (out > status_buf + 1)
+        {
+            *out++ = ' ';
+        }
+        std::memcpy(out, field.text, field.length);
+        out += field.length;
+    }
+    *out = '\0';
+    return status_buf;
+}
@@ -4,15 +4,17 @@
 #include <cstdint>
 #include <cstdlib>
 #include <ctype.h>
+#include <array>
 
-static std::vector<uint8_t> encode_callsign(const char *callsign)
+// encodes callsign[0..len) as 6 space padded characters + SSID digit
+static void encode_callsign(const char *callsign, size_t len, uint8_t *out)
 {
     char cs[16] = {0};
-    if (strlen(callsign) >= sizeof(cs)) {
-        fprintf(stderr, "Invalid callsign: %s\n", callsign);
+    if (len >= sizeof(cs)) {
+        fprintf(stderr, "Invalid callsign: %.*s\n", (int)len, callsign);
         exit(1);
     }
-    for (int i = 0; i < (int)strlen(callsign); i++) {
+    for (int i = 0; i < (int)len; i++) {
         cs[i] = toupper(callsign[i]);
     }
     int ssid = 0;
@@ -22,7 +24,7 @@ static std::vector<uint8_t> encode_callsign(const char *callsign)
         *pos = 0;
     }
     if (strlen(cs) > 6) {
-        fprintf(stderr, "Invalid callsign: %s\n", callsign);
+        fprintf(stderr, "Invalid callsign: %.*s\n", (int)len, callsign);
         exit(1);
     }
     if (ssid < 0 || ssid > 15) {
@@ -31,8 +33,14 @@ static std::vector<uint8_t> encode_callsign(const char *callsign)
     }
     char buf[8] = {0}; // callsign(6 bytes) + ssid(1 byte) + null
     sprintf(buf, "%-6s%c", cs, '0' + ssid);
+    memcpy(out, buf, 7);
+}
 
-    return std::vector<uint8_t>(buf, buf+7);
+static std::vector<uint8_t> encode_callsign(const char *callsign)
+{
+    std::vector<uint8_t> result(7);
+    encode_callsign(callsign, strlen(callsign), result.data());
+    return result;
 }
 
 static std::vector<uint8_t> encode_address(const char *callsign, const char *dest, char *path)
@@ -115,6 +123,269 @@ std::vector<bool> nrzi(const std::vector<bool> &data)
     return result;
 }
 
+// CRC-16/X.25 lookup table (reflected polynomial 0x8408), one entry per byte
+static constexpr std::array<uint16_t, 256> make_fcs_table()
+{
+    std::array<uint16_t, 256> table = {};
+    for (int n = 0; n < 256; n++) {
+        uint16_t crc = n;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+        }
+        table[n] = crc;
+    }
+    return table;
+}
+
+static constexpr std::array<uint16_t, 256> FCS_TABLE = make_fcs_table();
+
+uint16_t ax25_fcs(const uint8_t *data, size_t len)
+{
+    uint16_t ret = 0xffff;
+    for (size_t i = 0; i < len; i++) {
+        ret = (ret >> 8) ^ FCS_TABLE[(ret ^ data[i]) & 0xff];
+    }
+    return ~ret;
+}
+
+// Appends NRZI encoded bits to a PackedBits, 64 at a time.
+class NrziWriter
+{
+public:
+    // appends to an empty `out`, starting from NRZI level `level`
+    NrziWriter(PackedBits &out, bool level) : out(out), acc(0), nacc(0), level(level), ones(0) {}
+
+    bool current_level() const { return level; }
+
+    // one bit without stuffing (sync bits, flags)
+    inline void raw(bool bit)
+    {
+        // 0 is encoded as change in tone, 1 is encoded as no change in tone
+        if (!bit) {
+            level = !level;
+        }
+        acc |= (uint64_t)level << nacc;
+        if (++nacc == 64) {
+            flush_word();
+        }
+    }
+
+    // LSB first, no stuffing
+    inline void raw_byte(uint8_t b)
+    {
+        for (int i = 0; i < 8; i++) {
+            raw(b & 1);
+            b >>= 1;
+        }
+    }
+
+    // LSB first, stuffing a 0 after every 5 consecutive 1s
+    inline void stuffed_byte(uint8_t b)
+    {
+        for (int i = 0; i < 8; i++) {
+            if (b & 1) {
+                raw(true);
+                if (++ones == 5) {
+                    raw(false);
+                    ones = 0;
+                }
+            } else {
+                raw(false);
+                ones = 0;
+            }
+            b >>= 1;
+        }
+    }
+
+    void finish()
+    {
+        size_t whole = out.count / 8;
+        out.count += nacc;
+        out.bytes.resize((out.count + 7) / 8);
+        for (int i = 0; i < nacc; i += 8) {
+            out.bytes[whole++] = acc >> i;
+        }
+        acc = 0;
+        nacc = 0;
+    }
+
+private:
+    void flush_word()
+    {
+        for (int i = 0; i < 64; i += 8) {
+            out.bytes.push_back(acc >> i);
+        }
+        out.count += 64;
+        acc = 0;
+        nacc = 0;
+    }
+
+    PackedBits &out;
+    uint64_t acc;
+    int nacc;
+    bool level;
+    int ones;
+};
+
+static const uint8_t AX25_FLAG = 0x7e;
+
+// frame bytes without flags: addr, control, protocol, info, fcs
+static const std::vector<uint8_t> &build_frame(const char *callsign, const char *dest, const char *path, const char *info)
+{
+    const uint8_t control = 0x03;
+    const uint8_t protocol = 0xf0;
+
+    static thread_local std::vector<uint8_t> frame;
+    frame.clear();
+    size_t info_len = strlen(info);
+    frame.reserve(7 * 10 + 2 + info_len + 2);
+
+    auto append_callsign = [](const char *cs, size_t len) {
+        size_t at = frame.size();
+        frame.resize(at + 7);
+        encode_callsign(cs, len, frame.data() + at);
+    };
+    append_callsign(dest, strlen(dest));
+    append_callsign(callsign, strlen(callsign));
+    for (const char *p = path; *p;) {
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len > 0) {
+            append_callsign(p, len);
+        }
+        p += len;
+        if (*p == ',') {
+            p++;
+        }
+    }
+    // see 3.12. Address-Field Encoding, AX25 spec
+    for (auto &b : frame) {
+        b <<= 1;
+    }
+    frame.back() |= 0x01;
+
+    frame.push_back(control);
+    frame.push_back(protocol);
+    frame.insert(frame.end(), info, info + info_len);
+    uint16_t fcs = ax25_fcs(frame.data(), frame.size());
+    // FCS is sent MSB first, all other fields are sent LSB first
+    frame.push_back(fcs & 0xff);
+    frame.push_back((fcs >> 8) & 0xff);
+    return frame;
+}
+
+static void write_preamble(NrziWriter &w, int preamble_flags)
+{
+    for (int i = 0 ; i < AX25_SYNC_BITS ; i++) {
+        w.raw(false);
+    }
+    for (int i = 0 ; i < preamble_flags ; i++) {
+        w.raw_byte(AX25_FLAG);
+    }
+}
+
+static void write_payload(NrziWriter &w, const std::vector<uint8_t> &frame)
+{
+    for (auto b : frame) {
+        w.stuffed_byte(b);
+    }
+    w.raw_byte(AX25_FLAG);
+}
+
+// upper bound: every 5th payload bit stuffed
+static size_t payload_bits(const std::vector<uint8_t> &frame)
+{
+    return frame.size() * 8 * 6 / 5 + 8 + 8;
+}
+
+void ax25frame_nrzi(const char *callsign, const char *dest, const char *path, const char *info,
+                    PackedBits &out, int preamble_flags)
+{
+    const auto &frame = build_frame(callsign, dest, path, info);
+
+    out.clear();
+    out.reserve(AX25_SYNC_BITS + 8 * preamble_flags + payload_bits(frame));
+
+    NrziWriter w(out, true);
+    write_preamble(w, preamble_flags);
+    write_payload(w, frame);
+    w.finish();
+}
+
+bool ax25preamble_nrzi(PackedBits &out, int preamble_flags)
+{
+    out.clear();
+    out.reserve(AX25_SYNC_BITS + 8 * preamble_flags);
+
+    NrziWriter w(out, true);
+    write_preamble(w, preamble_flags);
+    w.finish();
+    return w.current_level();
+}
+
+bool ax25payload_nrzi(const char *callsign, const char *dest, const char *path, const char *info,
+                      PackedBits &out, bool level)
+{
+    const auto &frame = build_frame(callsign, dest, path, info);
+
+    out.clear();
+    out.reserve(payload_bits(frame));
+
+    NrziWriter w(out, level);
+    write_payload(w, frame);
+    w.finish();
+    return w.current_level();
+}
+
+// inverse of encode_callsign() on a shifted address: "CALL-SSID", or
+// "CALL" for SSID 0
+static std::string decode_callsign(const uint8_t *addr)
+{
+    std::string cs;
+    for (int i = 0; i < 6 && (addr[i] >> 1) != ' '; i++) {
+        cs += (char)(addr[i] >> 1);
+    }
+    int ssid = (addr[6] >> 1) & 0x0f;
+    if (ssid) {
+        cs += '-';
+        cs += std::to_string(ssid);
+    }
+    return cs;
+}
+
+bool ax25_parse(const uint8_t *frame, size_t len, Ax25Packet &packet)
+{
+    if (len < AX25_MIN_FRAME) {
+        return false;
+    }
+    // addresses run up to the one with the extension bit set
+    size_t end = 0;
+    while (end + 7 <= len - 4 && !(frame[end + 6] & 0x01)) {
+        end += 7;
+    }
+    end += 7;
+    if (end < 14 || end > 70 || end + 4 > len || !(frame[end - 1] & 0x01)) {
+        return false;
+    }
+    const uint8_t control = 0x03;
+    const uint8_t protocol = 0xf0;
+    if (frame[end] != control || frame[end + 1] != protocol) {
+        return false;
+    }
+
+    packet.dest = decode_callsign(frame);
+    packet.callsign = decode_callsign(frame + 7);
+    packet.path.clear();
+    for (size_t at = 14; at < end; at += 7) {
+        if (!packet.path.empty()) {
+            packet.path += ',';
+        }
+        packet.path += decode_callsign(frame + at);
+    }
+    packet.info.assign((const char *)frame + end + 2, len - end - 4);
+    return true;
+}
+
 std::vector<bool> ax25frame(const char *callsign, const char *dest, char *path, const char *info, bool debug)
 {
     // addr = dest (7bytes), source (7bytes), path (0-56 bytes)
@@ -137,12 +408,12 @@ std::vector<bool> ax25frame(const char *callsign, const char *dest, char *path,
     std::vector<bool> result;
     // frame will be preceded with zeros (which NRZI will encode as alternating tones)
     // to assist with decoder clock sync
-    for (int i = 0 ; i < 20 ; i++) {
+    for (int i = 0 ; i < AX25_SYNC_BITS ; i++) {
         result.push_back(false);
     }
     const std::vector<bool> flag = {0, 1, 1, 1, 1, 1, 1, 0};
     // not sure why we need so many flags at the beginning
-    for (int i = 0 ; i < 100 ; i++) {
+    for (int i = 0 ; i < AX25_PREAMBLE_FLAGS ; i++) {
         result.insert(result.end(), flag.begin(), flag.end());
     }
     result.insert(result.end(), stuffed_frame.begin(), stuffed_frame.end());
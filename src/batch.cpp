@@ -0,0 +1,132 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+BatchEncoder::BatchEncoder(quill::Logger *logger, ModulatorBackend backend, int preamble_flags, int silence_ms,
+                           int gap_ms, int workers, double sample_rate, int resampler_stages,
+                           ModulatorChain chain)
+    : logger(logger),
+      backend(backend),
+      preamble_flags(preamble_flags),
+      packet_silence_ms(std::max(0, gap_ms) / 2),
+      pad_ms(0),
+      workers(workers > 0 ? workers : std::max(1u, std::thread::hardware_concurrency())),
+      sample_rate(sample_rate),
+      resampler_stages(resampler_stages),
+      chain(chain)
+{
+    pad_ms = std::max(0, silence_ms - packet_silence_ms);
+}
+
+BatchEncoder::~BatchEncoder() = default;
+
+size_t BatchEncoder::encode(const char *callsign, const char *dest, const char *path,
+                            const std::vector<std::string> &infos, const IQWriter &write, OutputFormat iq_sf)
+{
+    const size_t count = infos.size();
+    if (count == 0)
+    {
+        return 0;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    const size_t nthreads = std::min(workers, count);
+    while (modulators.size() < nthreads)
+    {
+        modulators.emplace_back(
+            new Modulator(backend, preamble_flags, packet_silence_ms, sample_rate, resampler_stages, chain));
+    }
+    outputs.resize(std::max(outputs.size(), count));
+
+    std::mutex lock;
+    std::condition_variable cond;
+    std::vector<char> done(count, 0);
+    std::atomic<size_t> next{0};
+
+    auto work = [&](Modulator &modulator)
+    {
+        for (size_t i = next++; i < count; i = next++)
+        {
+            std::vector<uint8_t> &out = outputs[i];
+            out.resize(modulator.begin_packet(callsign, dest, path, infos[i].c_str(), iq_sf));
+            out.resize(modulator.read_packet(out.data(), out.size()));
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                done[i] = 1;
+            }
+            cond.notify_all();
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(nthreads);
+    for (size_t t = 0; t < nthreads; t++)
+    {
+        threads.emplace_back(work, std::ref(*modulators[t]));
+    }
+
+    // the carrier is the same on every polyphase branch only up to the
+    // filter ripple, so repeat whole periods of the resampler's output
+    const size_t frame = iq_sf == IQ_S8 ? 2 : iq_sf == IQ_F32 ? sizeof(std::complex<float>) : sizeof(float);
+    const Modulator &first = *modulators[0];
+    const size_t unit = frame * (iq_sf == PCM_F32 ? 1 : first.resampler().period());
+    const double rate = iq_sf == PCM_F32 ? (double)AUDIO_SAMPLE_RATE : first.sample_rate();
+    const size_t pad = frame * (size_t)std::llround(rate * pad_ms / 1000);
+
+    size_t written = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            cond.wait(guard, [&]()
+                      { return done[i] != 0; });
+        }
+        const std::vector<uint8_t> &out = outputs[i];
+        if (i == 0 && out.size() >= unit)
+        {
+            // ends on a period boundary, right before the first sample
+            write_carrier(out.data(), unit, (unit - pad % unit) % unit, pad, write);
+            written += pad;
+        }
+        write(out.data(), out.size());
+        written += out.size();
+        if (i == count - 1 && out.size() >= unit)
+        {
+            write_carrier(out.data() + out.size() - unit, unit, 0, pad, write);
+            written += pad;
+        }
+    }
+
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+
+    LOG_DEBUG(logger, "Batch of {} packets on {} threads: {} bytes in {} ms", count, nthreads, written,
+              std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+    return written;
+}
+
+void BatchEncoder::write_carrier(const uint8_t *unit, size_t unit_size, size_t offset, size_t size,
+                                 const IQWriter &write)
+{
+    // staged in blocks of up to 256 periods; every block starts at the same
+    // point of the period, one extra period covers the offset
+    const size_t block = std::min<size_t>((size + unit_size - 1) / unit_size, 256);
+    carrier.resize((block + 1) * unit_size);
+    for (size_t i = 0; i <= block; i++)
+    {
+        std::copy(unit, unit + unit_size, carrier.begin() + i * unit_size);
+    }
+    while (size > 0)
+    {
+        size_t n = std::min(size, block * unit_size);
+        write(carrier.data() + offset, n);
+        size -= n;
+    }
+}
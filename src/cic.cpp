@@ -0,0 +1,134 @@
+#include "cic.h"
+#include "nco.h"
+#include "fir_kernels.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// 3 tap inverse-sinc^3 at the input rate: 1 + (N/24) w^2 matches the CIC
+// droop up to w^4 terms, 0.09 dB -> 0.001 dB at 2200 Hz
+static const float COMP_SIDE = CIC_ORDER / 24.0f;
+static const float COMP_CENTER = 1 + 2 * COMP_SIDE;
+
+// the phase accumulator is a 4th integrator in 64 bits; its top half is
+// the nco.h phase
+static const int PHASE_SHIFT = 32;
+static const uint64_t PHASE_ROUND = 1ull << (PHASE_SHIFT - 1);
+
+struct S8Pair
+{
+    int8_t i, q;
+};
+
+// {cos, sin} per nco.h table entry, one load per output
+static const std::complex<float> *nco_iq_table()
+{
+    static const std::vector<std::complex<float>> table = []()
+    {
+        const float *sine = nco_sin_table();
+        std::vector<std::complex<float>> t(NCO_LUT_SIZE);
+        for (int i = 0; i < NCO_LUT_SIZE; i++) {
+            t[i] = std::complex<float>(sine[i + NCO_LUT_SIZE / 4], sine[i]);
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+// the same, quantized exactly like f32_to_s8() would
+static const S8Pair *nco_s8_table()
+{
+    static const std::vector<S8Pair> table = []()
+    {
+        std::vector<S8Pair> t(NCO_LUT_SIZE);
+        fir_quantizer(FIR_SCALAR)(reinterpret_cast<const float *>(nco_iq_table()), NCO_LUT_SIZE * 2, SCHAR_MAX,
+                                  reinterpret_cast<int8_t *>(t.data()));
+        return t;
+    }();
+    return table.data();
+}
+
+CicFmInterpolator::CicFmInterpolator(int interpolation, int decimation, float sensitivity)
+    : l(std::max(1, interpolation)), m(std::max(1, decimation))
+{
+    // phase step per tick: sensitivity / l radians per unit; the CIC has a
+    // DC gain of l^(N-1), so scale the input by step * 2^32 / l^(N-1)
+    double step = sensitivity / l * (4294967296.0 / (2 * M_PI));
+    input_scale = step * std::ldexp(1.0, PHASE_SHIFT) / std::pow((double)l, CIC_ORDER - 1);
+    reset();
+}
+
+void CicFmInterpolator::reset()
+{
+    std::memset(&st, 0, sizeof(st));
+}
+
+size_t CicFmInterpolator::output_count(size_t count, int grid) const
+{
+    // multiples of m in [grid, grid + count * l)
+    size_t end = grid + count * l;
+    return (end + m - 1) / m - (grid > 0 ? 1 : 0);
+}
+
+size_t CicFmInterpolator::process(const float *input, size_t count, std::complex<float> *output)
+{
+    return run(input, count, output, nco_iq_table());
+}
+
+size_t CicFmInterpolator::process(const float *input, size_t count, int8_t *output)
+{
+    return run(input, count, reinterpret_cast<S8Pair *>(output), nco_s8_table());
+}
+
+template <typename T>
+size_t CicFmInterpolator::run(const float *input, size_t count, T *output, const T *table)
+{
+    State s = st;
+    size_t produced = 0;
+    for (size_t i = 0; i < count; i++) {
+        // droop compensation, one sample of delay
+        float x = input[i];
+        float c = COMP_CENTER * s.history[0] - COMP_SIDE * (x + s.history[1]);
+        s.history[1] = s.history[0];
+        s.history[0] = x;
+
+        uint64_t v = (uint64_t)(int64_t)std::llrint(c * input_scale);
+        for (int k = 0; k < CIC_ORDER; k++) {
+            uint64_t d = v - s.comb[k];
+            s.comb[k] = v;
+            v = d;
+        }
+
+        // zero stuffed: the comb output enters on the first tick only, so
+        // over the next l ticks the phase is a cubic in the tick t
+        const uint64_t i0 = s.integ[0] + v, i1 = s.integ[1], i2 = s.integ[2], p = s.phase;
+        auto phase_at = [&](uint64_t t)
+        {
+            return p + t * i2 + t * (t + 1) / 2 * i1 + t * (t + 1) * (t + 2) / 6 * i0;
+        };
+
+        // and on the ticks of the output grid, m apart, a cubic in the
+        // output index: forward differences, exact modulo 2^64
+        uint64_t t = (m - s.grid) % m + 1;
+        uint64_t f0 = phase_at(t), f1 = phase_at(t + m), f2 = phase_at(t + 2 * m), f3 = phase_at(t + 3 * m);
+        uint64_t d1 = f1 - f0, d2 = f2 - 2 * f1 + f0, d3 = f3 - 3 * f2 + 3 * f1 - f0;
+        for (; t <= (uint64_t)l; t += m) {
+            uint32_t phase = (uint32_t)((f0 + PHASE_ROUND) >> PHASE_SHIFT);
+            output[produced++] = table[nco_index(phase) & (NCO_LUT_SIZE - 1)];
+            f0 += d1;
+            d1 += d2;
+            d2 += d3;
+        }
+
+        s.integ[0] = i0;
+        s.integ[1] = i1 + l * i0;
+        s.integ[2] = i2 + l * i1 + (uint64_t)l * (l + 1) / 2 * i0;
+        s.phase = phase_at(l);
+        s.grid = (int)((s.grid + l) % m);
+    }
+    st = s;
+    return produced;
+}
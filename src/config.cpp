@@ -1,4 +1,8 @@
 #include "config.h"
+#include "aprs_telemetry.h"
+#include "flight_phase.h"
+#include "stress.h"
+#include "tx_queue.h"
 
 #include <iostream>
 #include <fstream>
@@ -37,12 +41,68 @@ static void set_defaults(Config &config)
     config.output = "pkt8.s8";
     config.info = "Hello from default config!";
     config.iq_sf = IQ_S8;
+    config.tx_mode = TX_STREAM;
+    config.iq_tap = false;
+    config.modulator = MOD_REFERENCE;
+    config.chain = CHAIN_IQ;
+    config.preamble_flags = AX25_PREAMBLE_FLAGS;
+    config.silence_ms = SILENCE_MS;
+    config.binary_link = true;
+    config.beacon_interval_ms = 5000;
+    config.encode_lead_ms = 1000;
+    config.log_level = quill::LogLevel::Info;
     config.amplifier = 1;
     config.txvga_gain = 40;
 
     // HackRF section defaults.
     config.frequency = 144390000.0; // 144.390 MHz
     config.sampleRate = 2000000.0;  // 2 MHz
+    config.resampler_stages = RESAMPLER_MAX_STAGES; // cheapest chain
+    config.tx_idle_ms = TX_IDLE_MS;
+
+    // Serial section defaults.
+    config.serial_port = "/dev/ttyACM0";
+    config.serial_baud = 115200;
+    config.serial_timeout_ms = 1000;
+    config.handshake_timeout_ms = 5000;
+
+    // Batch section defaults (empty queue: one packet per cycle).
+    config.batch_info.clear();
+    config.batch_gap_ms = 100;
+    config.batch_workers = 0;
+
+    // Telemetry log section defaults.
+    config.telemetry_log = true;
+    config.telemetry_log_path = "telemetry.bin";
+    config.telemetry_log_max_bytes = 16 * 1024 * 1024;
+    config.telemetry_log_keep = 8;
+    config.telemetry_log_fsync_ms = 1000;
+
+    // Cache section defaults.
+    config.iq_cache_mb = 64;
+
+    // APRS telemetry section defaults (off: `info` as before).
+    config.aprs_telemetry = false;
+    config.aprs_deadband = APRS_TELEMETRY_DEADBAND;
+    config.aprs_metadata_every = APRS_METADATA_EVERY;
+
+    // Flight section defaults.
+    config.flight_pad_ms = FLIGHT_PAD_INTERVAL_MS;
+    config.flight_boost_ms = FLIGHT_BOOST_INTERVAL_MS;
+    config.flight_coast_ms = FLIGHT_COAST_INTERVAL_MS;
+    config.flight_descent_ms = FLIGHT_DESCENT_INTERVAL_MS;
+    config.flight_landed_ms = FLIGHT_LANDED_INTERVAL_MS;
+    config.flight_launch_accel = FLIGHT_LAUNCH_ACCEL;
+    config.flight_launch_window_ms = FLIGHT_LAUNCH_WINDOW_MS;
+    config.flight_launch_altitude = FLIGHT_LAUNCH_ALTITUDE;
+    config.flight_apogee_drop = FLIGHT_APOGEE_DROP;
+    config.flight_landed_band = FLIGHT_LANDED_BAND;
+    config.flight_events = true;
+
+    // Stress section defaults (only used with --stress).
+    config.stress = false;
+    config.stress_threads = 0;
+    config.stress_seconds = STRESS_SECONDS;
 }
 
 // ------------------------------------------------------------------
@@ -92,6 +152,66 @@ static void set_value(Config &config, const std::string &section,
             else if (val == "pcm")
                 config.iq_sf = PCM_F32;
         }
+        else if (lowerKey == "tx_mode")
+        {
+            if (val == "stream")
+                config.tx_mode = TX_STREAM;
+            else if (val == "file")
+                config.tx_mode = TX_FILE;
+            else if (val == "pipeline")
+                config.tx_mode = TX_PIPELINE;
+        }
+        else if (lowerKey == "iq_tap")
+        {
+            config.iq_tap = (val == "true" || val == "1");
+        }
+        else if (lowerKey == "modulator")
+        {
+            if (val == "reference")
+                config.modulator = MOD_REFERENCE;
+            else if (val == "nco")
+                config.modulator = MOD_NCO;
+        }
+        else if (lowerKey == "chain")
+        {
+            if (val == "iq")
+                config.chain = CHAIN_IQ;
+            else if (val == "cic")
+                config.chain = CHAIN_CIC;
+        }
+        else if (lowerKey == "preamble_flags")
+        {
+            config.preamble_flags = std::atoi(val.c_str());
+        }
+        else if (lowerKey == "silence_ms")
+        {
+            config.silence_ms = std::atoi(val.c_str());
+        }
+        else if (lowerKey == "binary_link")
+        {
+            config.binary_link = (val == "true" || val == "1");
+        }
+        else if (lowerKey == "beacon_interval_ms")
+        {
+            config.beacon_interval_ms = std::atoi(val.c_str());
+        }
+        else if (lowerKey == "encode_lead_ms")
+        {
+            config.encode_lead_ms = std::atoi(val.c_str());
+        }
+        else if (lowerKey == "log_level")
+        {
+            if (val == "trace")
+                config.log_level = quill::LogLevel::TraceL3;
+            else if (val == "debug")
+                config.log_level = quill::LogLevel::Debug;
+            else if (val == "info")
+                config.log_level = quill::LogLevel::Info;
+            else if (val == "warning")
+                config.log_level = quill::LogLevel::Warning;
+            else if (val == "error")
+                config.log_level = quill::LogLevel::Error;
+        }
     }
     else if (lowerSec == "hackrf")
     {
@@ -103,6 +223,10 @@ static void set_value(Config &config, const std::string &section,
         {
             config.sampleRate = std::strtod(val.c_str(), nullptr);
         }
+        else if (lowerKey == "resampler_stages")
+        {
+            config.resampler_stages = std::atoi(val.c_str());
+        }
         else if (lowerKey == "amplifier")
         {
             config.amplifier = std::strtod(val.c_str(), nullptr);
@@ -111,6 +235,148 @@ static void set_value(Config &config, const std::string &section,
         {
             config.txvga_gain = std::strtod(val.c_str(), nullptr);
         }
+        else if (lowerKey == "tx_idle_ms")
+        {
+            config.tx_idle_ms = std::atoi(val.c_str());
+        }
+    }
+    else if (lowerSec == "serial")
+    {
+        if (lowerKey == "port")
+        {
+            config.serial_port = val;
+        }
+        else if (lowerKey == "baud")
+        {
+            config.serial_baud = std::atoi(val.c_str());
+        }
+        else if (lowerKey == "timeout_ms")
+        {
+            config.serial_timeout_ms = std::atoi(val.c_str());
+        }
+        else if (lowerKey == "handshake_timeout_ms")
+        {
+            config.handshake_timeout_ms = std::atoi(val.c_str());
+        }
+    }
+    else if (lowerSec == "batch")
+    {
+        if (lowerKey == "info")
+        {
+            // repeatable, every line queues one more packet
+            config.batch_info.push_back(val);
+        }
+        else if (lowerKey == "gap_ms")
+        {
+            config.batch_gap_ms = std::atoi(val.c_str());
+        }
+        else if (lowerKey == "workers")
+        {
+            config.batch_workers = std::atoi(val.c_str());
+        }
+    }
+    else if (lowerSec == "telemetry_log")
+    {
+        if (lowerKey == "enabled")
+        {
+            config.telemetry_log = (val == "true" || val == "1");
+        }
+        else if (lowerKey == "path")
+        {
+            config.telemetry_log_path = val;
+        }
+        else if (lowerKey == "max_bytes")
+        {
+            config.telemetry_log_max_bytes = std::strtoull(val.c_str(), nullptr, 10);
+        }
+        else if (lowerKey == "keep_files")
+        {
+            config.telemetry_log_keep = std::atoi(val.c_str());
+        }
+        else if (lowerKey == "fsync_ms")
+        {
+            config.telemetry_log_fsync_ms = std::atoi(val.c_str());
+        }
+    }
+    else if (lowerSec == "cache")
+    {
+        if (lowerKey == "max_mb")
+        {
+            config.iq_cache_mb = std::atoi(val.c_str());
+        }
+    }
+    else if (lowerSec == "aprs_telemetry")
+    {
+        if (lowerKey == "enabled")
+        {
+            config.aprs_telemetry = (val == "true" || val == "1");
+        }
+        else if (lowerKey == "deadband")
+        {
+            config.aprs_deadband = std::strtof(val.c_str(), nullptr);
+        }
+        else if (lowerKey == "metadata_every")
+        {
+            config.aprs_metadata_every = std::atoi(val.c_str());
+        }
+    }
+    else if (lowerSec == "flight")
+    {
+        if (lowerKey == "pad_interval_ms")
+        {
+            config.flight_pad_ms = std::atoi(val.c_str());
+        }
+        else if (lowerKey == "boost_interval_ms")
+        {
+            config.flight_boost_ms = std::atoi(val.c_str());
+        }
+        else if (lowerKey == "coast_interval_ms")
+        {
+            config.flight_coast_ms = std::atoi(val.c_str());
+        }
+        else if (lowerKey == "descent_interval_ms")
+        {
+            config.flight_descent_ms = std::atoi(val.c_str());
+        }
+        else if (lowerKey == "landed_interval_ms")
+        {
+            config.flight_landed_ms = std::atoi(val.c_str());
+        }
+        else if (lowerKey == "launch_accel")
+        {
+            config.flight_launch_accel = std::strtof(val.c_str(), nullptr);
+        }
+        else if (lowerKey == "launch_window_ms")
+        {
+            config.flight_launch_window_ms = std::atoi(val.c_str());
+        }
+        else if (lowerKey == "launch_altitude")
+        {
+            config.flight_launch_altitude = std::strtof(val.c_str(), nullptr);
+        }
+        else if (lowerKey == "apogee_drop")
+        {
+            config.flight_apogee_drop = std::strtof(val.c_str(), nullptr);
+        }
+        else if (lowerKey == "landed_band")
+        {
+            config.flight_landed_band = std::strtof(val.c_str(), nullptr);
+        }
+        else if (lowerKey == "events")
+        {
+            config.flight_events = (val == "true" || val == "1");
+        }
+    }
+    else if (lowerSec == "stress")
+    {
+        if (lowerKey == "threads")
+        {
+            config.stress_threads = std::atoi(val.c_str());
+        }
+        else if (lowerKey == "seconds")
+        {
+            config.stress_seconds = std::strtod(val.c_str(), nullptr);
+        }
     }
 }
 
@@ -172,6 +438,163 @@ Config load_config(const std::string &cfgFile, quill::Logger *logger)
     return config;
 }
 
+// ------------------------------------------------------------------
+// valid_address() accepts what encode_callsign() can encode: up to 6
+// characters, optionally followed by -SSID with SSID 0..15
+// ------------------------------------------------------------------
+static bool valid_address(const std::string &address)
+{
+    size_t dash = address.find('-');
+    std::string call = address.substr(0, dash);
+    if (call.empty() || call.size() > 6)
+        return false;
+    if (dash == std::string::npos)
+        return true;
+    std::string ssid = address.substr(dash + 1);
+    if (ssid.empty() || ssid.size() > 2 || !std::all_of(ssid.begin(), ssid.end(), ::isdigit))
+        return false;
+    return std::atoi(ssid.c_str()) <= 15;
+}
+
+// ------------------------------------------------------------------
+// validate_config() rejects values that would only fail later, on air
+// ------------------------------------------------------------------
+bool validate_config(const Config &config, quill::Logger *logger)
+{
+    bool ok = true;
+    if (!config.callsign.empty() && !valid_address(config.callsign))
+    {
+        LOG_ERROR(logger, "callsign '{}' is not a valid AX.25 address", config.callsign);
+        ok = false;
+    }
+    if (!valid_address(config.dest))
+    {
+        LOG_ERROR(logger, "dest '{}' is not a valid AX.25 address", config.dest);
+        ok = false;
+    }
+    // up to 8 digipeaters, comma separated
+    size_t hops = 0;
+    for (size_t start = 0; !config.path.empty() && start <= config.path.size(); hops++)
+    {
+        size_t end = std::min(config.path.find(',', start), config.path.size());
+        std::string hop = config.path.substr(start, end - start);
+        if (!valid_address(hop))
+        {
+            LOG_ERROR(logger, "path entry '{}' is not a valid AX.25 address", hop);
+            ok = false;
+        }
+        start = end + 1;
+    }
+    if (hops > 8)
+    {
+        LOG_ERROR(logger, "path has {} digipeaters, AX.25 allows 8", hops);
+        ok = false;
+    }
+    if (config.amplifier != 0 && config.amplifier != 1)
+    {
+        LOG_ERROR(logger, "amplifier must be 0 or 1, not {}", config.amplifier);
+        ok = false;
+    }
+    if (config.txvga_gain < 0 || config.txvga_gain > 47)
+    {
+        LOG_ERROR(logger, "txvga_gain must be 0..47 dB, not {}", config.txvga_gain);
+        ok = false;
+    }
+    if (config.frequency <= 0)
+    {
+        LOG_ERROR(logger, "frequency {} Hz is not valid", config.frequency);
+        ok = false;
+    }
+    if (config.batch_gap_ms < 0 || config.iq_cache_mb < 0 || config.silence_ms < 0 ||
+        config.preamble_flags < 0 || config.aprs_deadband < 0 || config.aprs_metadata_every < 0 ||
+        config.tx_idle_ms < 0)
+    {
+        LOG_ERROR(logger, "gap_ms, max_mb, silence_ms, preamble_flags, deadband, metadata_every and tx_idle_ms "
+                          "must not be negative");
+        ok = false;
+    }
+    if (config.flight_pad_ms <= 0 || config.flight_boost_ms <= 0 || config.flight_coast_ms <= 0 ||
+        config.flight_descent_ms <= 0 || config.flight_landed_ms <= 0)
+    {
+        LOG_ERROR(logger, "[flight] intervals must be positive");
+        ok = false;
+    }
+    else if (config.flight_launch_window_ms < (int)(FLIGHT_LAUNCH_SAMPLES - 1) * config.flight_pad_ms)
+    {
+        // the confirming samples may only come at the pad rate
+        LOG_ERROR(logger, "[flight] launch_window_ms must hold {} samples at pad_interval_ms", FLIGHT_LAUNCH_SAMPLES);
+        ok = false;
+    }
+    if (!(config.flight_launch_accel > 0) || !(config.flight_launch_altitude > 0) ||
+        !(config.flight_landed_band > 0) || !(config.flight_apogee_drop > config.flight_landed_band))
+    {
+        // a drop within the landed band would call the apogee a landing
+        LOG_ERROR(logger, "[flight] thresholds must be positive, apogee_drop above landed_band");
+        ok = false;
+    }
+    return ok;
+}
+
+// ------------------------------------------------------------------
+// keep_restart_only() pins everything the running objects were built from
+// ------------------------------------------------------------------
+void keep_restart_only(Config &next, const Config &running, quill::Logger *logger)
+{
+#define KEEP(field)                                                                      \
+    if (!(next.field == running.field))                                                  \
+    {                                                                                    \
+        LOG_WARNING(logger, "Config: {} changed, takes effect after a restart", #field); \
+        next.field = running.field;                                                      \
+    }
+    KEEP(iq_sf)
+    KEEP(tx_mode)
+    KEEP(modulator)
+    KEEP(chain)
+    KEEP(preamble_flags)
+    KEEP(silence_ms)
+    KEEP(binary_link)
+    KEEP(beacon_interval_ms)
+    KEEP(encode_lead_ms)
+    KEEP(sampleRate)
+    KEEP(resampler_stages)
+    KEEP(tx_idle_ms)
+    KEEP(serial_port)
+    KEEP(serial_baud)
+    KEEP(serial_timeout_ms)
+    KEEP(handshake_timeout_ms)
+    KEEP(batch_gap_ms)
+    KEEP(batch_workers)
+    KEEP(telemetry_log)
+    KEEP(telemetry_log_path)
+    KEEP(telemetry_log_max_bytes)
+    KEEP(telemetry_log_keep)
+    KEEP(telemetry_log_fsync_ms)
+    KEEP(iq_cache_mb)
+#undef KEEP
+}
+
+// ------------------------------------------------------------------
+// log_level_name() is the config file spelling of a log level
+// ------------------------------------------------------------------
+static const char *log_level_name(quill::LogLevel level)
+{
+    switch (level)
+    {
+    case quill::LogLevel::TraceL3:
+        return "trace";
+    case quill::LogLevel::Debug:
+        return "debug";
+    case quill::LogLevel::Info:
+        return "info";
+    case quill::LogLevel::Warning:
+        return "warning";
+    case quill::LogLevel::Error:
+        return "error";
+    default:
+        return "other";
+    }
+}
+
 // ------------------------------------------------------------------
 // print_config() prints out the loaded configuration (for debugging)
 // ------------------------------------------------------------------
@@ -198,8 +621,61 @@ void print_config(const Config &config)
         std::cout << "pcm\n";
         break;
     }
+    std::cout << "  tx_mode       = " << (config.tx_mode == TX_STREAM ? "stream" : config.tx_mode == TX_PIPELINE ? "pipeline"
+                                                                                                                        : "file")
+              << "\n";
+    std::cout << "  iq_tap        = " << (config.iq_tap ? "true" : "false") << "\n";
+    std::cout << "  modulator     = " << (config.modulator == MOD_NCO ? "nco" : "reference") << "\n";
+    std::cout << "  chain         = " << (config.chain == CHAIN_CIC ? "cic" : "iq") << "\n";
+    std::cout << "  preamble_flags = " << config.preamble_flags << "\n";
+    std::cout << "  silence_ms    = " << config.silence_ms << "\n";
+    std::cout << "  binary_link   = " << (config.binary_link ? "true" : "false") << "\n";
+    std::cout << "  beacon_interval_ms = " << config.beacon_interval_ms << "\n";
+    std::cout << "  encode_lead_ms = " << config.encode_lead_ms << "\n";
+    std::cout << "  log_level     = " << log_level_name(config.log_level) << "\n";
     std::cout << "\n[hackrf]\n";
     std::cout << "  frequency  = " << config.frequency << "\n";
     std::cout << "  sampleRate = " << config.sampleRate << "\n";
+    std::cout << "  resampler_stages = " << config.resampler_stages << "\n";
+    std::cout << "  tx_idle_ms = " << config.tx_idle_ms << "\n";
+    std::cout << "\n[serial]\n";
+    std::cout << "  port                 = " << config.serial_port << "\n";
+    std::cout << "  baud                 = " << config.serial_baud << "\n";
+    std::cout << "  timeout_ms           = " << config.serial_timeout_ms << "\n";
+    std::cout << "  handshake_timeout_ms = " << config.handshake_timeout_ms << "\n";
+    std::cout << "\n[batch]\n";
+    for (const auto &info : config.batch_info)
+    {
+        std::cout << "  info    = " << info << "\n";
+    }
+    std::cout << "  gap_ms  = " << config.batch_gap_ms << "\n";
+    std::cout << "  workers = " << config.batch_workers << "\n";
+    std::cout << "\n[telemetry_log]\n";
+    std::cout << "  enabled    = " << (config.telemetry_log ? "true" : "false") << "\n";
+    std::cout << "  path       = " << config.telemetry_log_path << "\n";
+    std::cout << "  max_bytes  = " << config.telemetry_log_max_bytes << "\n";
+    std::cout << "  keep_files = " << config.telemetry_log_keep << "\n";
+    std::cout << "  fsync_ms   = " << config.telemetry_log_fsync_ms << "\n";
+    std::cout << "\n[cache]\n";
+    std::cout << "  max_mb = " << config.iq_cache_mb << "\n";
+    std::cout << "\n[aprs_telemetry]\n";
+    std::cout << "  enabled        = " << (config.aprs_telemetry ? "true" : "false") << "\n";
+    std::cout << "  deadband       = " << config.aprs_deadband << "\n";
+    std::cout << "  metadata_every = " << config.aprs_metadata_every << "\n";
+    std::cout << "\n[flight]\n";
+    std::cout << "  pad_interval_ms     = " << config.flight_pad_ms << "\n";
+    std::cout << "  boost_interval_ms   = " << config.flight_boost_ms << "\n";
+    std::cout << "  coast_interval_ms   = " << config.flight_coast_ms << "\n";
+    std::cout << "  descent_interval_ms = " << config.flight_descent_ms << "\n";
+    std::cout << "  landed_interval_ms  = " << config.flight_landed_ms << "\n";
+    std::cout << "  launch_accel        = " << config.flight_launch_accel << "\n";
+    std::cout << "  launch_window_ms    = " << config.flight_launch_window_ms << "\n";
+    std::cout << "  launch_altitude     = " << config.flight_launch_altitude << "\n";
+    std::cout << "  apogee_drop         = " << config.flight_apogee_drop << "\n";
+    std::cout << "  landed_band         = " << config.flight_landed_band << "\n";
+    std::cout << "  events              = " << (config.flight_events ? "true" : "false") << "\n";
+    std::cout << "\n[stress]\n";
+    std::cout << "  threads = " << config.stress_threads << "\n";
+    std::cout << "  seconds = " << config.stress_seconds << "\n";
     std::cout << "============================\n\n";
 }
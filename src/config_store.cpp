@@ -0,0 +1,158 @@
+#include "config_store.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+ConfigStore::ConfigStore(quill::Logger *logger, const std::string &path, Adjust adjust)
+    : logger(logger),
+      path(path),
+      adjust(adjust),
+      inotify_fd(-1),
+      stop_fd(-1)
+{
+    size_t slash = path.rfind('/');
+    directory = slash == std::string::npos ? "." : path.substr(0, std::max<size_t>(slash, 1));
+    filename = slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+ConfigStore::~ConfigStore()
+{
+    stop();
+}
+
+bool ConfigStore::load()
+{
+    std::shared_ptr<Config> next = std::make_shared<Config>(load_config(path, logger));
+    if (adjust)
+    {
+        adjust(*next);
+    }
+    if (!validate_config(*next, logger))
+    {
+        return false;
+    }
+    publish(next);
+    return true;
+}
+
+bool ConfigStore::reload()
+{
+    ConfigSnapshot running = current();
+    std::shared_ptr<Config> next = std::make_shared<Config>(load_config(path, logger));
+    if (adjust)
+    {
+        adjust(*next);
+    }
+    if (running)
+    {
+        keep_restart_only(*next, *running, logger);
+    }
+    if (!validate_config(*next, logger))
+    {
+        LOG_ERROR(logger, "Config: {} rejected, keeping the running configuration", path);
+        return false;
+    }
+    publish(next);
+    LOG_INFO(logger, "Config: reloaded {} (generation {})", path, generation());
+    if (on_reload)
+    {
+        on_reload(*next);
+    }
+    return true;
+}
+
+void ConfigStore::publish(const ConfigSnapshot &next)
+{
+    std::atomic_store_explicit(&snapshot, next, std::memory_order_release);
+    published.fetch_add(1, std::memory_order_acq_rel);
+}
+
+bool ConfigStore::watch()
+{
+    if (watcher.joinable())
+    {
+        return true;
+    }
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotify_fd < 0 || stop_fd < 0 ||
+        inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+    {
+        LOG_WARNING(logger, "Config: cannot watch {}: {}; reload disabled", directory, std::strerror(errno));
+        stop();
+        return false;
+    }
+    watcher = std::thread(&ConfigStore::watch_loop, this);
+    return true;
+}
+
+void ConfigStore::stop()
+{
+    if (watcher.joinable())
+    {
+        uint64_t one = 1;
+        ssize_t n = ::write(stop_fd, &one, sizeof(one));
+        (void)n;
+        watcher.join();
+    }
+    if (inotify_fd >= 0)
+    {
+        ::close(inotify_fd);
+        inotify_fd = -1;
+    }
+    if (stop_fd >= 0)
+    {
+        ::close(stop_fd);
+        stop_fd = -1;
+    }
+}
+
+void ConfigStore::watch_loop()
+{
+    alignas(struct inotify_event) char events[4096];
+    bool pending = false;
+    while (true)
+    {
+        struct pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+        // once the file was touched, wait for the writes to settle first
+        int ready = ::poll(fds, 2, pending ? CONFIG_RELOAD_SETTLE_MS : -1);
+        if (ready < 0 && errno != EINTR)
+        {
+            LOG_ERROR(logger, "Config: watcher failed: {}", std::strerror(errno));
+            return;
+        }
+        if (fds[1].revents & POLLIN)
+        {
+            return;
+        }
+        if (ready == 0)
+        {
+            pending = false;
+            reload();
+            continue;
+        }
+        if (!(fds[0].revents & POLLIN))
+        {
+            continue;
+        }
+
+        ssize_t len;
+        while ((len = ::read(inotify_fd, events, sizeof(events))) > 0)
+        {
+            for (char *p = events; p < events + len;)
+            {
+                const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(p);
+                if (event->len > 0 && filename == event->name)
+                {
+                    pending = true;
+                }
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
+    }
+}
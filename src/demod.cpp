@@ -0,0 +1,186 @@
+#include "demod.h"
+#include "dsp.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const uint8_t HDLC_FLAG = 0x7e;
+static const uint32_t HDLC_ABORT = 0x7f;   // seven ones
+static const uint32_t HDLC_STUFFED = 0x3e; // five ones and the stuffed zero
+
+AfskDemodulator::AfskDemodulator(double sample_rate)
+    : rate(sample_rate), decim(std::max(1, (int)std::lround(sample_rate / AUDIO_SAMPLE_RATE)))
+{
+    double audio = rate / decim;
+    window = std::max(1, (int)std::lround(audio / BAUD_RATE));
+    mark_products.resize(window);
+    space_products.resize(window);
+    mark_step = std::polar(1.0f, (float)(2 * M_PI * MARK_HZ / audio));
+    space_step = std::polar(1.0f, (float)(2 * M_PI * SPACE_HZ / audio));
+    pll_step = (float)(BAUD_RATE / audio);
+    frame.reserve(AX25_MAX_FRAME);
+    reset();
+}
+
+void AfskDemodulator::reset()
+{
+    acc = 0;
+    acc_count = 0;
+    prev = 0;
+
+    pos = 0;
+    std::fill(mark_products.begin(), mark_products.end(), std::complex<float>(0));
+    std::fill(space_products.begin(), space_products.end(), std::complex<float>(0));
+    mark_sum = 0;
+    space_sum = 0;
+    mark_osc = 1;
+    space_osc = 1;
+
+    pll_phase = 0;
+    level = false;
+    last_bit_level = false;
+
+    shift = 0;
+    in_frame = false;
+    frame_bits = 0;
+    byte = 0;
+    frame.clear();
+
+    received.clear();
+    fcs_error_count = 0;
+    bad_frame_count = 0;
+}
+
+void AfskDemodulator::process(const std::complex<float> *iq, size_t count)
+{
+    for (size_t i = 0; i < count;) {
+        size_t n = std::min(count - i, (size_t)(decim - acc_count));
+        float re = 0, im = 0;
+        for (size_t k = 0; k < n; k++) {
+            re += iq[i + k].real();
+            im += iq[i + k].imag();
+        }
+        acc += std::complex<float>(re, im);
+        acc_count += n;
+        i += n;
+        if (acc_count == decim) {
+            audio_sample(acc);
+            acc = 0;
+            acc_count = 0;
+        }
+    }
+}
+
+void AfskDemodulator::process(const int8_t *iq, size_t count)
+{
+    for (size_t i = 0; i < count;) {
+        size_t n = std::min(count - i, (size_t)(decim - acc_count));
+        const int8_t *p = iq + 2 * i;
+        int re = 0, im = 0;
+        for (size_t k = 0; k < n; k++) {
+            re += p[2 * k];
+            im += p[2 * k + 1];
+        }
+        acc += std::complex<float>((float)re, (float)im);
+        acc_count += n;
+        i += n;
+        if (acc_count == decim) {
+            audio_sample(acc);
+            acc = 0;
+            acc_count = 0;
+        }
+    }
+}
+
+void AfskDemodulator::audio_sample(std::complex<float> z)
+{
+    // FM discriminator: phase step since the previous sample
+    std::complex<float> d = z * std::conj(prev);
+    prev = z;
+    float audio = std::atan2(d.imag(), d.real());
+
+    // sliding one bit correlation against both tones
+    std::complex<float> m = audio * std::conj(mark_osc);
+    std::complex<float> s = audio * std::conj(space_osc);
+    mark_sum += std::complex<double>(m) - std::complex<double>(mark_products[pos]);
+    space_sum += std::complex<double>(s) - std::complex<double>(space_products[pos]);
+    mark_products[pos] = m;
+    space_products[pos] = s;
+    if (++pos == (size_t)window) {
+        pos = 0;
+    }
+    mark_osc *= mark_step;
+    space_osc *= space_step;
+    // first order renormalization keeps the rotators on the unit circle
+    mark_osc *= (3 - std::norm(mark_osc)) / 2;
+    space_osc *= (3 - std::norm(space_osc)) / 2;
+
+    // a transition should fall half a bit away from the sampling point
+    bool now = std::norm(mark_sum) > std::norm(space_sum);
+    if (now != level) {
+        level = now;
+        pll_phase += DEMOD_PLL_GAIN * (0.5f - pll_phase);
+    }
+    pll_phase += pll_step;
+    if (pll_phase >= 1) {
+        pll_phase -= 1;
+        bit(level);
+    }
+}
+
+void AfskDemodulator::bit(bool lvl)
+{
+    // 0 is encoded as change in tone, 1 is encoded as no change in tone
+    bool b = lvl == last_bit_level;
+    last_bit_level = lvl;
+    shift = (shift << 1) | b;
+
+    if ((shift & 0xff) == HDLC_FLAG) {
+        if (in_frame) {
+            frame_end();
+        }
+        in_frame = true;
+        frame.clear();
+        frame_bits = 0;
+        byte = 0;
+        return;
+    }
+    if ((shift & HDLC_ABORT) == HDLC_ABORT) {
+        in_frame = false;
+        return;
+    }
+    if ((shift & 0x3f) == HDLC_STUFFED || !in_frame) {
+        return;
+    }
+
+    // LSB first
+    byte |= (uint8_t)(b << (frame_bits & 7));
+    if ((++frame_bits & 7) == 0) {
+        if (frame.size() == AX25_MAX_FRAME) {
+            in_frame = false;
+            return;
+        }
+        frame.push_back(byte);
+        byte = 0;
+    }
+}
+
+void AfskDemodulator::frame_end()
+{
+    // the flag's first 7 bits were taken for data, nothing else may be left
+    if (frame.size() < AX25_MIN_FRAME) {
+        return;
+    }
+    size_t n = frame.size();
+    uint16_t fcs = frame[n - 2] | (frame[n - 1] << 8);
+    if ((frame_bits & 7) != 7 || ax25_fcs(frame.data(), n - 2) != fcs) {
+        fcs_error_count++;
+        return;
+    }
+    Ax25Packet packet;
+    if (!ax25_parse(frame.data(), n, packet)) {
+        bad_frame_count++;
+        return;
+    }
+    received.push_back(std::move(packet));
+}
@@ -1,25 +1,19 @@
 #include <cassert>
 #include <cmath>
+#include <algorithm>
 #include "dsp.h"
+#include "nco.h"
 
 #define IzeroEPSILON 1E-21 /* Max error acceptable in Izero */
 
-const int BAUD_RATE = 1200;
-const int MARK_HZ = 1200;
-const int SPACE_HZ = 2200;
-
-std::vector<float> afsk(const std::vector<bool> &data)
+// tone generation shared by afsk() and afsk_append(), for either bit container
+template <typename Bits>
+static void afsk_tones(const Bits &data, std::vector<float> &wave, float &phase)
 {
-    std::vector<float> wave;
-    // start with 0.5sec silence
-    for (int i = 0 ; i < AUDIO_SAMPLE_RATE/2 ; i++) {
-        wave.push_back(0);
-    }
-    float phase = 0;
     float gain = 0.5;
     int samples_per_bit = AUDIO_SAMPLE_RATE / BAUD_RATE;
-    for (auto b : data) {
-        float freq = b ? MARK_HZ : SPACE_HZ;
+    for (size_t n = 0 ; n < data.size() ; n++) {
+        float freq = data[n] ? MARK_HZ : SPACE_HZ;
         float phase_change_per_sample = (2*M_PI * freq) / AUDIO_SAMPLE_RATE;
         for (int i = 0 ; i < samples_per_bit ; i++) {
             wave.push_back(sin(phase) * gain);
@@ -29,6 +23,35 @@ std::vector<float> afsk(const std::vector<bool> &data)
             }
         }
     }
+}
+
+template <typename Bits>
+static void afsk_nco_tones(const Bits &data, float *out, uint32_t &phase)
+{
+    const float *table = nco_sin_table();
+    const uint32_t mark_step = nco_step(MARK_HZ, AUDIO_SAMPLE_RATE);
+    const uint32_t space_step = nco_step(SPACE_HZ, AUDIO_SAMPLE_RATE);
+    int samples_per_bit = AUDIO_SAMPLE_RATE / BAUD_RATE;
+    float gain = 0.5;
+    for (size_t n = 0 ; n < data.size() ; n++) {
+        uint32_t step = data[n] ? mark_step : space_step;
+        for (int i = 0 ; i < samples_per_bit ; i++) {
+            *out++ = nco_sin(table, phase) * gain;
+            phase += step;
+        }
+    }
+}
+
+template <typename Bits>
+static std::vector<float> afsk_bits(const Bits &data)
+{
+    std::vector<float> wave;
+    // start with 0.5sec silence
+    for (int i = 0 ; i < AUDIO_SAMPLE_RATE/2 ; i++) {
+        wave.push_back(0);
+    }
+    float phase = 0;
+    afsk_tones(data, wave, phase);
     // end with 0.5sec silence
     for (int i = 0 ; i < AUDIO_SAMPLE_RATE/2 ; i++) {
         wave.push_back(0);
@@ -36,6 +59,48 @@ std::vector<float> afsk(const std::vector<bool> &data)
     return wave;
 }
 
+template <typename Bits>
+static std::vector<float> afsk_nco_bits(const Bits &data)
+{
+    int samples_per_bit = AUDIO_SAMPLE_RATE / BAUD_RATE;
+    // 0.5sec silence on both sides comes from the zero initialization
+    std::vector<float> wave(AUDIO_SAMPLE_RATE + data.size() * samples_per_bit, 0.0f);
+    uint32_t phase = 0;
+    afsk_nco_tones(data, wave.data() + AUDIO_SAMPLE_RATE/2, phase);
+    return wave;
+}
+
+void afsk_append(const PackedBits &data, std::vector<float> &wave, AfskState &state, ModulatorBackend backend)
+{
+    if (backend == MOD_NCO) {
+        size_t offset = wave.size();
+        wave.resize(offset + data.size() * (AUDIO_SAMPLE_RATE / BAUD_RATE));
+        afsk_nco_tones(data, wave.data() + offset, state.nco_phase);
+    } else {
+        afsk_tones(data, wave, state.phase);
+    }
+}
+
+std::vector<float> afsk(const std::vector<bool> &data)
+{
+    return afsk_bits(data);
+}
+
+std::vector<float> afsk(const PackedBits &data)
+{
+    return afsk_bits(data);
+}
+
+std::vector<float> afsk_nco(const std::vector<bool> &data)
+{
+    return afsk_nco_bits(data);
+}
+
+std::vector<float> afsk_nco(const PackedBits &data)
+{
+    return afsk_nco_bits(data);
+}
+
 static int compute_ntaps(double sampling_freq, double transition_width, double param)
 {
     double a = param / 0.1102 + 8.7;
@@ -46,6 +111,14 @@ static int compute_ntaps(double sampling_freq, double transition_width, double p
     return ntaps;
 }
 
+// Kaiser beta used by lowpass(), ~70 dB stopband
+static const double LOWPASS_BETA = 7.0;
+
+int lowpass_ntaps(double sampling_freq, double transition_width)
+{
+    return compute_ntaps(sampling_freq, transition_width, LOWPASS_BETA);
+}
+
 static double Izero(double x)
 {
     double sum, u, halfx, temp;
@@ -83,7 +156,7 @@ static std::vector<float> kaiser(int ntaps, double beta)
 
 std::vector<float> lowpass(double gain, double sampling_freq, double cutoff_freq, double transition_width)
 {
-    double param = 7.0;
+    double param = LOWPASS_BETA;
     int ntaps = compute_ntaps(sampling_freq, transition_width, param);
     std::vector<float> taps(ntaps);
     std::vector<float> w = kaiser(ntaps, param);
@@ -119,16 +192,49 @@ std::vector<float> lowpass(double gain, double sampling_freq, double cutoff_freq
 float fmmod(const float *input, size_t input_size, Ringbuffer_t &output, float sensitivity, float last_phase)
 {
     float phase = last_phase;
-    assert(input_size <= output.writeAvailable());
-    for (size_t i=0; i<input_size; i++) {
-        phase += input[i] * sensitivity;
-        while (phase>M_PI) phase -= 2*M_PI;
-        while (phase<=-M_PI) phase += 2*M_PI;
-        output.insert(std::complex<float>(cos(phase), sin(phase)));
+    Ringbuffer_t::Span spans[2];
+    size_t room = output.writeSpans(spans[0], spans[1]);
+    assert(input_size <= room);
+    (void)room;
+    // straight into the free slots, published once at the end
+    for (const Ringbuffer_t::Span &span : spans) {
+        size_t n = std::min(span.size, input_size);
+        for (size_t i=0; i<n; i++) {
+            phase += input[i] * sensitivity;
+            while (phase>M_PI) phase -= 2*M_PI;
+            while (phase<=-M_PI) phase += 2*M_PI;
+            span.data[i] = std::complex<float>(cos(phase), sin(phase));
+        }
+        input += n;
+        input_size -= n;
+        output.commit(n);
     }
     return phase;
 }
 
+float fmmod_nco(const float *input, size_t input_size, Ringbuffer_t &output, float sensitivity, float last_phase)
+{
+    const float *table = nco_sin_table();
+    // radians per unit of input -> accumulator units per unit of input
+    const double scale = sensitivity * (4294967296.0 / (2 * M_PI));
+    uint32_t phase = nco_phase(last_phase);
+    Ringbuffer_t::Span spans[2];
+    size_t room = output.writeSpans(spans[0], spans[1]);
+    assert(input_size <= room);
+    (void)room;
+    for (const Ringbuffer_t::Span &span : spans) {
+        size_t n = std::min(span.size, input_size);
+        for (size_t i=0; i<n; i++) {
+            phase += (uint32_t)(int32_t)lrint(input[i] * scale);
+            span.data[i] = std::complex<float>(nco_cos(table, phase), nco_sin(table, phase));
+        }
+        input += n;
+        input_size -= n;
+        output.commit(n);
+    }
+    return nco_radians(phase);
+}
+
 void naive_interpolate(const std::vector<std::complex<float>> &input,
                       std::vector<std::complex<float>> &output,
                       int interpolation,
@@ -161,7 +267,8 @@ void naive_interpolate(const std::vector<std::complex<float>> &input,
     }
 }
 
-FIRInterpolator::FIRInterpolator(int interpolation, const std::vector<float> &taps)
+FIRInterpolator::FIRInterpolator(int interpolation, const std::vector<float> &taps, int decimation)
+    : decim(std::max(1, decimation)), grid_phase(0)
 {
     std::vector<float> new_taps = taps;
     int n = taps.size() % interpolation;
@@ -169,35 +276,167 @@ FIRInterpolator::FIRInterpolator(int interpolation, const std::vector<float> &ta
         n = interpolation - n;
         new_taps.resize(taps.size()+n);
     }
-    int nfilters = interpolation;
-    int nt = new_taps.size() / nfilters;
-    xtaps.resize(nfilters);
+    nfilters = interpolation;
+    taps_count = new_taps.size() / nfilters;
+    padded_len = (2 * taps_count + FIR_TAP_ALIGN - 1) / FIR_TAP_ALIGN * FIR_TAP_ALIGN;
+    xtaps.assign((size_t)nfilters * padded_len, 0.0f);
+    xtap_ptrs.resize(nfilters);
 
     for (int i = 0; i < nfilters; i++) {
-        xtaps[i].resize(nt);
+        xtap_ptrs[i] = xtaps.data() + (size_t)i * padded_len;
     }
+    // branch i gets every nfilters'th tap, stored back to front so the kernels
+    // walk taps and input in the same direction
     for (int i = 0; i < (int) new_taps.size(); i++) {
-        xtaps[i % nfilters][i / nfilters] = new_taps[i];
+        int k = taps_count - 1 - i / nfilters;
+        float *branch = xtaps.data() + (size_t)(i % nfilters) * padded_len;
+        branch[2 * k] = new_taps[i];
+        branch[2 * k + 1] = new_taps[i];
+    }
+
+    // the ring never holds more than BUFSIZE*2 samples; the kernels may read
+    // up to padded_len floats past the start of the last output
+    window.assign(BUFSIZE * 2 + padded_len / 2, std::complex<float>(0.0, 0.0));
+    block.resize((size_t)FIR_S8_BLOCK * nfilters);
+
+    // input i starts at grid index i * interpolation; branch j lands on the
+    // output grid if (phase + j) % decimation == 0, phase = i * interpolation % decimation
+    phase_ptrs.resize(decim);
+    for (int p = 0; p < decim; p++) {
+        for (int j = 0; j < nfilters; j++) {
+            if ((p + j) % decim == 0) {
+                phase_ptrs[p].push_back(xtap_ptrs[j]);
+            }
+        }
     }
+
+    set_kernel(fir_best_kernel());
+}
+
+void FIRInterpolator::set_kernel(FirKernel kernel)
+{
+    kernel_id = fir_kernel_supported(kernel) ? kernel : FIR_SCALAR;
+    kernel_fn = fir_kernel(kernel_id, padded_len);
+    quantize_fn = fir_quantizer(kernel_id);
+}
+
+int FIRInterpolator::load_window(Ringbuffer_t &input)
+{
+    // the kernels want one linear window: two block copies across the wrap point
+    Ringbuffer_t::Span first, second;
+    int input_size = input.readSpans(first, second);
+    std::copy(first.data, first.data + first.size, window.data());
+    std::copy(second.data, second.data + second.size, window.data() + first.size);
+    return input_size;
 }
 
 int FIRInterpolator::interpolate(Ringbuffer_t &input, std::vector<std::complex<float>> &output)
 {
     int input_size = input.readAvailable();
+    int processed = std::max(0, input_size - taps_count + 1);
+    size_t offset = output.size();
+    output.resize(offset + (size_t)processed * nfilters);
+    return interpolate(input, output.data() + offset, output.size() - offset);
+}
+
+int FIRInterpolator::interpolate(Ringbuffer_t &input, std::complex<float> *output, size_t capacity)
+{
+    int input_size = load_window(input);
     // the count of the polyphase filters
-    int fir_count = (int)xtaps.size();
-    // the count of the taps in a polyphase filter
-    int taps_count = (int)xtaps[0].size();
-
-    for (int i = 0; i <= input_size-taps_count; i++) {
-        for (int j = 0; j < fir_count; j++) {
-            std::complex<float> sum(0.0, 0.0);
-            for (int k = 0; k < taps_count; k++) {
-                sum += input[i+k] * xtaps[j][taps_count-k-1];
-            }
-            output.push_back(sum);
+    int fir_count = nfilters;
+
+    int processed = std::max(0, input_size - taps_count + 1);
+    processed = std::min(processed, (int)(capacity / fir_count));
+    if (processed == 0) {
+        return 0;
+    }
+    kernel_fn(window.data(), processed, xtap_ptrs.data(), fir_count, padded_len, output);
+    return processed;
+}
+
+int FIRInterpolator::interpolate(Ringbuffer_t &input, int8_t *output, size_t capacity, float scale)
+{
+    int input_size = load_window(input);
+    int fir_count = nfilters;
+
+    int processed = std::max(0, input_size - taps_count + 1);
+    processed = std::min(processed, (int)(capacity / fir_count));
+    for (int i = 0; i < processed; i += FIR_S8_BLOCK) {
+        int n = std::min(FIR_S8_BLOCK, processed - i);
+        kernel_fn(window.data() + i, n, xtap_ptrs.data(), fir_count, padded_len, block.data());
+        quantize_fn(reinterpret_cast<const float *>(block.data()), (size_t)n * fir_count * 2, scale,
+                    output + (size_t)i * fir_count * 2);
+    }
+    return processed;
+}
+
+size_t FIRInterpolator::output_count(size_t processed, int phase) const
+{
+    // multiples of M in [phase, phase + processed * L) on the grid
+    size_t end = phase + processed * nfilters;
+    return (end + decim - 1) / decim - (phase > 0 ? 1 : 0);
+}
+
+int FIRInterpolator::resample(Ringbuffer_t &input, std::complex<float> *output, size_t capacity, size_t &produced)
+{
+    if (decim == 1) {
+        int processed = interpolate(input, output, capacity);
+        produced = (size_t)processed * nfilters;
+        return processed;
+    }
+
+    int input_size = load_window(input);
+    int available = std::max(0, input_size - taps_count + 1);
+    const int step = nfilters % decim;
+    int processed = 0;
+    produced = 0;
+    for (; processed < available; processed++) {
+        const std::vector<const float *> &branches = phase_ptrs[grid_phase];
+        if (produced + branches.size() > capacity) {
+            break;
         }
+        if (!branches.empty()) {
+            kernel_fn(window.data() + processed, 1, branches.data(), (int)branches.size(), padded_len,
+                      output + produced);
+            produced += branches.size();
+        }
+        grid_phase = (grid_phase + step) % decim;
     }
-    return input_size - taps_count + 1;
+    return processed;
 }
 
+int FIRInterpolator::resample(Ringbuffer_t &input, int8_t *output, size_t capacity, float scale, size_t &produced)
+{
+    if (decim == 1) {
+        int processed = interpolate(input, output, capacity, scale);
+        produced = (size_t)processed * nfilters;
+        return processed;
+    }
+
+    int input_size = load_window(input);
+    int available = std::max(0, input_size - taps_count + 1);
+    const int step = nfilters % decim;
+    int processed = 0;
+    size_t staged = 0; // outputs in `block` not quantized yet
+    produced = 0;
+    for (; processed < available; processed++) {
+        const std::vector<const float *> &branches = phase_ptrs[grid_phase];
+        if (produced + staged + branches.size() > capacity) {
+            break;
+        }
+        if (staged + branches.size() > block.size()) {
+            quantize_fn(reinterpret_cast<const float *>(block.data()), staged * 2, scale, output + produced * 2);
+            produced += staged;
+            staged = 0;
+        }
+        if (!branches.empty()) {
+            kernel_fn(window.data() + processed, 1, branches.data(), (int)branches.size(), padded_len,
+                      block.data() + staged);
+            staged += branches.size();
+        }
+        grid_phase = (grid_phase + step) % decim;
+    }
+    quantize_fn(reinterpret_cast<const float *>(block.data()), staged * 2, scale, output + produced * 2);
+    produced += staged;
+    return processed;
+}
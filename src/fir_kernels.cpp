@@ -0,0 +1,373 @@
+#include "fir_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FIR_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FIR_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Every kernel is a template on the branch length: LEN > 0 replaces the
+// runtime len with a constant (which callers must then pass), so the tap
+// loop is fully unrolled; 0 keeps the runtime value.
+template <int LEN>
+static void fir_kernel_scalar(const std::complex<float> *in, size_t n_out,
+                              const float *const *taps, int branches, int len,
+                              std::complex<float> *out)
+{
+    if (LEN > 0) {
+        len = LEN;
+    }
+    for (size_t i = 0; i < n_out; i++) {
+        const float *x = reinterpret_cast<const float *>(in + i);
+        for (int j = 0; j < branches; j++) {
+            const float *t = taps[j];
+            float re = 0, im = 0;
+            for (int m = 0; m < len; m += 2) {
+                re += x[m] * t[m];
+                im += x[m + 1] * t[m + 1];
+            }
+            out[j] = std::complex<float>(re, im);
+        }
+        out += branches;
+    }
+}
+
+#ifdef FIR_HAVE_X86
+// [r0, i0, r1, i1] + [r0', i0', r1', i1'] -> [r0+r1, i0+i1, r0'+r1', i0'+i1']
+static inline __m128 fir_fold_pair(__m128 a0, __m128 a1)
+{
+    return _mm_add_ps(_mm_movelh_ps(a0, a1), _mm_movehl_ps(a1, a0));
+}
+
+// SSE2 is part of the x86-64 baseline, so this one needs no runtime check there.
+// Two branches are computed together so each input load is used twice.
+template <int LEN>
+__attribute__((target("sse2")))
+static void fir_kernel_sse(const std::complex<float> *in, size_t n_out,
+                           const float *const *taps, int branches, int len,
+                           std::complex<float> *out)
+{
+    if (LEN > 0) {
+        len = LEN;
+    }
+    for (size_t i = 0; i < n_out; i++) {
+        const float *x = reinterpret_cast<const float *>(in + i);
+        int j = 0;
+        for (; j + 1 < branches; j += 2) {
+            const float *t0 = taps[j];
+            const float *t1 = taps[j + 1];
+            __m128 a0 = _mm_setzero_ps();
+            __m128 a1 = _mm_setzero_ps();
+            for (int m = 0; m < len; m += 4) {
+                __m128 v = _mm_loadu_ps(x + m);
+                a0 = _mm_add_ps(a0, _mm_mul_ps(v, _mm_load_ps(t0 + m)));
+                a1 = _mm_add_ps(a1, _mm_mul_ps(v, _mm_load_ps(t1 + m)));
+            }
+            _mm_storeu_ps(reinterpret_cast<float *>(out + j), fir_fold_pair(a0, a1));
+        }
+        for (; j < branches; j++) {
+            const float *t0 = taps[j];
+            __m128 a0 = _mm_setzero_ps();
+            for (int m = 0; m < len; m += 4) {
+                a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(x + m), _mm_load_ps(t0 + m)));
+            }
+            a0 = _mm_add_ps(a0, _mm_movehl_ps(a0, a0));
+            _mm_storel_pi(reinterpret_cast<__m64 *>(out + j), a0);
+        }
+        out += branches;
+    }
+}
+
+template <int LEN>
+__attribute__((target("avx2,fma")))
+static void fir_kernel_avx2(const std::complex<float> *in, size_t n_out,
+                            const float *const *taps, int branches, int len,
+                            std::complex<float> *out)
+{
+    if (LEN > 0) {
+        len = LEN;
+    }
+    for (size_t i = 0; i < n_out; i++) {
+        const float *x = reinterpret_cast<const float *>(in + i);
+        int j = 0;
+        for (; j + 1 < branches; j += 2) {
+            const float *t0 = taps[j];
+            const float *t1 = taps[j + 1];
+            __m256 a0 = _mm256_setzero_ps();
+            __m256 a1 = _mm256_setzero_ps();
+            for (int m = 0; m < len; m += 8) {
+                __m256 v = _mm256_loadu_ps(x + m);
+                a0 = _mm256_fmadd_ps(v, _mm256_load_ps(t0 + m), a0);
+                a1 = _mm256_fmadd_ps(v, _mm256_load_ps(t1 + m), a1);
+            }
+            __m128 s0 = _mm_add_ps(_mm256_castps256_ps128(a0), _mm256_extractf128_ps(a0, 1));
+            __m128 s1 = _mm_add_ps(_mm256_castps256_ps128(a1), _mm256_extractf128_ps(a1, 1));
+            _mm_storeu_ps(reinterpret_cast<float *>(out + j), fir_fold_pair(s0, s1));
+        }
+        for (; j < branches; j++) {
+            const float *t0 = taps[j];
+            __m256 a0 = _mm256_setzero_ps();
+            for (int m = 0; m < len; m += 8) {
+                a0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + m), _mm256_load_ps(t0 + m), a0);
+            }
+            __m128 s0 = _mm_add_ps(_mm256_castps256_ps128(a0), _mm256_extractf128_ps(a0, 1));
+            s0 = _mm_add_ps(s0, _mm_movehl_ps(s0, s0));
+            _mm_storel_pi(reinterpret_cast<__m64 *>(out + j), s0);
+        }
+        out += branches;
+    }
+}
+#endif
+
+#ifdef FIR_HAVE_NEON
+template <int LEN>
+static void fir_kernel_neon(const std::complex<float> *in, size_t n_out,
+                            const float *const *taps, int branches, int len,
+                            std::complex<float> *out)
+{
+    if (LEN > 0) {
+        len = LEN;
+    }
+    for (size_t i = 0; i < n_out; i++) {
+        const float *x = reinterpret_cast<const float *>(in + i);
+        int j = 0;
+        for (; j + 1 < branches; j += 2) {
+            const float *t0 = taps[j];
+            const float *t1 = taps[j + 1];
+            float32x4_t a0 = vdupq_n_f32(0);
+            float32x4_t a1 = vdupq_n_f32(0);
+            for (int m = 0; m < len; m += 4) {
+                float32x4_t v = vld1q_f32(x + m);
+                a0 = vmlaq_f32(a0, v, vld1q_f32(t0 + m));
+                a1 = vmlaq_f32(a1, v, vld1q_f32(t1 + m));
+            }
+            float32x2_t s0 = vadd_f32(vget_low_f32(a0), vget_high_f32(a0));
+            float32x2_t s1 = vadd_f32(vget_low_f32(a1), vget_high_f32(a1));
+            vst1q_f32(reinterpret_cast<float *>(out + j), vcombine_f32(s0, s1));
+        }
+        for (; j < branches; j++) {
+            const float *t0 = taps[j];
+            float32x4_t a0 = vdupq_n_f32(0);
+            for (int m = 0; m < len; m += 4) {
+                a0 = vmlaq_f32(a0, vld1q_f32(x + m), vld1q_f32(t0 + m));
+            }
+            vst1_f32(reinterpret_cast<float *>(out + j), vadd_f32(vget_low_f32(a0), vget_high_f32(a0)));
+        }
+        out += branches;
+    }
+}
+#endif
+
+static void fir_quantize_scalar(const float *in, size_t count, float scale, int8_t *out)
+{
+    for (size_t i = 0; i < count; i++) {
+        float v = std::min(127.0f, std::max(-128.0f, in[i] * scale));
+        out[i] = (int8_t)std::lrintf(v);
+    }
+}
+
+#ifdef FIR_HAVE_X86
+// clamp first: out-of-range cvtps gives INT_MIN, which would saturate to -128
+__attribute__((target("sse2")))
+static void fir_quantize_sse(const float *in, size_t count, float scale, int8_t *out)
+{
+    const __m128 s = _mm_set1_ps(scale);
+    const __m128 lo = _mm_set1_ps(-128.0f);
+    const __m128 hi = _mm_set1_ps(127.0f);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_cvtps_epi32(_mm_min_ps(hi, _mm_max_ps(lo, _mm_mul_ps(_mm_loadu_ps(in + i), s))));
+        __m128i b = _mm_cvtps_epi32(_mm_min_ps(hi, _mm_max_ps(lo, _mm_mul_ps(_mm_loadu_ps(in + i + 4), s))));
+        __m128i c = _mm_cvtps_epi32(_mm_min_ps(hi, _mm_max_ps(lo, _mm_mul_ps(_mm_loadu_ps(in + i + 8), s))));
+        __m128i d = _mm_cvtps_epi32(_mm_min_ps(hi, _mm_max_ps(lo, _mm_mul_ps(_mm_loadu_ps(in + i + 12), s))));
+        __m128i v = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), v);
+    }
+    fir_quantize_scalar(in + i, count - i, scale, out + i);
+}
+
+__attribute__((target("avx2,fma")))
+static void fir_quantize_avx2(const float *in, size_t count, float scale, int8_t *out)
+{
+    const __m256 s = _mm256_set1_ps(scale);
+    const __m256 lo = _mm256_set1_ps(-128.0f);
+    const __m256 hi = _mm256_set1_ps(127.0f);
+    // the packs work per 128-bit lane, this puts the dwords back in order
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i a = _mm256_cvtps_epi32(_mm256_min_ps(hi, _mm256_max_ps(lo, _mm256_mul_ps(_mm256_loadu_ps(in + i), s))));
+        __m256i b = _mm256_cvtps_epi32(_mm256_min_ps(hi, _mm256_max_ps(lo, _mm256_mul_ps(_mm256_loadu_ps(in + i + 8), s))));
+        __m256i c = _mm256_cvtps_epi32(_mm256_min_ps(hi, _mm256_max_ps(lo, _mm256_mul_ps(_mm256_loadu_ps(in + i + 16), s))));
+        __m256i d = _mm256_cvtps_epi32(_mm256_min_ps(hi, _mm256_max_ps(lo, _mm256_mul_ps(_mm256_loadu_ps(in + i + 24), s))));
+        __m256i v = _mm256_packs_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_permutevar8x32_epi32(v, order));
+    }
+    fir_quantize_sse(in + i, count - i, scale, out + i);
+}
+#endif
+
+#ifdef FIR_HAVE_NEON
+static inline int32x4_t fir_round_neon(float32x4_t v)
+{
+#if defined(__aarch64__)
+    return vcvtnq_s32_f32(v);
+#else
+    // no round-to-nearest conversion on ARMv7: add +-0.5 and truncate
+    uint32x4_t neg = vcltq_f32(v, vdupq_n_f32(0));
+    float32x4_t half = vbslq_f32(neg, vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f));
+    return vcvtq_s32_f32(vaddq_f32(v, half));
+#endif
+}
+
+static void fir_quantize_neon(const float *in, size_t count, float scale, int8_t *out)
+{
+    const float32x4_t lo = vdupq_n_f32(-128.0f);
+    const float32x4_t hi = vdupq_n_f32(127.0f);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        int32x4_t q[4];
+        for (int k = 0; k < 4; k++) {
+            float32x4_t v = vmulq_n_f32(vld1q_f32(in + i + 4 * k), scale);
+            q[k] = fir_round_neon(vminq_f32(hi, vmaxq_f32(lo, v)));
+        }
+        int16x8_t ab = vcombine_s16(vqmovn_s32(q[0]), vqmovn_s32(q[1]));
+        int16x8_t cd = vcombine_s16(vqmovn_s32(q[2]), vqmovn_s32(q[3]));
+        vst1q_s8(out + i, vcombine_s8(vqmovn_s16(ab), vqmovn_s16(cd)));
+    }
+    fir_quantize_scalar(in + i, count - i, scale, out + i);
+}
+#endif
+
+bool fir_kernel_supported(FirKernel kernel)
+{
+    switch (kernel) {
+    case FIR_SCALAR:
+        return true;
+#ifdef FIR_HAVE_X86
+    case FIR_SSE:
+        return __builtin_cpu_supports("sse2");
+    case FIR_AVX2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#ifdef FIR_HAVE_NEON
+    case FIR_NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+FirKernel fir_best_kernel()
+{
+    const FirKernel order[] = {FIR_AVX2, FIR_NEON, FIR_SSE};
+    for (auto k : order) {
+        if (fir_kernel_supported(k)) {
+            return k;
+        }
+    }
+    return FIR_SCALAR;
+}
+
+// the instantiations of one kernel
+struct FirShapes
+{
+    fir_kernel_fn first; // len == FIR_FIXED_LEN_FIRST
+    fir_kernel_fn image; // len == FIR_FIXED_LEN_IMAGE
+    fir_kernel_fn any;
+};
+
+static const FirShapes &fir_shapes(FirKernel kernel)
+{
+    // unrolled, the scalar 33 tap loop is slower than the rolled one
+    static const FirShapes scalar = {fir_kernel_scalar<0>, fir_kernel_scalar<FIR_FIXED_LEN_IMAGE>,
+                                     fir_kernel_scalar<0>};
+#ifdef FIR_HAVE_X86
+    static const FirShapes sse = {fir_kernel_sse<FIR_FIXED_LEN_FIRST>, fir_kernel_sse<FIR_FIXED_LEN_IMAGE>,
+                                  fir_kernel_sse<0>};
+    static const FirShapes avx2 = {fir_kernel_avx2<FIR_FIXED_LEN_FIRST>, fir_kernel_avx2<FIR_FIXED_LEN_IMAGE>,
+                                   fir_kernel_avx2<0>};
+#endif
+#ifdef FIR_HAVE_NEON
+    static const FirShapes neon = {fir_kernel_neon<FIR_FIXED_LEN_FIRST>, fir_kernel_neon<FIR_FIXED_LEN_IMAGE>,
+                                   fir_kernel_neon<0>};
+#endif
+    if (!fir_kernel_supported(kernel)) {
+        return scalar;
+    }
+    switch (kernel) {
+#ifdef FIR_HAVE_X86
+    case FIR_SSE:
+        return sse;
+    case FIR_AVX2:
+        return avx2;
+#endif
+#ifdef FIR_HAVE_NEON
+    case FIR_NEON:
+        return neon;
+#endif
+    default:
+        return scalar;
+    }
+}
+
+fir_kernel_fn fir_kernel(FirKernel kernel)
+{
+    return fir_shapes(kernel).any;
+}
+
+fir_kernel_fn fir_kernel(FirKernel kernel, int len)
+{
+    const FirShapes &shapes = fir_shapes(kernel);
+    if (len == FIR_FIXED_LEN_FIRST) {
+        return shapes.first;
+    }
+    if (len == FIR_FIXED_LEN_IMAGE) {
+        return shapes.image;
+    }
+    return shapes.any;
+}
+
+const char *fir_kernel_name(FirKernel kernel)
+{
+    switch (kernel) {
+    case FIR_SCALAR:
+        return "scalar";
+    case FIR_SSE:
+        return "sse";
+    case FIR_AVX2:
+        return "avx2";
+    case FIR_NEON:
+        return "neon";
+    }
+    return "unknown";
+}
+
+fir_quantize_fn fir_quantizer(FirKernel kernel)
+{
+    if (!fir_kernel_supported(kernel)) {
+        return fir_quantize_scalar;
+    }
+    switch (kernel) {
+#ifdef FIR_HAVE_X86
+    case FIR_SSE:
+        return fir_quantize_sse;
+    case FIR_AVX2:
+        return fir_quantize_avx2;
+#endif
+#ifdef FIR_HAVE_NEON
+    case FIR_NEON:
+        return fir_quantize_neon;
+#endif
+    default:
+        return fir_quantize_scalar;
+    }
+}
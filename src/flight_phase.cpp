@@ -0,0 +1,183 @@
+#include "flight_phase.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+
+const float GRAVITY = 9.80665f;
+
+const char *const PHASE_NAMES[FLIGHT_PHASE_COUNT] = {"pad", "boost", "coast", "descent", "landed"};
+
+} // namespace
+
+const char *flight_phase_name(FlightPhase phase)
+{
+    return phase >= 0 && phase < FLIGHT_PHASE_COUNT ? PHASE_NAMES[phase] : "unknown";
+}
+
+int flight_interval_ms(const Config &config, FlightPhase phase)
+{
+    switch (phase)
+    {
+    case PHASE_BOOST:
+        return config.flight_boost_ms;
+    case PHASE_COAST:
+        return config.flight_coast_ms;
+    case PHASE_DESCENT:
+        return config.flight_descent_ms;
+    case PHASE_LANDED:
+        return config.flight_landed_ms;
+    case PHASE_PAD:
+    default:
+        return config.flight_pad_ms;
+    }
+}
+
+FlightPhaseTracker::FlightPhaseTracker(quill::Logger *logger)
+    : logger(logger),
+      current(PHASE_PAD),
+      pending(false),
+      ground(NAN),
+      apogee(NAN)
+{
+    event_buf[0] = '\0';
+}
+
+bool FlightPhaseTracker::update(const SensorHistory &history, const Config &config)
+{
+    static const int mpl_altitude = SensorHistory::column("mpl_altitude");
+    static const int bme_altitude = SensorHistory::column("bme_altitude");
+    static const int lsm_accel = SensorHistory::column("lsm_accel_magnitude");
+    static const int bno_linear_accel = SensorHistory::column("bno_linear_accel_magnitude");
+
+    if (history.empty())
+    {
+        return false;
+    }
+    int altitude_column = std::isfinite(history.value(mpl_altitude)) ? mpl_altitude : bme_altitude;
+    float altitude = history.value(altitude_column);
+    // the BNO055 reports linear acceleration, gravity removed
+    bool lsm = std::isfinite(history.value(lsm_accel));
+    int accel_column = lsm ? lsm_accel : bno_linear_accel;
+    float accel_offset = lsm ? 0.0f : GRAVITY;
+    float accel = history.value(accel_column) + accel_offset;
+    if (current != PHASE_PAD && std::isfinite(altitude) && !(altitude <= apogee))
+    {
+        apogee = altitude;
+    }
+
+    FlightPhase before = current;
+    switch (current)
+    {
+    case PHASE_PAD:
+    {
+        // the last FLIGHT_LAUNCH_SAMPLES samples, however far apart, but
+        // not older than the window
+        bool thrust = history.size() >= FLIGHT_LAUNCH_SAMPLES &&
+                      history.timestamp() - history.timestamp(FLIGHT_LAUNCH_SAMPLES - 1) <=
+                          (unsigned long)config.flight_launch_window_ms;
+        for (size_t age = 0; thrust && age < FLIGHT_LAUNCH_SAMPLES; age++)
+        {
+            thrust = history.value(accel_column, age) + accel_offset > config.flight_launch_accel;
+        }
+        if (thrust)
+        {
+            enter(PHASE_BOOST, altitude);
+        }
+        else if (altitude - ground > config.flight_launch_altitude)
+        {
+            // the climb confirms a pending launch; without thrust the boost is over
+            enter(accel > config.flight_launch_accel ? PHASE_BOOST : PHASE_COAST, altitude);
+        }
+        else if (!(accel > config.flight_launch_accel))
+        {
+            // only while at rest on the pad, so the samples of a launch not
+            // confirmed yet stay out
+            SensorStats pad = history.stats(altitude_column, FLIGHT_GROUND_MS);
+            if (pad.count > 0)
+            {
+                ground = pad.mean;
+            }
+        }
+        break;
+    }
+    case PHASE_BOOST:
+    case PHASE_COAST:
+        if (apogee - altitude > config.flight_apogee_drop)
+        {
+            enter(PHASE_DESCENT, apogee);
+        }
+        else if (current == PHASE_BOOST && accel < config.flight_launch_accel)
+        {
+            enter(PHASE_COAST, altitude);
+        }
+        break;
+    case PHASE_DESCENT:
+    {
+        SensorStats recent = history.stats(altitude_column, FLIGHT_LANDED_MS);
+        if (recent.count >= FLIGHT_LANDED_SAMPLES && recent.max - recent.min < config.flight_landed_band)
+        {
+            enter(PHASE_LANDED, apogee);
+        }
+        break;
+    }
+    case PHASE_LANDED:
+        break;
+    }
+    pending = current == PHASE_PAD && accel > config.flight_launch_accel;
+    return current != before;
+}
+
+int FlightPhaseTracker::interval_ms(const Config &config) const
+{
+    return pending ? config.flight_boost_ms : flight_interval_ms(config, current);
+}
+
+void FlightPhaseTracker::enter(FlightPhase next, float altitude)
+{
+    static const char *const EVENTS[FLIGHT_PHASE_COUNT] = {"", "Launch", "Coasting", "Apogee", "Landed"};
+    static const char *const SUFFIX[FLIGHT_PHASE_COUNT] = {"", " at", " at", "", ", apogee"};
+
+    if (std::isfinite(altitude) && !(altitude <= apogee))
+    {
+        apogee = altitude;
+    }
+    // heights above the pad once it is known, altitudes otherwise
+    bool agl = std::isfinite(ground);
+    float height = agl ? altitude - ground : altitude;
+    if (std::isfinite(height))
+    {
+        std::snprintf(event_buf, sizeof(event_buf), ">%s%s %.0f m%s", EVENTS[next], SUFFIX[next], height,
+                      agl ? " AGL" : "");
+    }
+    else
+    {
+        std::snprintf(event_buf, sizeof(event_buf), ">%s", EVENTS[next]);
+    }
+    LOG_INFO(logger, "Flight: {} -> {} ({})", flight_phase_name(current), flight_phase_name(next), event_buf + 1);
+    current = next;
+}
+
+BeaconScheduler::BeaconScheduler()
+    : started(Clock::now()),
+      overrun_count(0)
+{
+}
+
+void BeaconScheduler::wait(int interval_ms)
+{
+    Clock::time_point due = started + std::chrono::milliseconds(std::max(0, interval_ms));
+    Clock::time_point now = Clock::now();
+    if (due < now)
+    {
+        overrun_count++;
+        started = now;
+        return;
+    }
+    std::this_thread::sleep_until(due);
+    started = due;
+}
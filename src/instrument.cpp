@@ -0,0 +1,241 @@
+#include "instrument.h"
+
+const char *instrument_stage_name(InstrumentStage stage)
+{
+    switch (stage)
+    {
+    case STAGE_SERIAL_REQUEST:
+        return "serial_request";
+    case STAGE_TELEMETRY_DECODE:
+        return "telemetry_decode";
+    case STAGE_AX25_FRAME:
+        return "ax25_frame";
+    case STAGE_AFSK:
+        return "afsk";
+    case STAGE_MODULATE:
+        return "modulate";
+    case STAGE_FILE_WRITE:
+        return "file_write";
+    case STAGE_TRANSMIT:
+        return "transmit";
+    case STAGE_BEACON_CYCLE:
+        return "beacon_cycle";
+    default:
+        return "?";
+    }
+}
+
+#ifdef FRANC_INSTRUMENT
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// HDR-style log-linear buckets over nanoseconds: values below 2^SUB_BITS
+// get a bucket each, above that every power of two is split into
+// 2^SUB_BITS buckets, so any value is within 1/16 (6%) of its bucket.
+// Values from 2^MAX_BITS ns (~18 minutes) up share the last bucket.
+static const int SUB_BITS = 4;
+static const int SUB_COUNT = 1 << SUB_BITS;
+static const int MAX_BITS = 40;
+static const int BUCKETS = SUB_COUNT + (MAX_BITS - SUB_BITS) * SUB_COUNT;
+
+static int bucket_of(uint64_t ns)
+{
+    if (ns < (uint64_t)SUB_COUNT)
+    {
+        return (int)ns;
+    }
+    int msb = 63 - __builtin_clzll(ns);
+    if (msb >= MAX_BITS)
+    {
+        return BUCKETS - 1;
+    }
+    int sub = (int)(ns >> (msb - SUB_BITS)) & (SUB_COUNT - 1);
+    return SUB_COUNT + (msb - SUB_BITS) * SUB_COUNT + sub;
+}
+
+// midpoint of the values that land in bucket b
+static double bucket_value(int b)
+{
+    if (b < SUB_COUNT)
+    {
+        return b;
+    }
+    int msb = (b - SUB_COUNT) / SUB_COUNT + SUB_BITS;
+    int sub = (b - SUB_COUNT) % SUB_COUNT;
+    double width = (double)(1ull << (msb - SUB_BITS));
+    return (double)(1ull << msb) + (sub + 0.5) * width;
+}
+
+struct StageHistogram
+{
+    // only the owning thread writes; the reporter reads concurrently
+    std::atomic<uint64_t> counts[BUCKETS];
+    std::atomic<uint64_t> sum_ns;
+};
+
+struct ThreadHistograms
+{
+    StageHistogram stages[STAGE_COUNT];
+
+    void clear()
+    {
+        for (auto &s : stages)
+        {
+            for (auto &c : s.counts)
+            {
+                c.store(0, std::memory_order_relaxed);
+            }
+            s.sum_ns.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+// plain snapshot of the sums over all threads
+struct Totals
+{
+    uint64_t counts[STAGE_COUNT][BUCKETS];
+    uint64_t sum_ns[STAGE_COUNT];
+};
+
+/**
+ * @brief All live per-thread histograms. Exiting threads fold theirs into
+ *        `retired` and leave the block for the next thread, so short-lived
+ *        workers (one per batch burst) don't grow the registry.
+ */
+struct Registry
+{
+    std::mutex lock;
+    std::vector<ThreadHistograms *> live;
+    std::vector<ThreadHistograms *> spare;
+    Totals retired = {};
+    Totals last_report = {};
+};
+
+static Registry &registry()
+{
+    static Registry *r = new Registry(); // never destroyed, threads may outlive main()
+    return *r;
+}
+
+static void accumulate(Totals &totals, const ThreadHistograms &h)
+{
+    for (int s = 0; s < STAGE_COUNT; s++)
+    {
+        for (int b = 0; b < BUCKETS; b++)
+        {
+            totals.counts[s][b] += h.stages[s].counts[b].load(std::memory_order_relaxed);
+        }
+        totals.sum_ns[s] += h.stages[s].sum_ns.load(std::memory_order_relaxed);
+    }
+}
+
+class ThreadSlot
+{
+public:
+    ThreadSlot()
+    {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        if (!r.spare.empty())
+        {
+            h = r.spare.back();
+            r.spare.pop_back();
+        }
+        else
+        {
+            h = new ThreadHistograms();
+            h->clear();
+        }
+        r.live.push_back(h);
+    }
+
+    ~ThreadSlot()
+    {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        accumulate(r.retired, *h);
+        h->clear();
+        for (size_t i = 0; i < r.live.size(); i++)
+        {
+            if (r.live[i] == h)
+            {
+                r.live[i] = r.live.back();
+                r.live.pop_back();
+                break;
+            }
+        }
+        r.spare.push_back(h);
+    }
+
+    ThreadHistograms *h;
+};
+
+void instrument_record(InstrumentStage stage, uint64_t ns)
+{
+    static thread_local ThreadSlot slot;
+    StageHistogram &s = slot.h->stages[stage];
+    // single writer: a load + store is enough, no locked read-modify-write
+    std::atomic<uint64_t> &c = s.counts[bucket_of(ns)];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    s.sum_ns.store(s.sum_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+}
+
+static double percentile(const uint64_t *counts, uint64_t total, double p)
+{
+    uint64_t rank = (uint64_t)(p * (total - 1)) + 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < BUCKETS; b++)
+    {
+        seen += counts[b];
+        if (seen >= rank)
+        {
+            return bucket_value(b);
+        }
+    }
+    return bucket_value(BUCKETS - 1);
+}
+
+void instrument_report(quill::Logger *logger)
+{
+    // large, and only touched under the registry lock
+    static Totals now;
+    static uint64_t interval[BUCKETS];
+
+    Registry &r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+
+    now = r.retired;
+    for (ThreadHistograms *h : r.live)
+    {
+        accumulate(now, *h);
+    }
+
+    for (int s = 0; s < STAGE_COUNT; s++)
+    {
+        uint64_t total = 0;
+        int highest = 0;
+        for (int b = 0; b < BUCKETS; b++)
+        {
+            interval[b] = now.counts[s][b] - r.last_report.counts[s][b];
+            total += interval[b];
+            if (interval[b])
+            {
+                highest = b;
+            }
+        }
+        if (!total)
+        {
+            continue;
+        }
+        double mean_us = (now.sum_ns[s] - r.last_report.sum_ns[s]) / 1e3 / total;
+        LOG_INFO(logger, "Latency {}: n={} mean={:.1f}us p50={:.1f}us p90={:.1f}us p99={:.1f}us max={:.1f}us",
+                 instrument_stage_name((InstrumentStage)s), total, mean_us,
+                 percentile(interval, total, 0.50) / 1e3, percentile(interval, total, 0.90) / 1e3,
+                 percentile(interval, total, 0.99) / 1e3, bucket_value(highest) / 1e3);
+    }
+    r.last_report = now;
+}
+
+#endif // FRANC_INSTRUMENT
@@ -2,11 +2,14 @@
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
+#include <cerrno>
 #include <unistd.h>
 #include <fcntl.h>
 #include <termios.h>
 #include <sys/ioctl.h>
+#include <poll.h>
 #include <iostream>
+#include <algorithm>
 
 // Internal helper: configure the serial port (8N1, no flow control)
 static int configureSerialPort(int fd, int baudRate)
@@ -46,6 +49,7 @@ static int configureSerialPort(int fd, int baudRate)
     tty.c_oflag = 0;
     tty.c_iflag = 0;
 
+    // non-blocking reads, waiting is done with poll()
     tty.c_cc[VMIN] = 0;
     tty.c_cc[VTIME] = 0;
 
@@ -57,134 +61,326 @@ static int configureSerialPort(int fd, int baudRate)
     return 0;
 }
 
-int interconnect_handshake(quill::Logger *logger)
+// Milliseconds left until the deadline, clamped to 0.
+static int remaining_ms(std::chrono::steady_clock::time_point deadline)
 {
-    const char *serialPort = "/dev/ttyACM0";
-    int fd = open(serialPort, O_RDWR | O_NOCTTY | O_SYNC);
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    return left.count() > 0 ? (int)left.count() : 0;
+}
+
+// ---------------------------------------------------------------------
+// SerialLink
+// ---------------------------------------------------------------------
+SerialLink::SerialLink(quill::Logger *logger)
+    : logger(logger), fd(-1), link_mode(LINK_JSON), timeout_ms(1000), handshake_timeout_ms(5000)
+{
+}
+
+SerialLink::~SerialLink()
+{
+    close();
+}
+
+bool SerialLink::open(const std::string &port, int baud, bool offer_binary)
+{
+    close();
+    link_mode = LINK_JSON;
+
+    fd = ::open(port.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
     if (fd < 0)
     {
-        LOG_ERROR(logger, "Error opening serial port {}: {}", serialPort, strerror(errno));
-        return -1;
+        LOG_ERROR(logger, "Error opening serial port {}: {}", port, strerror(errno));
+        return false;
     }
 
-    if (configureSerialPort(fd, 115200) < 0)
+    if (configureSerialPort(fd, baud) < 0)
     {
-        LOG_ERROR(logger, "Error configuring serial port {}", serialPort);
-        close(fd);
-        return -1;
+        LOG_ERROR(logger, "Error configuring serial port {}", port);
+        close();
+        return false;
     }
 
-    const char *handshakeMsg = "HELLO\n";
-    if (write(fd, handshakeMsg, std::strlen(handshakeMsg)) < 0)
+    // anything queued before we opened belongs to nobody
+    tcflush(fd, TCIFLUSH);
+
+    if (!send(offer_binary ? "HELLO FB1\n" : "HELLO\n"))
     {
         LOG_ERROR(logger, "Error writing handshake message: {}", strerror(errno));
-        close(fd);
-        return -1;
+        close();
+        return false;
     }
 
-    char buf[128];
-    int attempts = 0;
+    // The reply is a line, but very old firmware may send a bare "ACKHELLO";
+    // after seeing it, wait briefly for the rest of the line.
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(handshake_timeout_ms);
+    std::string reply;
     bool handshakeDone = false;
-    while (attempts < 50 && !handshakeDone)
+    while (true)
     {
-        usleep(100000); // wait 100 ms
-        int n = read(fd, buf, sizeof(buf) - 1);
-        if (n > 0)
+        std::string line;
+        if (read_line(line, remaining_ms(deadline)))
         {
-            buf[n] = '\0';
-            if (std::strstr(buf, "ACKHELLO") != nullptr)
+            if (line.find("ACKHELLO") != std::string::npos)
             {
+                reply = line;
                 handshakeDone = true;
+                break;
             }
+            continue;
+        }
+
+        // timed out without a newline: accept a partial "ACKHELLO" if present
+        size_t avail = rx.readAvailable();
+        reply.clear();
+        for (size_t i = 0; i < avail; i++)
+        {
+            reply.push_back((char)rx[i]);
         }
-        attempts++;
+        handshakeDone = (reply.find("ACKHELLO") != std::string::npos);
+        discard();
+        break;
     }
 
     if (!handshakeDone)
     {
-        LOG_ERROR(logger, "Handshake not completed on serial port {}", serialPort);
-        close(fd);
-        return -1;
+        LOG_ERROR(logger, "Handshake not completed on serial port {}", port);
+        close();
+        return false;
+    }
+
+    if (offer_binary && reply.find("FB1", reply.find("ACKHELLO")) != std::string::npos)
+    {
+        link_mode = LINK_FLATBUFFERS;
+    }
+
+    LOG_INFO(logger, "Serial handshake successful on {} ({} telemetry)", port,
+             (link_mode == LINK_FLATBUFFERS ? "FlatBuffers" : "JSON"));
+    return true;
+}
+
+void SerialLink::close()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
     }
+    discard();
+}
 
-    LOG_INFO(logger, "Serial handshake successful on {}", serialPort);
-    return fd;
+bool SerialLink::send(const char *cmd)
+{
+    size_t len = std::strlen(cmd);
+    size_t sent = 0;
+    while (sent < len)
+    {
+        ssize_t n = ::write(fd, cmd + sent, len - sent);
+        if (n > 0)
+        {
+            sent += n;
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EINTR)
+        {
+            return false;
+        }
+        struct pollfd pfd = {fd, POLLOUT, 0};
+        if (poll(&pfd, 1, timeout_ms) <= 0)
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
-std::string interconnect_bus(int fd)
+bool SerialLink::fill(Clock::time_point deadline)
 {
-    char buf[1024];
-    std::string line;
-    int pos = 0;
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    uint8_t chunk[512];
     while (true)
     {
-        int n = read(fd, buf + pos, sizeof(buf) - pos - 1);
+        size_t room = rx.writeAvailable();
+        if (room == 0)
+        {
+            // nobody consumed 8 KiB: the stream is garbage, start over
+            LOG_WARNING(logger, "Serial receive buffer overflow, dropping {} bytes", rx.readAvailable());
+            discard();
+            room = rx.writeAvailable();
+        }
+
+        ssize_t n = ::read(fd, chunk, std::min(room, sizeof(chunk)));
         if (n > 0)
         {
-            pos += n;
-            buf[pos] = '\0';
-            char *newline = std::strchr(buf, '\n');
-            if (newline != nullptr)
+            rx.writeBuff(chunk, n);
+            return true;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EINTR)
+        {
+            LOG_ERROR(logger, "Serial read error: {}", strerror(errno));
+            return false;
+        }
+
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int timeout = remaining_ms(deadline);
+        int ready = poll(&pfd, 1, timeout);
+        if (ready < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ready <= 0)
+        {
+            return false;
+        }
+    }
+}
+
+void SerialLink::discard()
+{
+    rx.consumerClear();
+}
+
+bool SerialLink::read_line(std::string &line, int timeout_ms)
+{
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    size_t scanned = 0;
+    while (true)
+    {
+        size_t avail = rx.readAvailable();
+        for (; scanned < avail; scanned++)
+        {
+            if (rx[scanned] != '\n')
             {
-                int lineLen = newline - buf;
-                line = std::string(buf, lineLen);
-                int remaining = pos - (lineLen + 1);
-                std::memmove(buf, newline + 1, remaining);
-                pos = remaining;
-                buf[pos] = '\0';
-                break;
+                continue;
             }
+            line.resize(scanned);
+            rx.readBuff(reinterpret_cast<uint8_t *>(&line[0]), scanned);
+            rx.remove(1);
+            while (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            return true;
         }
-        else
+
+        if (avail > LINK_LINE_MAX)
         {
-            usleep(100000); // wait 100 ms if no data
-            break;
+            // no newline in sight, drop it rather than growing forever
+            discard();
+            scanned = 0;
+        }
+
+        if (!fill(deadline))
+        {
+            return false;
+        }
+    }
+}
+
+bool SerialLink::read_frame(std::vector<uint8_t> &frame, int timeout_ms)
+{
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true)
+    {
+        // skip to the magic, so a stray byte only costs one frame
+        while (rx.readAvailable() >= 2 && !(rx[0] == LINK_FRAME_MAGIC[0] && rx[1] == LINK_FRAME_MAGIC[1]))
+        {
+            rx.remove(1);
+        }
+
+        size_t avail = rx.readAvailable();
+        if (avail >= 6)
+        {
+            uint32_t len = rx[2] | (rx[3] << 8) | (rx[4] << 16) | ((uint32_t)rx[5] << 24);
+            if (len == 0 || len > LINK_FRAME_MAX)
+            {
+                // not a real header, resync past this magic
+                rx.remove(2);
+                continue;
+            }
+            if (avail >= 6 + (size_t)len)
+            {
+                rx.remove(2);
+                frame.resize(4 + len);
+                rx.readBuff(frame.data(), frame.size());
+                return true;
+            }
+        }
+
+        if (!fill(deadline))
+        {
+            return false;
         }
     }
-    return line;
 }
 
 // ---------------------------------------------------------------------
 // request_json()
-// Sends a command "SEND\n" to the Teensy, waits until a valid JSON string
-// (starting with '{' and ending with '}') is received, prints out what is
-// received for debugging, sends "ACK\n", and returns the JSON string.
+// Sends "SEND\n", takes the first line that looks like JSON (starting
+// with '{' and ending with '}') within the timeout, sends "ACK\n".
 // ---------------------------------------------------------------------
-std::string request_json(int fd)
+bool SerialLink::request_json(std::string &json)
 {
-    const char *cmd = "SEND\n";
-    if (write(fd, cmd, std::strlen(cmd)) < 0)
+    discard();
+    if (!send("SEND\n"))
     {
-        std::cerr << "Error writing SEND command" << std::endl;
-        return "";
+        LOG_ERROR(logger, "Error writing SEND command: {}", strerror(errno));
+        return false;
     }
 
-    std::string jsonMsg;
-    const int maxAttempts = 50;
-    int attempts = 0;
-    while (attempts < maxAttempts)
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    bool ok = false;
+    while (read_line(json, remaining_ms(deadline)))
     {
-        jsonMsg = interconnect_bus(fd);
-
         // Trim leading and trailing whitespace
-        while (!jsonMsg.empty() && (jsonMsg.front() == ' ' || jsonMsg.front() == '\r' || jsonMsg.front() == '\n'))
-            jsonMsg.erase(0, 1);
-        while (!jsonMsg.empty() && (jsonMsg.back() == ' ' || jsonMsg.back() == '\r' || jsonMsg.back() == '\n'))
-            jsonMsg.pop_back();
+        size_t first = json.find_first_not_of(" \r\n");
+        size_t last = json.find_last_not_of(" \r\n");
+        json = (first == std::string::npos ? std::string() : json.substr(first, last - first + 1));
 
-        // std::cout << "DEBUG: Raw received: " << jsonMsg << std::endl;
         // Check if the message looks like JSON (starts with '{' and ends with '}')
-        if (!jsonMsg.empty() && jsonMsg.front() == '{' && jsonMsg.back() == '}')
+        if (!json.empty() && json.front() == '{' && json.back() == '}')
         {
+            ok = true;
             break;
         }
-        attempts++;
     }
 
     // Send ACK to indicate receipt.
-    const char *ackCmd = "ACK\n";
-    write(fd, ackCmd, std::strlen(ackCmd));
+    send("ACK\n");
 
-    // std::cout << "DEBUG: Final JSON: " << jsonMsg << std::endl;
-    return jsonMsg;
-}
\ No newline at end of file
+    if (!ok)
+    {
+        json.clear();
+    }
+    return ok;
+}
+
+// ---------------------------------------------------------------------
+// request_batch()
+// Sends "SENDFB\n", reads one size-prefixed SensorBatch frame and sends
+// "ACK\n". The buffer itself is verified by the decoder.
+// ---------------------------------------------------------------------
+bool SerialLink::request_batch(std::vector<uint8_t> &frame)
+{
+    discard();
+    if (!send("SENDFB\n"))
+    {
+        LOG_ERROR(logger, "Error writing SENDFB command: {}", strerror(errno));
+        return false;
+    }
+
+    bool ok = read_frame(frame, timeout_ms);
+
+    // Send ACK to indicate receipt (also after a bad frame, so the
+    // Teensy moves on to the next batch).
+    send("ACK\n");
+
+    if (!ok)
+    {
+        frame.clear();
+    }
+    return ok;
+}
@@ -0,0 +1,101 @@
+#include "iq_cache.h"
+#include "instrument.h"
+
+IQCache::IQCache(size_t max_bytes)
+    : max_bytes(max_bytes),
+      bytes(0),
+      hit_count(0),
+      miss_count(0)
+{
+}
+
+void IQCache::make_key(const Modulator &modulator, const char *callsign, const char *dest, const char *path,
+                       const char *info, OutputFormat iq_sf)
+{
+    // NUL separated strings (none of them can contain a NUL), then the
+    // settings that change the samples
+    key.clear();
+    for (const char *field : {callsign, dest, path, info})
+    {
+        key.append(field);
+        key.push_back('\0');
+    }
+    int32_t settings[5] = {(int32_t)iq_sf, (int32_t)modulator.backend(), (int32_t)modulator.chain(),
+                           modulator.preamble_flag_count(), modulator.silence_sample_count()};
+    key.append(reinterpret_cast<const char *>(settings), sizeof(settings));
+    // output rate and the filter chain that produced it
+    for (const ResamplerStage &stage : modulator.resampler_plan().stages)
+    {
+        int32_t factors[2] = {stage.interpolation, stage.decimation};
+        key.append(reinterpret_cast<const char *>(factors), sizeof(factors));
+    }
+}
+
+bool IQCache::modulate_packet(Modulator &modulator, const char *callsign, const char *dest, const char *path,
+                              const char *info, const IQWriter &write, OutputFormat iq_sf)
+{
+    make_key(modulator, callsign, dest, path, info, iq_sf);
+
+    auto found = index.find(key);
+    if (found != index.end())
+    {
+        hit_count++;
+        // move to the front; list iterators stay valid
+        lru.splice(lru.begin(), lru, found->second);
+        const std::vector<uint8_t> &iq = found->second->iq;
+        write(iq.data(), iq.size());
+        return true;
+    }
+
+    miss_count++;
+    FRANC_TIMED(STAGE_MODULATE);
+    size_t size = modulator.begin_packet(callsign, dest, path, info, iq_sf);
+    if (size > max_bytes)
+    {
+        // would evict everything and still not fit: stream it uncached
+        const void *data;
+        size_t n;
+        while (modulator.next_chunk(data, n))
+        {
+            write(data, n);
+        }
+        return false;
+    }
+
+    evict_to(max_bytes - size);
+
+    lru.emplace_front();
+    Entry &entry = lru.front();
+    entry.key = key;
+    entry.iq.reserve(size);
+
+    const void *data;
+    size_t n;
+    while (modulator.next_chunk(data, n))
+    {
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        entry.iq.insert(entry.iq.end(), p, p + n);
+        write(data, n);
+    }
+    bytes += entry.iq.size();
+    index.emplace(entry.key, lru.begin());
+    return false;
+}
+
+void IQCache::evict_to(size_t limit)
+{
+    while (bytes > limit && !lru.empty())
+    {
+        Entry &oldest = lru.back();
+        bytes -= oldest.iq.size();
+        index.erase(oldest.key);
+        lru.pop_back();
+    }
+}
+
+void IQCache::clear()
+{
+    index.clear();
+    lru.clear();
+    bytes = 0;
+}
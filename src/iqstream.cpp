@@ -0,0 +1,55 @@
+#include "iqstream.h"
+
+#include <algorithm>
+#include <thread>
+#include <chrono>
+
+IQStream::IQStream()
+    : ring(new IQRing_t()), is_closed(false), is_aborted(false), tap(nullptr)
+{
+}
+
+void IQStream::reset()
+{
+    ring->consumerClear();
+    is_closed.store(false, std::memory_order_release);
+    is_aborted.store(false, std::memory_order_release);
+}
+
+size_t IQStream::write(const int8_t *data, size_t count)
+{
+    if (tap)
+    {
+        std::fwrite(data, sizeof(int8_t), count, tap);
+    }
+
+    size_t written = 0;
+    while (written < count && !aborted())
+    {
+        // all or nothing per block, so concurrent writers never interleave within one
+        size_t n = ring->writeBuff(data + written, std::min(count - written, IQSTREAM_WRITE_BLOCK));
+        written += n;
+        if (n == 0)
+        {
+            // The TX callback drains one USB transfer (256 KiB) roughly every
+            // 55 ms at 2.4 MSPS, so a short sleep is plenty here.
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    return written;
+}
+
+size_t IQStream::read(int8_t *data, size_t count)
+{
+    return ring->readBuff(data, count);
+}
+
+void IQStream::close()
+{
+    is_closed.store(true, std::memory_order_release);
+}
+
+void IQStream::abort()
+{
+    is_aborted.store(true, std::memory_order_release);
+}
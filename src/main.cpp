@@ -2,17 +2,32 @@
 #include <cstdio>
 #include <cstdlib>
 #include <unistd.h>
+#include <getopt.h>
 #include <iostream>
+#include <thread>
+#include <algorithm>
 
 #include "logger.h"
 #include "aprs.h"
 #include "transmitter.h"
 #include "config.h"
+#include "config_store.h"
+#include "iqstream.h"
 #include "interconnect.h"
 #include "master_sensor_struct.h"
-#include "json.hpp"
+#include "telemetry.h"
+#include "telemetry_log.h"
+#include "aprs_telemetry.h"
+#include "sensor_history.h"
+#include "flight_phase.h"
+#include "stress.h"
+#include "pipeline.h"
+#include "batch.h"
+#include "iq_cache.h"
+#include "instrument.h"
 
-using json = nlohmann::json;
+// Cycles between two latency reports (FRANC_INSTRUMENT builds).
+static const int INSTRUMENT_REPORT_CYCLES = 10;
 
 // ---------------------------------------------------------------------
 // USAGE FUNCTION
@@ -27,52 +42,84 @@ static void usage(quill::Logger *logger)
     LOG_INFO(logger, "  -o <output file>         : Set output file name (default stdout)");
     LOG_INFO(logger, "  -f <sample format>       : Set sample format (s8, f32, pcm)");
     LOG_INFO(logger, "  -v                       : Enable debug messages");
+    LOG_INFO(logger, "  --stress[=<threads>]     : Measure parallel modulator throughput and exit");
     LOG_INFO(logger, "  <message>                : The APRS information field/message");
 }
 
+// Command-line flags, parsed once at startup and applied on top of every
+// Config the store loads (the first one and each reload).
+struct CliOverrides
+{
+    bool has_callsign = false;
+    std::string callsign;
+    bool has_dest = false;
+    std::string dest;
+    bool has_path = false;
+    std::string path;
+    bool has_output = false;
+    std::string output;
+    bool has_iq_sf = false;
+    OutputFormat iq_sf = IQ_S8;
+    bool debug = false;
+    bool stress = false;
+    bool has_stress_threads = false;
+    int stress_threads = 0;
+    bool has_info = false;
+    std::string info;
+};
+
 // ---------------------------------------------------------------------
-// FUNCTION: override_config_from_args
-// PURPOSE: If the user provided command-line flags, use them to override
-//          values that were loaded from the configuration file.
+// FUNCTION: parse_args
+// PURPOSE: Read the command-line flags that override values loaded from
+//          the configuration file. Exits on an invalid flag.
 // ---------------------------------------------------------------------
-void override_config_from_args(quill::Logger *logger, int argc, char *argv[], Config &config)
+static CliOverrides parse_args(quill::Logger *logger, int argc, char *argv[])
 {
+    CliOverrides cli;
     // Reset getopt's index (in case it was used before)
     optind = 1;
     int opt;
-    while ((opt = ::getopt(argc, argv, "c:d:p:o:f:v")) != -1)
+    static const struct option longOptions[] = {
+        {"stress", optional_argument, nullptr, 'S'},
+        {nullptr, 0, nullptr, 0}};
+    while ((opt = ::getopt_long(argc, argv, "c:d:p:o:f:v", longOptions, nullptr)) != -1)
     {
         switch (opt)
         {
         case 'c':
             // Override callsign with the flag value.
-            config.callsign = optarg;
+            cli.has_callsign = true;
+            cli.callsign = optarg;
             break;
         case 'd':
             // Override destination.
-            config.dest = optarg;
+            cli.has_dest = true;
+            cli.dest = optarg;
             break;
         case 'p':
             // Override path.
-            config.path = optarg;
+            cli.has_path = true;
+            cli.path = optarg;
             break;
         case 'o':
             // Override output file name.
-            config.output = optarg;
+            cli.has_output = true;
+            cli.output = optarg;
             break;
         case 'f':
             // Override sample format.
+            cli.has_iq_sf = true;
             if (std::strcmp(optarg, "s8") == 0)
             {
-                config.iq_sf = IQ_S8;
+                cli.iq_sf = IQ_S8;
             }
             else if (std::strcmp(optarg, "f32") == 0)
             {
-                config.iq_sf = IQ_F32;
+                cli.iq_sf = IQ_F32;
             }
             else if (std::strcmp(optarg, "pcm") == 0)
             {
-                config.iq_sf = PCM_F32;
+                cli.iq_sf = PCM_F32;
             }
             else
             {
@@ -82,7 +129,16 @@ void override_config_from_args(quill::Logger *logger, int argc, char *argv[], Co
             break;
         case 'v':
             // Enable debugging.
-            config.debug = true;
+            cli.debug = true;
+            break;
+        case 'S':
+            // Benchmark instead of beaconing; the optional value caps the threads.
+            cli.stress = true;
+            if (optarg)
+            {
+                cli.has_stress_threads = true;
+                cli.stress_threads = std::atoi(optarg);
+            }
             break;
         default:
             usage(logger);
@@ -92,20 +148,70 @@ void override_config_from_args(quill::Logger *logger, int argc, char *argv[], Co
     // Any remaining non-option argument is assumed to be the APRS message.
     if (optind < argc)
     {
-        config.info = argv[optind];
+        cli.has_info = true;
+        cli.info = argv[optind];
     }
+    return cli;
 }
 
 // ---------------------------------------------------------------------
-// FUNCTION: run_aprs
-// PURPOSE: Build the AX.25 frame, process it, and write the output file.
+// FUNCTION: override_config_from_args
+// PURPOSE: Copy the flags the user provided over the values that were
+//          loaded from the configuration file.
+// ---------------------------------------------------------------------
+static void override_config_from_args(const CliOverrides &cli, Config &config)
+{
+    if (cli.has_callsign)
+    {
+        config.callsign = cli.callsign;
+    }
+    if (cli.has_dest)
+    {
+        config.dest = cli.dest;
+    }
+    if (cli.has_path)
+    {
+        config.path = cli.path;
+    }
+    if (cli.has_output)
+    {
+        config.output = cli.output;
+    }
+    if (cli.has_iq_sf)
+    {
+        config.iq_sf = cli.iq_sf;
+    }
+    if (cli.debug)
+    {
+        config.debug = true;
+    }
+    if (cli.stress)
+    {
+        config.stress = true;
+    }
+    if (cli.has_stress_threads)
+    {
+        config.stress_threads = cli.stress_threads;
+    }
+    if (cli.has_info)
+    {
+        config.info = cli.info;
+    }
+}
+
+// ---------------------------------------------------------------------
+// FUNCTION: packet_fields
+// PURPOSE: Pick the callsign and message for this packet and log the
+//          settings it is built with. Without telemetry the default
+//          message goes out instead of the configured one.
 // ---------------------------------------------------------------------
-int run_aprs(quill::Logger *logger, const Config &config)
+static void packet_fields(quill::Logger *logger, const Config &config, bool haveTelemetry, std::string &callsignUsed,
+                          std::string &infoUsed)
 {
     // Use the configuration values; if a particular value is empty,
     // fall back to a hard-coded default.
-    const std::string callsignUsed = (!config.callsign.empty() ? config.callsign : "KD9WPR");
-    const std::string infoUsed = (!config.info.empty() ? config.info : "Hello from APRS default message");
+    callsignUsed = (!config.callsign.empty() ? config.callsign : "KD9WPR");
+    infoUsed = (haveTelemetry && !config.info.empty() ? config.info : "Hello from APRS default message");
 
     LOG_INFO(logger, "===========================");
     LOG_DEBUG(logger, "Using callsign: {}", callsignUsed);
@@ -116,16 +222,95 @@ int run_aprs(quill::Logger *logger, const Config &config)
               (config.iq_sf == IQ_S8 ? "IQ_S8" : config.iq_sf == IQ_F32 ? "IQ_F32"
                                                                         : "PCM_F32"));
     LOG_DEBUG(logger, "Using message: {}", infoUsed);
+}
+
+// ---------------------------------------------------------------------
+// FUNCTION: encode_telemetry
+// PURPOSE: Modulate the APRS telemetry report for one sample, preceded
+//          every [aprs_telemetry] metadata_every reports by the metadata
+//          messages and the status text. The metadata never changes and
+//          comes from the IQ cache; the report carries a new sequence
+//          number every time and is modulated directly.
+// ---------------------------------------------------------------------
+static void encode_telemetry(quill::Logger *logger, const Config &config, const std::string &callsignUsed,
+                             AprsTelemetry &aprs, const MasterSensorData &data, Modulator &modulator,
+                             IQCache &cache, const IQWriter &write, OutputFormat iq_sf)
+{
+    const char *dest = config.dest.c_str();
+    const char *path = config.path.c_str();
+    aprs.set_deadband(config.aprs_deadband);
+    aprs.set_addressee(callsignUsed.c_str());
+
+    if (aprs.metadata_due(config.aprs_metadata_every))
+    {
+        for (int i = 0; i < AprsTelemetry::METADATA_COUNT; i++)
+        {
+            cache.modulate_packet(modulator, callsignUsed.c_str(), dest, path, aprs.metadata(i), write, iq_sf);
+        }
+        const char *status = aprs.status(data);
+        LOG_DEBUG(logger, "Using status: {}", status);
+        cache.modulate_packet(modulator, callsignUsed.c_str(), dest, path, status, write, iq_sf);
+    }
 
-    // Build the AX.25 frame. Assume that ax25frame() accepts C-string parameters.
-    auto frame = ax25frame(callsignUsed.c_str(),
-                           config.dest.c_str(),
-                           (char*)config.path.c_str(),
-                           infoUsed.c_str(),
-                           false);
-    auto frame_nrzi = nrzi(frame);
-    auto wave = afsk(frame_nrzi);
+    const char *report = aprs.report(data);
+    LOG_DEBUG(logger, "Using telemetry: {} ({} fields re-formatted, {} unchanged)", report, aprs.formatted(),
+              aprs.skipped());
+    modulator.modulate_packet(callsignUsed.c_str(), dest, path, report, write, iq_sf);
+}
+
+// ---------------------------------------------------------------------
+// FUNCTION: encode_cycle
+// PURPOSE: Modulate this cycle's packet, or, if [batch] queues any info
+//          strings, all of them back to back as one burst. With
+//          [aprs_telemetry] enabled and a sample at hand, the packet is
+//          the telemetry report instead of `info`. sensorData is null if
+//          the poll failed. A flight phase change, if any, goes out
+//          first as its `event` status.
+// ---------------------------------------------------------------------
+static void encode_cycle(quill::Logger *logger, const Config &config, const MasterSensorData *sensorData,
+                         const char *event, AprsTelemetry &aprs, Modulator &modulator, BatchEncoder &batch,
+                         IQCache &cache, const IQWriter &write)
+{
+    std::string callsignUsed, infoUsed;
+    packet_fields(logger, config, sensorData != nullptr, callsignUsed, infoUsed);
+
+    if (event)
+    {
+        LOG_DEBUG(logger, "Using flight event: {}", event);
+        modulator.modulate_packet(callsignUsed.c_str(), config.dest.c_str(), config.path.c_str(), event, write,
+                                  config.iq_sf);
+    }
+
+    if (!config.batch_info.empty())
+    {
+        LOG_DEBUG(logger, "Using batch of {} packets, {} ms apart", config.batch_info.size(), config.batch_gap_ms);
+        batch.encode(callsignUsed.c_str(), config.dest.c_str(), config.path.c_str(), config.batch_info,
+                     write, config.iq_sf);
+        return;
+    }
 
+    if (config.aprs_telemetry && sensorData)
+    {
+        encode_telemetry(logger, config, callsignUsed, aprs, *sensorData, modulator, cache, write, config.iq_sf);
+        return;
+    }
+
+    // A packet sent before comes straight from the IQ cache; otherwise
+    // only the frame is modulated, silence + preamble are replayed.
+    if (cache.modulate_packet(modulator, callsignUsed.c_str(), config.dest.c_str(), config.path.c_str(),
+                              infoUsed.c_str(), write, config.iq_sf))
+    {
+        LOG_DEBUG(logger, "IQ cache hit ({} of {} packets)", cache.hits(), cache.hits() + cache.misses());
+    }
+}
+
+// ---------------------------------------------------------------------
+// FUNCTION: run_aprs
+// PURPOSE: Build the AX.25 frame, process it, and write the output file.
+// ---------------------------------------------------------------------
+int run_aprs(quill::Logger *logger, const Config &config, const MasterSensorData *sensorData, const char *event,
+             AprsTelemetry &aprs, Modulator &modulator, BatchEncoder &batch, IQCache &cache)
+{
     // Open the output file; if none was specified, default to stdout.
     FILE *fout = stdout;
     if (!config.output.empty())
@@ -139,25 +324,146 @@ int run_aprs(quill::Logger *logger, const Config &config)
     }
 
     // Write the processed data using the selected sample format.
-    if (config.iq_sf == PCM_F32)
+    encode_cycle(logger, config, sensorData, event, aprs, modulator, batch, cache,
+                 [fout](const void *data, size_t size)
+                 {
+                     FRANC_TIMED(STAGE_FILE_WRITE);
+                     std::fwrite(data, 1, size, fout); });
+
+    // If output is not stdout, close the file.
+    if (fout != stdout)
     {
-        std::fwrite(wave.data(), sizeof(float), wave.size(), fout);
+        std::fclose(fout);
     }
-    else
+
+    LOG_INFO(logger, "APRS processing finished successfully.");
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// FUNCTION: run_aprs_stream
+// PURPOSE: Build the AX.25 frame and modulate it straight into the TX
+//          stream. The stream is always closed on return so the
+//          transmitter never waits on a producer that has given up.
+// ---------------------------------------------------------------------
+int run_aprs_stream(quill::Logger *logger, const Config &config, const MasterSensorData *sensorData,
+                    const char *event, AprsTelemetry &aprs, Modulator &modulator, BatchEncoder &batch,
+                    IQCache &cache, IQStream &stream)
+{
+    // Optional debug tap: keep a copy of the samples in the output file.
+    FILE *tap = nullptr;
+    if (config.iq_tap && !config.output.empty())
     {
-        modulate(wave, fout, config.iq_sf);
+        tap = std::fopen(config.output.c_str(), "wb");
+        if (!tap)
+        {
+            LOG_ERROR(logger, "Error creating IQ tap file '{}'", config.output);
+        }
     }
+    stream.set_tap(tap);
 
-    // If output is not stdout, close the file.
-    if (fout != stdout)
+    encode_cycle(logger, config, sensorData, event, aprs, modulator, batch, cache,
+                 [&stream](const void *data, size_t size)
+                 { stream.write(static_cast<const int8_t *>(data), size); });
+    stream.close();
+
+    stream.set_tap(nullptr);
+    if (tap)
     {
-        std::fclose(fout);
+        std::fclose(tap);
     }
 
     LOG_INFO(logger, "APRS processing finished successfully.");
     return 0;
 }
 
+// ---------------------------------------------------------------------
+// FUNCTION: encode_packet
+// PURPOSE: TX_PIPELINE encoder: build and modulate the packet for one
+//          telemetry sample. As in the serial loop, a failed poll falls
+//          back to the default message, and a flight event goes first.
+// ---------------------------------------------------------------------
+static void encode_packet(quill::Logger *logger, const Config &config, const TelemetrySample &sample,
+                          const char *event, AprsTelemetry &aprs, Modulator &modulator, IQCache &cache,
+                          const IQWriter &write)
+{
+    std::string callsignUsed, infoUsed;
+    packet_fields(logger, config, sample.valid, callsignUsed, infoUsed);
+    if (event)
+    {
+        LOG_DEBUG(logger, "Using flight event: {}", event);
+        modulator.modulate_packet(callsignUsed.c_str(), config.dest.c_str(), config.path.c_str(), event, write,
+                                  IQ_S8);
+    }
+    if (config.aprs_telemetry && sample.valid)
+    {
+        encode_telemetry(logger, config, callsignUsed, aprs, sample.data, modulator, cache, write, IQ_S8);
+        return;
+    }
+    cache.modulate_packet(modulator, callsignUsed.c_str(), config.dest.c_str(), config.path.c_str(), infoUsed.c_str(),
+                          write, IQ_S8);
+}
+
+// ---------------------------------------------------------------------
+// FUNCTION: record_history
+// PURPOSE: Adds a decoded sample to the flight history, logs the trend
+//          of the last minute and updates the flight phase. Returns the
+//          status to send for a phase change, or null.
+// ---------------------------------------------------------------------
+static const char *record_history(quill::Logger *logger, const Config &config, SensorHistory &history,
+                                  FlightPhaseTracker &flight, const MasterSensorData &data)
+{
+    static const int altitude = SensorHistory::column("mpl_altitude");
+    static const int accel = SensorHistory::column("lsm_accel_magnitude");
+    static const unsigned long TREND_MS = 60000;
+
+    if (!history.append(data))
+    {
+        return nullptr;
+    }
+    SensorStats alt = history.stats(altitude, TREND_MS);
+    SensorStats acc = history.stats(accel, TREND_MS);
+    LOG_DEBUG(logger, "History: {} samples, altitude max {} m, climb {} m/s, mean accel {} m/s2 over {} readings",
+              history.size(), alt.max, alt.slope, acc.mean, acc.count);
+
+    if (!flight.update(history, config) || !config.flight_events)
+    {
+        return nullptr;
+    }
+    return flight.event();
+}
+
+// ---------------------------------------------------------------------
+// FUNCTION: adjust_config
+// PURPOSE: Everything applied on top of the file: command-line flags, and
+//          the file-mode fallback for settings the stream cannot carry.
+// ---------------------------------------------------------------------
+static void adjust_config(quill::Logger *logger, const CliOverrides &cli, Config &config)
+{
+    override_config_from_args(cli, config);
+
+    if ((config.tx_mode == TX_STREAM || config.tx_mode == TX_PIPELINE) && config.iq_sf != IQ_S8)
+    {
+        LOG_WARNING(logger, "tx_mode = stream/pipeline needs sample_format = s8; falling back to file mode");
+        config.tx_mode = TX_FILE;
+    }
+}
+
+// ---------------------------------------------------------------------
+// FUNCTION: apply_log_level
+// PURPOSE: Text logging level from the config; -v / debug = true keeps
+//          the debug messages.
+// ---------------------------------------------------------------------
+static void apply_log_level(quill::Logger *logger, const Config &config)
+{
+    quill::LogLevel logLevel = config.log_level;
+    if (config.debug && logLevel > quill::LogLevel::Debug)
+    {
+        logLevel = quill::LogLevel::Debug;
+    }
+    logger->set_log_level(logLevel);
+}
+
 // ---------------------------------------------------------------------
 // MAIN FUNCTION
 // PURPOSE: Initialize the logger, load configuration from the file,
@@ -171,20 +477,31 @@ int main(int argc, char *argv[])
     LOG_INFO(logger, "FRANC program initializing...");
 
     // -----------------------------------------------------------------
-    // Step 1. Load the configuration from "franc.cfg".
-    //         This loads built-in defaults if the config file is missing.
+    // Step 1. Load the configuration from config.cfg ($FRANC_CONFIG
+    //         overrides the path). This loads built-in defaults if the
+    //         config file is missing.
     // -----------------------------------------------------------------
-    const std::string configFile = "/local/franc/franc-master-control/config.cfg";
-    Config config = load_config(configFile, logger);
+    const char *configEnv = std::getenv("FRANC_CONFIG");
+    const std::string configFile = configEnv ? configEnv : "/local/franc/franc-master-control/config.cfg";
 
     // -----------------------------------------------------------------
     // Step 2. If any command-line flags are provided, override the
-    //         configuration values loaded from the config file.
+    //         configuration values loaded from the config file. The
+    //         flags are parsed once here; the store applies them again
+    //         on every reload (on its watcher thread).
     // -----------------------------------------------------------------
-    if (argc > 1)
+    const CliOverrides cli = parse_args(logger, argc, argv);
+    ConfigStore store(logger, configFile, [logger, &cli](Config &loaded)
+                      { adjust_config(logger, cli, loaded); });
+    if (!store.load())
     {
-        override_config_from_args(logger, argc, argv, config);
+        LOG_ERROR(logger, "Invalid configuration in {}, exiting.", configFile);
+        return 1;
     }
+    // What the long-lived objects below are built from; every cycle and
+    // packet reads the then-current snapshot instead.
+    const ConfigSnapshot startup = store.current();
+    const Config &config = *startup;
 
     // -----------------------------------------------------------------
     // Step 3. If debugging is enabled, print out the final configuration.
@@ -195,119 +512,203 @@ int main(int argc, char *argv[])
         // print_config(config);
     }
 
-    int fd = interconnect_handshake(logger);
-    if (fd < 0)
+    apply_log_level(logger, config);
+
+    // The modulator resamples straight to the rate the HackRF is set to.
+    ResamplerPlan plan = plan_resampler(AUDIO_SAMPLE_RATE, config.sampleRate, config.resampler_stages);
+    if (!plan.valid())
+    {
+        LOG_ERROR(logger, "sampleRate {} S/s must be above the {} S/s audio rate", config.sampleRate,
+                  AUDIO_SAMPLE_RATE);
+        return 1;
+    }
+    if (plan.output_rate != config.sampleRate)
+    {
+        LOG_WARNING(logger, "sampleRate {} S/s is not a usable ratio of {} S/s, modulating at {:.3f} S/s",
+                    config.sampleRate, AUDIO_SAMPLE_RATE, plan.output_rate);
+    }
+    if (config.chain == CHAIN_CIC)
+    {
+        LOG_INFO(logger, "CIC FM chain x{}/{}", plan.interpolation(), plan.decimation());
+    }
+    else
+    {
+        LOG_INFO(logger, "Resampler {}", resampler_plan_string(plan));
+    }
+
+    // --stress: how many channels this board could modulate; no radio or
+    // serial link involved.
+    if (config.stress)
+    {
+        return run_stress(logger, config);
+    }
+
+    // Filter design and polyphase setup happen once here, not per packet.
+    Modulator modulator(config.modulator, config.preamble_flags, config.silence_ms, config.sampleRate,
+                        config.resampler_stages, config.chain);
+
+    // [batch] packets get a modulator per worker thread, created on first use.
+    BatchEncoder batch(logger, config.modulator, config.preamble_flags, config.silence_ms,
+                       config.batch_gap_ms, config.batch_workers, config.sampleRate, config.resampler_stages,
+                       config.chain);
+
+    // Repeated packets (status, position on the pad, canned messages) are
+    // sent from memory instead of being modulated again.
+    IQCache cache((size_t)std::max(0, config.iq_cache_mb) * 1024 * 1024);
+
+    // Reused for every packet in TX_STREAM mode (the ring is 4 MiB).
+    IQStream stream;
+
+    // Telemetry report fields are re-formatted only when their value moves.
+    AprsTelemetry aprsTelemetry(config.aprs_deadband);
+
+    // Recent samples as columns, for trends over the flight, and the
+    // flight phase they show; the phase sets the beacon rate.
+    SensorHistory sensorHistory;
+    FlightPhaseTracker flight(logger);
+
+    // Open the HackRF once; it stays tuned between beacons and is reopened
+    // automatically if a burst hits a USB error.
+    HackRfTransmitter transmitter(logger);
+    if (!transmitter.open(config))
+    {
+        LOG_ERROR(logger, "HackRF not available yet, will retry on the next transmission");
+    }
+
+    // Ground testing: callsign, path, message and gain follow edits of the
+    // config file without a restart (and without a new Teensy handshake).
+    store.set_listener([logger, &transmitter](const Config &reloaded)
+                       {
+                           apply_log_level(logger, reloaded);
+                           transmitter.update(reloaded); });
+    store.watch();
+
+    // Offer the FlatBuffers SensorBatch link; the Teensy may still pick JSON.
+    bool offerBinary = config.binary_link && sensor_batch_supported();
+    if (config.binary_link && !offerBinary)
+    {
+        LOG_WARNING(logger, "Built without FlatBuffers support; telemetry stays on JSON");
+    }
+    SerialLink serial(logger);
+    serial.set_timeout(config.serial_timeout_ms);
+    serial.set_handshake_timeout(config.handshake_timeout_ms);
+    if (!serial.open(config.serial_port, config.serial_baud, offerBinary))
     {
         LOG_ERROR(logger, "Interconnect handshake failed, exiting.");
         return 1;
     }
 
-    // Loop forever: poll the serial bus once every second, update config.info
-    // with any received JSON message (if the JSON contains an "info" field),
-    // then process and transmit APRS data.
-    while (true)
+    // Keeps its receive buffers across polls.
+    TelemetryReader telemetry(logger, serial);
+
+    // Every decoded sample also goes to the binary telemetry log, written
+    // and rotated by its own thread.
+    TelemetryLog telemetryLog(logger, config.telemetry_log_path, config.telemetry_log_max_bytes,
+                              config.telemetry_log_keep, config.telemetry_log_fsync_ms);
+    if (config.telemetry_log && telemetryLog.start())
+    {
+        telemetry.set_log(&telemetryLog);
+    }
+
+    if (config.tx_mode == TX_PIPELINE)
+    {
+        // Acquisition, modulation and TX each get a thread; runs until killed.
+        BeaconPipeline pipeline(logger, config, telemetry, modulator, transmitter,
+                                [logger, &store, &cache, &aprsTelemetry, &sensorHistory, &flight](const TelemetrySample &sample,
+                                                                                                  Modulator &mod,
+                                                                                                  const IQWriter &write)
+                                {
+                                    ConfigSnapshot snapshot = store.current();
+                                    const char *event = nullptr;
+                                    if (sample.valid)
+                                    {
+                                        event = record_history(logger, *snapshot, sensorHistory, flight, sample.data);
+                                    }
+                                    encode_packet(logger, *snapshot, sample, event, aprsTelemetry, mod, cache, write);
+                                });
+        pipeline.run();
+        serial.close();
+        return 0;
+    }
+
+    // Loop forever: poll the serial bus once per cycle, decode the
+    // telemetry (SensorBatch or JSON, as negotiated), then process and
+    // transmit APRS data. Cycles start on deadlines [flight] sets for the
+    // current flight phase.
+    BeaconScheduler scheduler;
+    for (uint64_t cycle = 1;; cycle++)
     {
-        std::string jsonMsg = request_json(fd);
-        if (!jsonMsg.empty())
         {
-            try
+            // One beacon cycle, timed as a whole, with one config snapshot.
+            FRANC_TIMED(STAGE_BEACON_CYCLE);
+            const ConfigSnapshot snapshot = store.current();
+            const Config &cycleConfig = *snapshot;
+            MasterSensorData sensorData;
+            bool haveSensorData = telemetry.poll(sensorData);
+            const char *event = nullptr;
+
+            if (haveSensorData)
+            {
+                LOG_DEBUG(logger, "Timestamp: {}", sensorData.timestamp);
+                LOG_DEBUG(logger, "BME688 Temperature: {}", sensorData.bme_temperature);
+                LOG_DEBUG(logger, "ENS160 AQI: {}", sensorData.ens_aqi);
+                event = record_history(logger, cycleConfig, sensorHistory, flight, sensorData);
+            }
+
+            if (config.tx_mode == TX_STREAM)
             {
-                json j = json::parse(jsonMsg);
-                if (j.contains("timestamp"))
+                LOG_INFO(logger, "===========================");
+                LOG_INFO(logger, "Started transmission of in-memory stream");
+
+                stream.reset();
+                std::thread producer([&]()
+                                     { run_aprs_stream(logger, cycleConfig, haveSensorData ? &sensorData : nullptr, event,
+                                                       aprsTelemetry, modulator, batch, cache, stream); });
+                bool success = transmitter.transmit_stream(stream);
+                producer.join();
+
+                if (!success)
                 {
-                    // Create an instance of our master structure and populate it.
-                    MasterSensorData sensorData;
-                    sensorData.timestamp = j.value("timestamp", 0);
-
-                    sensorData.bme_temperature = j.value("bme_temperature", 0.0f);
-                    sensorData.bme_pressure = j.value("bme_pressure", 0.0f);
-                    sensorData.bme_humidity = j.value("bme_humidity", 0.0f);
-                    sensorData.bme_gas_resistance = j.value("bme_gas_resistance", 0.0f);
-                    sensorData.bme_altitude = j.value("bme_altitude", 0.0f);
-
-                    sensorData.ens_aqi = j.value("ens_aqi", 0);
-                    sensorData.ens_tvoc = j.value("ens_tvoc", 0);
-                    sensorData.ens_eco2 = j.value("ens_eco2", 0);
-                    sensorData.ens_hp0 = j.value("ens_hp0", 0.0f);
-                    sensorData.ens_hp1 = j.value("ens_hp1", 0.0f);
-                    sensorData.ens_hp2 = j.value("ens_hp2", 0.0f);
-                    sensorData.ens_hp3 = j.value("ens_hp3", 0.0f);
-
-                    sensorData.lsm_accel_x = j.value("lsm_accel_x", 0.0f);
-                    sensorData.lsm_accel_y = j.value("lsm_accel_y", 0.0f);
-                    sensorData.lsm_accel_z = j.value("lsm_accel_z", 0.0f);
-                    sensorData.lsm_gyro_x = j.value("lsm_gyro_x", 0.0f);
-                    sensorData.lsm_gyro_y = j.value("lsm_gyro_y", 0.0f);
-                    sensorData.lsm_gyro_z = j.value("lsm_gyro_z", 0.0f);
-
-                    sensorData.mpl_pressure = j.value("mpl_pressure", 0.0f);
-                    sensorData.mpl_altitude = j.value("mpl_altitude", 0.0f);
-
-                    sensorData.bno_accel_x = j.value("bno_accel_x", 0.0f);
-                    sensorData.bno_accel_y = j.value("bno_accel_y", 0.0f);
-                    sensorData.bno_accel_z = j.value("bno_accel_z", 0.0f);
-                    sensorData.bno_mag_x = j.value("bno_mag_x", 0.0f);
-                    sensorData.bno_mag_y = j.value("bno_mag_y", 0.0f);
-                    sensorData.bno_mag_z = j.value("bno_mag_z", 0.0f);
-                    sensorData.bno_gyro_x = j.value("bno_gyro_x", 0.0f);
-                    sensorData.bno_gyro_y = j.value("bno_gyro_y", 0.0f);
-                    sensorData.bno_gyro_z = j.value("bno_gyro_z", 0.0f);
-                    sensorData.bno_euler_heading = j.value("bno_euler_heading", 0.0f);
-                    sensorData.bno_euler_roll = j.value("bno_euler_roll", 0.0f);
-                    sensorData.bno_euler_pitch = j.value("bno_euler_pitch", 0.0f);
-                    sensorData.bno_linear_accel_x = j.value("bno_linear_accel_x", 0.0f);
-                    sensorData.bno_linear_accel_y = j.value("bno_linear_accel_y", 0.0f);
-                    sensorData.bno_linear_accel_z = j.value("bno_linear_accel_z", 0.0f);
-                    sensorData.bno_gravity_x = j.value("bno_gravity_x", 0.0f);
-                    sensorData.bno_gravity_y = j.value("bno_gravity_y", 0.0f);
-                    sensorData.bno_gravity_z = j.value("bno_gravity_z", 0.0f);
-                    sensorData.bno_calibration_system = j.value("bno_calibration_system", 0);
-                    sensorData.bno_calibration_gyro = j.value("bno_calibration_gyro", 0);
-                    sensorData.bno_calibration_accel = j.value("bno_calibration_accel", 0);
-                    sensorData.bno_calibration_mag = j.value("bno_calibration_mag", 0);
-
-                    LOG_INFO(logger, "Timestamp: {}", sensorData.timestamp);
-                    LOG_INFO(logger, "BME688 Temperature: {}", sensorData.bme_temperature);
-                    LOG_INFO(logger, "ENS160 AQI: {}", sensorData.ens_aqi);
+                    LOG_CRITICAL(logger, "Transmission failed");
                 }
-
                 else
                 {
-                    LOG_INFO(logger, "JSON matching error.");
-                    config.info = "";
+                    LOG_INFO(logger, "Transmission completed successfully");
                 }
             }
-            catch (std::exception &e)
+            else
             {
-                LOG_ERROR(logger, "JSON parse error: {}", e.what());
-                config.info = "";
+                int result = run_aprs(logger, cycleConfig, haveSensorData ? &sensorData : nullptr, event,
+                                      aprsTelemetry, modulator, batch, cache);
+
+                std::string s8File = (!cycleConfig.output.empty() ? cycleConfig.output : "pkt8.s8");
+                LOG_INFO(logger, "===========================");
+                LOG_INFO(logger, "Started transmission of {}", s8File);
+
+                // // bool success = transmitter.transmit_file(s8File);
+                // if (!success)
+                // {
+                //     LOG_CRITICAL(logger, "Transmission failed");
+                // }
+                // else
+                // {
+                //     LOG_INFO(logger, "Transmission completed successfully");
+                // }
             }
         }
-        else
+
+        // Latency percentiles of the last INSTRUMENT_REPORT_CYCLES cycles.
+        if (cycle % INSTRUMENT_REPORT_CYCLES == 0)
         {
-            LOG_ERROR(logger, "JSON empty.");
-            config.info = "";
+            FRANC_INSTRUMENT_REPORT(logger);
         }
 
-        int result = run_aprs(logger, config);
-
-        std::string s8File = (!config.output.empty() ? config.output : "pkt8.s8");
-        LOG_INFO(logger, "===========================");
-        LOG_INFO(logger, "Started transmission of {}", s8File);
-
-        // // bool success = transmit_s8_iq_file(s8File, logger, config);
-        // if (!success)
-        // {
-        //     LOG_CRITICAL(logger, "Transmission failed");
-        // }
-        // else
-        // {
-        //     LOG_INFO(logger, "Transmission completed successfully");
-        // }
-
-        sleep(1); // Wait 1 second before the next cycle.
+        // Until this cycle's start plus the interval of the phase it ended in
+        // (the boost one while a launch waits to be confirmed).
+        scheduler.wait(flight.interval_ms(*store.current()));
     }
 
-    close(fd);
+    store.stop();
+    serial.close();
     return 0;
 }
\ No newline at end of file
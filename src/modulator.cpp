@@ -0,0 +1,408 @@
+#include "modulator.h"
+#include "instrument.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+std::vector<int8_t> f32_to_s8(const std::vector<std::complex<float>> &input)
+{
+    std::vector<int8_t> result(input.size() * 2);
+    f32_to_s8(input.data(), input.size(), result.data());
+    return result;
+}
+
+void f32_to_s8(const std::complex<float> *input, size_t count, int8_t *output)
+{
+    // same rounding and saturation as the fused path in FIRInterpolator
+    static const fir_quantize_fn quantize = fir_quantizer(fir_best_kernel());
+    quantize(reinterpret_cast<const float *>(input), count * 2, SCHAR_MAX, output);
+}
+
+const std::vector<float> &modulator_taps()
+{
+    static const std::vector<float> taps = []()
+    {
+        float factor = INTERPOLATION;
+        float fractional_bw = 0.4;
+        float halfband = 0.5;
+        float trans_width = halfband - fractional_bw;
+        float mid_transition_band = halfband - trans_width / 2.0;
+        return lowpass(factor, factor, mid_transition_band, trans_width);
+    }();
+    return taps;
+}
+
+// rates the planner cannot reach (at or below the audio rate) fall back to the default
+static ResamplerPlan modulator_plan(double sample_rate, int resampler_stages)
+{
+    ResamplerPlan plan = plan_resampler(AUDIO_SAMPLE_RATE, sample_rate, resampler_stages);
+    return plan.valid() ? plan : plan_resampler(AUDIO_SAMPLE_RATE, DEFAULT_IQ_RATE, resampler_stages);
+}
+
+Modulator::Modulator(ModulatorBackend backend, int preamble_flags, int silence_ms, double sample_rate,
+                     int resampler_stages, ModulatorChain chain)
+    : mod_backend(backend),
+      sensitivity(2 * M_PI * MAX_DEVIATION / (float)AUDIO_SAMPLE_RATE),
+      iq_resampler(modulator_plan(sample_rate, resampler_stages)),
+      mod_chain(chain),
+      cic(iq_resampler.plan().interpolation(), iq_resampler.plan().decimation(), sensitivity),
+      fm_phase(0),
+      preamble_flags(preamble_flags),
+      silence_samples(0),
+      stage(PULL_IDLE),
+      pull_fmt(IQ_S8),
+      pull_prefix(nullptr),
+      pull_offset(0),
+      pending(nullptr),
+      pending_size(0)
+{
+    set_framing(preamble_flags, silence_ms);
+    // a full ring's worth of output of the last stage, or of one block of audio
+    interp_buf.resize(std::max(iq_resampler.block_size(), cic.output_count(BUFSIZE, 1) + 1));
+    // arena for the fused int8 path
+    s8_buf.resize(interp_buf.size() * 2);
+}
+
+void Modulator::set_backend(ModulatorBackend backend)
+{
+    if (backend != mod_backend)
+    {
+        mod_backend = backend;
+        invalidate_prefix();
+    }
+}
+
+void Modulator::set_framing(int flags, int silence_ms)
+{
+    int samples = (int)((int64_t)AUDIO_SAMPLE_RATE * std::max(0, silence_ms) / 1000);
+    flags = std::max(0, flags);
+    if (flags != preamble_flags || samples != silence_samples)
+    {
+        preamble_flags = flags;
+        silence_samples = samples;
+        invalidate_prefix();
+    }
+}
+
+void Modulator::invalidate_prefix()
+{
+    // a packet being pulled may point into the cache
+    stage = PULL_IDLE;
+    pending_size = 0;
+    for (auto &c : prefix)
+    {
+        c.valid = false;
+        c.samples.clear();
+        c.samples.shrink_to_fit();
+    }
+}
+
+void Modulator::begin()
+{
+    mod_buf.consumerClear();
+    iq_resampler.reset();
+    cic.reset();
+    fm_phase = 0;
+}
+
+bool Modulator::feed_block(const float *audio, size_t count, size_t &offset, OutputFormat iq_sf,
+                           const void *&data, size_t &size)
+{
+    if (mod_chain == CHAIN_CIC)
+    {
+        return feed_block_cic(audio, count, offset, iq_sf, data, size);
+    }
+    while (true)
+    {
+        size_t pairs;
+        if (iq_sf == IQ_S8)
+        {
+            // fused resample + quantize, no complex<float> block in between
+            pairs = iq_resampler.process(mod_buf, s8_buf.data(), s8_buf.size() / 2, SCHAR_MAX);
+        }
+        else
+        {
+            pairs = iq_resampler.process(mod_buf, interp_buf.data(), interp_buf.size());
+        }
+        if (pairs)
+        {
+            if (iq_sf == IQ_S8)
+            {
+                data = s8_buf.data();
+                size = pairs * 2 * sizeof(int8_t);
+            }
+            else
+            {
+                data = interp_buf.data();
+                size = pairs * sizeof(std::complex<float>);
+            }
+            return true;
+        }
+        if (offset >= count)
+        {
+            return false;
+        }
+
+        // drained down to the filter history: room for a whole block
+        int input_size = std::min(BUFSIZE, (int)(count - offset));
+        if (mod_backend == MOD_NCO)
+        {
+            fm_phase = fmmod_nco(audio + offset, input_size, mod_buf, sensitivity, fm_phase);
+        }
+        else
+        {
+            fm_phase = fmmod(audio + offset, input_size, mod_buf, sensitivity, fm_phase);
+        }
+        offset += input_size;
+    }
+}
+
+bool Modulator::feed_block_cic(const float *audio, size_t count, size_t &offset, OutputFormat iq_sf,
+                               const void *&data, size_t &size)
+{
+    if (offset >= count)
+    {
+        return false;
+    }
+    // no history to build up: every block of audio gives output
+    int input_size = std::min(BUFSIZE, (int)(count - offset));
+    if (iq_sf == IQ_S8)
+    {
+        size_t pairs = cic.process(audio + offset, input_size, s8_buf.data());
+        data = s8_buf.data();
+        size = pairs * 2 * sizeof(int8_t);
+    }
+    else
+    {
+        size_t pairs = cic.process(audio + offset, input_size, interp_buf.data());
+        data = interp_buf.data();
+        size = pairs * sizeof(std::complex<float>);
+    }
+    offset += input_size;
+    return true;
+}
+
+void Modulator::feed(const float *audio, size_t count, const IQWriter &write, OutputFormat iq_sf)
+{
+    size_t offset = 0;
+    const void *data;
+    size_t size;
+    while (feed_block(audio, count, offset, iq_sf, data, size))
+    {
+        write(data, size);
+    }
+}
+
+void Modulator::modulate(const std::vector<float> &waveform, const IQWriter &write, OutputFormat iq_sf)
+{
+    FRANC_TIMED(STAGE_MODULATE);
+    begin();
+    feed(waveform.data(), waveform.size(), write, iq_sf);
+}
+
+void Modulator::modulate(const std::vector<float> &waveform, IQStream &stream)
+{
+    modulate(waveform, [&stream](const void *data, size_t size)
+             { stream.write(static_cast<const int8_t *>(data), size); }, IQ_S8);
+    stream.close();
+}
+
+const Modulator::PrefixCache &Modulator::prefix_for(OutputFormat iq_sf)
+{
+    PrefixCache &c = prefix[iq_sf == IQ_S8 ? 0 : 1];
+    if (c.valid)
+    {
+        return c;
+    }
+
+    // leading silence + sync bits + flags, modulated from a clean state
+    begin();
+    audio.assign(silence_samples, 0.0f);
+    c.nrzi_level = ax25preamble_nrzi(bits, preamble_flags);
+    c.afsk = AfskState();
+    afsk_append(bits, audio, c.afsk, mod_backend);
+
+    c.samples.clear();
+    feed(audio.data(), audio.size(), [&c](const void *data, size_t size)
+         {
+             const uint8_t *p = static_cast<const uint8_t *>(data);
+             c.samples.insert(c.samples.end(), p, p + size); },
+         iq_sf);
+
+    // whatever the FIR has not consumed yet is needed to continue seamlessly
+    Ringbuffer_t::Span first, second;
+    mod_buf.readSpans(first, second);
+    c.history.assign(first.data, first.data + first.size);
+    c.history.insert(c.history.end(), second.data, second.data + second.size);
+    iq_resampler.save(c.resampler_state);
+    c.cic_state = cic.state();
+    c.fm_phase = fm_phase;
+    c.audio_samples = audio.size();
+    c.valid = true;
+    return c;
+}
+
+size_t Modulator::output_size(size_t audio_samples, OutputFormat iq_sf) const
+{
+    if (iq_sf == PCM_F32)
+    {
+        return audio_samples * sizeof(float);
+    }
+    size_t pairs = mod_chain == CHAIN_CIC ? cic.output_count(audio_samples, 0)
+                                          : iq_resampler.output_count(audio_samples);
+    return pairs * (iq_sf == IQ_S8 ? 2 * sizeof(int8_t) : sizeof(std::complex<float>));
+}
+
+size_t Modulator::packet_size(const char *callsign, const char *dest, const char *path, const char *info,
+                              OutputFormat iq_sf)
+{
+    // bit stuffing makes the frame length data dependent, so encode it
+    bool level = ax25preamble_nrzi(size_bits, preamble_flags);
+    size_t nbits = size_bits.size();
+    ax25payload_nrzi(callsign, dest, path, info, size_bits, level);
+    nbits += size_bits.size();
+    return output_size(2 * (size_t)silence_samples + nbits * (AUDIO_SAMPLE_RATE / BAUD_RATE), iq_sf);
+}
+
+size_t Modulator::begin_packet(const char *callsign, const char *dest, const char *path, const char *info,
+                               OutputFormat iq_sf)
+{
+    pull_fmt = iq_sf;
+    pull_offset = 0;
+    pending_size = 0;
+
+    if (iq_sf == PCM_F32)
+    {
+        // plain audio, nothing worth caching
+        audio.assign(silence_samples, 0.0f);
+        AfskState afsk;
+        bool level;
+        {
+            FRANC_TIMED(STAGE_AX25_FRAME);
+            level = ax25preamble_nrzi(bits, preamble_flags);
+        }
+        {
+            FRANC_TIMED(STAGE_AFSK);
+            afsk_append(bits, audio, afsk, mod_backend);
+        }
+        {
+            FRANC_TIMED(STAGE_AX25_FRAME);
+            ax25payload_nrzi(callsign, dest, path, info, bits, level);
+        }
+        {
+            FRANC_TIMED(STAGE_AFSK);
+            afsk_append(bits, audio, afsk, mod_backend);
+        }
+        audio.resize(audio.size() + silence_samples, 0.0f);
+        stage = PULL_PCM;
+        return audio.size() * sizeof(float);
+    }
+
+    const PrefixCache &c = prefix_for(iq_sf);
+
+    // restore the pipeline exactly as it was at the end of the preamble
+    mod_buf.consumerClear();
+    mod_buf.writeBuff(c.history.data(), c.history.size());
+    iq_resampler.restore(c.resampler_state);
+    cic.set_state(c.cic_state);
+    fm_phase = c.fm_phase;
+    AfskState afsk = c.afsk;
+
+    {
+        FRANC_TIMED(STAGE_AX25_FRAME);
+        ax25payload_nrzi(callsign, dest, path, info, bits, c.nrzi_level);
+    }
+    audio.clear();
+    {
+        FRANC_TIMED(STAGE_AFSK);
+        afsk_append(bits, audio, afsk, mod_backend);
+    }
+    audio.resize(audio.size() + silence_samples, 0.0f);
+
+    pull_prefix = &c;
+    stage = PULL_PREFIX;
+    return output_size(c.audio_samples + audio.size(), iq_sf);
+}
+
+bool Modulator::next_chunk(const void *&data, size_t &size)
+{
+    switch (stage)
+    {
+    case PULL_PCM:
+        stage = PULL_IDLE;
+        data = audio.data();
+        size = audio.size() * sizeof(float);
+        return size > 0;
+    case PULL_PREFIX:
+        stage = PULL_PAYLOAD;
+        if (!pull_prefix->samples.empty())
+        {
+            data = pull_prefix->samples.data();
+            size = pull_prefix->samples.size();
+            return true;
+        }
+        // fall through
+    case PULL_PAYLOAD:
+        if (feed_block(audio.data(), audio.size(), pull_offset, pull_fmt, data, size))
+        {
+            return true;
+        }
+        stage = PULL_IDLE;
+        return false;
+    default:
+        return false;
+    }
+}
+
+size_t Modulator::read_packet(void *out, size_t capacity)
+{
+    uint8_t *dst = static_cast<uint8_t *>(out);
+    size_t copied = 0;
+    while (copied < capacity)
+    {
+        if (pending_size == 0)
+        {
+            const void *data;
+            if (!next_chunk(data, pending_size))
+            {
+                break;
+            }
+            pending = static_cast<const uint8_t *>(data);
+        }
+        size_t n = std::min(capacity - copied, pending_size);
+        std::memcpy(dst + copied, pending, n);
+        copied += n;
+        pending += n;
+        pending_size -= n;
+    }
+    return copied;
+}
+
+void Modulator::modulate_packet(const char *callsign, const char *dest, const char *path, const char *info,
+                                const IQWriter &write, OutputFormat iq_sf)
+{
+    FRANC_TIMED(STAGE_MODULATE);
+    begin_packet(callsign, dest, path, info, iq_sf);
+    const void *data;
+    size_t size;
+    while (next_chunk(data, size))
+    {
+        write(data, size);
+    }
+}
+
+void Modulator::modulate_packet(const char *callsign, const char *dest, const char *path, const char *info,
+                                IQStream &stream)
+{
+    modulate_packet(callsign, dest, path, info, [&stream](const void *data, size_t size)
+                    { stream.write(static_cast<const int8_t *>(data), size); }, IQ_S8);
+    stream.close();
+}
+
+Modulator &default_modulator()
+{
+    static thread_local Modulator modulator;
+    return modulator;
+}
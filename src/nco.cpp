@@ -0,0 +1,16 @@
+#include "nco.h"
+
+#include <vector>
+
+const float *nco_sin_table()
+{
+    static const std::vector<float> table = []()
+    {
+        std::vector<float> t(NCO_LUT_SIZE + NCO_LUT_SIZE / 4);
+        for (int i = 0; i < (int)t.size(); i++) {
+            t[i] = sin(2 * M_PI * i / NCO_LUT_SIZE);
+        }
+        return t;
+    }();
+    return table.data();
+}
@@ -0,0 +1,250 @@
+#include "pipeline.h"
+#include "instrument.h"
+
+#include <algorithm>
+
+BeaconPipeline::BeaconPipeline(quill::Logger *logger, const Config &config, TelemetryReader &telemetry,
+                               Modulator &modulator, HackRfTransmitter &transmitter, PacketEncoder encoder)
+    : logger(logger),
+      telemetry(telemetry),
+      modulator(modulator),
+      transmitter(transmitter),
+      tx(logger, transmitter, config.tx_idle_ms),
+      encoder(encoder),
+      interval(std::chrono::milliseconds(std::max(1, config.beacon_interval_ms))),
+      lead(std::chrono::milliseconds(std::max(0, config.encode_lead_ms))),
+      running(false)
+{
+    // lead can't usefully exceed one slot
+    lead = std::min(lead, interval);
+}
+
+BeaconPipeline::~BeaconPipeline()
+{
+    stop();
+}
+
+// ---------------------------------------------------------------------
+// Control
+// ---------------------------------------------------------------------
+void BeaconPipeline::start()
+{
+    if (running.exchange(true))
+    {
+        return;
+    }
+
+    samples.consumerClear();
+    ready.consumerClear();
+    free_bursts.consumerClear();
+    for (auto &burst : pool)
+    {
+        free_bursts.insert(&burst);
+    }
+
+    // first acquisition right away, first slot one lead later
+    epoch = PipelineClock::now() + lead;
+
+    acquire_thread = std::thread(&BeaconPipeline::acquire_loop, this);
+    encode_thread = std::thread(&BeaconPipeline::encode_loop, this);
+    transmit_thread = std::thread(&BeaconPipeline::transmit_loop, this);
+    LOG_INFO(logger, "Beacon pipeline started: {} ms interval, {} ms encode lead",
+             std::chrono::duration_cast<std::chrono::milliseconds>(interval).count(),
+             std::chrono::duration_cast<std::chrono::milliseconds>(lead).count());
+}
+
+void BeaconPipeline::stop()
+{
+    running.store(false);
+    for (std::thread *t : {&acquire_thread, &encode_thread, &transmit_thread})
+    {
+        if (t->joinable())
+        {
+            t->join();
+        }
+    }
+}
+
+void BeaconPipeline::run()
+{
+    start();
+    while (running.load())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    stop();
+}
+
+// Sleeps in short steps so stop() is noticed; returns false once stopped.
+bool BeaconPipeline::sleep_until(PipelineClock::time_point when)
+{
+    const auto step = std::chrono::milliseconds(100);
+    while (running.load())
+    {
+        auto now = PipelineClock::now();
+        if (now >= when)
+        {
+            return true;
+        }
+        std::this_thread::sleep_for(std::min<PipelineClock::duration>(when - now, step));
+    }
+    return false;
+}
+
+// Index of the first slot that starts at or after `t`.
+static int64_t slot_at_or_after(PipelineClock::time_point epoch, PipelineClock::duration interval,
+                                PipelineClock::time_point t)
+{
+    if (t <= epoch)
+    {
+        return 0;
+    }
+    return (t - epoch + interval - PipelineClock::duration(1)) / interval;
+}
+
+// ---------------------------------------------------------------------
+// Stage 1: serial acquisition, one poll per slot, `lead` ahead of it
+// ---------------------------------------------------------------------
+void BeaconPipeline::acquire_loop()
+{
+    int64_t slot = 0;
+    while (sleep_until(epoch + slot * interval - lead))
+    {
+        TelemetrySample sample;
+        sample.valid = telemetry.poll(sample.data);
+        sample.acquired = PipelineClock::now();
+
+        if (!samples.insert(sample))
+        {
+            // encoder is stuck with the ring full; this sample is dropped,
+            // the queued (older) ones stay for when it comes back
+            dropped_samples.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // a slow poll skips slots instead of drifting
+        slot = std::max(slot + 1, slot_at_or_after(epoch, interval, PipelineClock::now() + lead));
+    }
+}
+
+// ---------------------------------------------------------------------
+// Stage 2: packet encode + modulate into a pooled burst
+// ---------------------------------------------------------------------
+void BeaconPipeline::encode_loop()
+{
+    while (running.load())
+    {
+        if (samples.isEmpty())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        // coalesce: only the newest queued sample is worth encoding
+        TelemetrySample sample;
+        size_t taken = 0;
+        while (samples.remove(sample))
+        {
+            taken++;
+        }
+        coalesced_samples.fetch_add(taken - 1, std::memory_order_relaxed);
+
+        Burst *burst = nullptr;
+        while (!free_bursts.remove(burst))
+        {
+            if (!running.load())
+            {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        burst->iq.clear();
+        burst->acquired = sample.acquired;
+        encoder(sample, modulator, [burst](const void *data, size_t size)
+                {
+                    const int8_t *p = static_cast<const int8_t *>(data);
+                    burst->iq.insert(burst->iq.end(), p, p + size); });
+
+        // the pool is smaller than the ring, so this can't fail
+        ready.insert(burst);
+    }
+}
+
+// ---------------------------------------------------------------------
+// Stage 3: TX scheduler
+// ---------------------------------------------------------------------
+void BeaconPipeline::release(Burst *burst)
+{
+    free_bursts.insert(burst);
+}
+
+void BeaconPipeline::transmit_loop()
+{
+    int64_t slot = 0;
+    while (sleep_until(epoch + slot * interval))
+    {
+        // newest ready burst wins, older ones go back to the pool
+        Burst *burst = nullptr;
+        Burst *next = nullptr;
+        while (ready.remove(next))
+        {
+            if (burst)
+            {
+                release(burst);
+                stale_bursts.fetch_add(1, std::memory_order_relaxed);
+            }
+            burst = next;
+        }
+
+        auto now = PipelineClock::now();
+        if (burst && now - burst->acquired > 2 * interval)
+        {
+            release(burst);
+            stale_bursts.fetch_add(1, std::memory_order_relaxed);
+            burst = nullptr;
+        }
+
+        if (!burst)
+        {
+            LOG_DEBUG(logger, "Beacon slot {}: no packet ready", slot);
+            missed_slots.fetch_add(1, std::memory_order_relaxed);
+            slot++;
+            continue;
+        }
+
+        LOG_INFO(logger, "===========================");
+        LOG_INFO(logger, "Beacon slot {}: transmitting {} bytes", slot, burst->iq.size());
+        // the queue keeps its own copy, the burst can be reused right away
+        uint64_t ticket = tx.submit(burst->iq.data(), burst->iq.size());
+        release(burst);
+        if (tx.wait(ticket))
+        {
+            sent.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            LOG_CRITICAL(logger, "Transmission failed");
+            failed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // slots that passed while we were on air are skipped, not queued
+        int64_t next_slot = slot_at_or_after(epoch, interval, PipelineClock::now());
+        next_slot = std::max(slot + 1, next_slot);
+        missed_slots.fetch_add(next_slot - slot - 1, std::memory_order_relaxed);
+        slot = next_slot;
+
+        if ((sent + failed) % 10 == 0)
+        {
+            log_stats();
+        }
+    }
+}
+
+void BeaconPipeline::log_stats()
+{
+    LOG_INFO(logger, "Pipeline: {} sent, {} failed, {} slots missed, {} samples dropped, "
+                     "{} coalesced, {} stale bursts, {} TX sessions",
+             sent.load(), failed.load(), missed_slots.load(), dropped_samples.load(),
+             coalesced_samples.load(), stale_bursts.load(), tx.sessions());
+    FRANC_INSTRUMENT_REPORT(logger);
+}
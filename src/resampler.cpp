@@ -0,0 +1,328 @@
+#include "resampler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <tuple>
+
+// the original x50 design, as fractions of the first stage's input rate:
+// the AFSK baseband is passed up to 0.4, everything from 0.5 on is stopped
+static const float FIRST_PASSBAND = 0.4f;
+static const float FIRST_STOPBAND = 0.5f;
+
+// complex samples copied per output of an intermediate stage (into its ring,
+// then into the next stage's window), in MAC equivalents for the cost model
+static const double STAGE_HOP_COST = 2.0;
+
+// share of the image-free gap the later stages use as their transition band
+static const double STAGE_TRANSITION_MARGIN = 0.7;
+
+int ResamplerPlan::interpolation() const
+{
+    int l = 1;
+    for (const ResamplerStage &s : stages) {
+        l *= s.interpolation;
+    }
+    return l;
+}
+
+int ResamplerPlan::decimation() const
+{
+    int m = 1;
+    for (const ResamplerStage &s : stages) {
+        m *= s.decimation;
+    }
+    return m;
+}
+
+// passband and stopband edge of stage s, relative to its input rate fin
+static void stage_band(const ResamplerPlan &plan, size_t s, double fin, double fout, float &passband,
+                       float &stopband)
+{
+    if (s == 0) {
+        passband = FIRST_PASSBAND;
+        stopband = FIRST_STOPBAND;
+        return;
+    }
+    // the signal is already band limited: only the images at multiples of
+    // fin (and aliases around fout when decimating) have to go
+    double fp = FIRST_PASSBAND * plan.input_rate;
+    double edge = std::min(fin, fout) - fp;
+    // lowpass() sizes the filter for a sharper edge than the Kaiser window
+    // really gives; with these wide bands that leaves the image of DC at fin
+    // only ~40 dB down, so keep the nominal transition well inside the gap
+    double mid = (fp + edge) / 2;
+    double half = (edge - fp) / 2 * STAGE_TRANSITION_MARGIN;
+    passband = (float)((mid - half) / fin);
+    stopband = (float)((mid + half) / fin);
+}
+
+// same arithmetic as modulator_taps(), so a single x50 stage keeps its taps bit for bit
+static void stage_design(int interpolation, float passband, float stopband, float &factor, float &mid_transition_band,
+                         float &trans_width)
+{
+    factor = interpolation;
+    trans_width = stopband - passband;
+    mid_transition_band = stopband - trans_width / 2.0;
+}
+
+static const std::vector<float> &stage_taps(int interpolation, float passband, float stopband)
+{
+    // designs are shared by every Resampler (and thread) in the process
+    static std::mutex lock;
+    static std::map<std::tuple<int, float, float>, std::vector<float>> designs;
+
+    std::lock_guard<std::mutex> guard(lock);
+    auto key = std::make_tuple(interpolation, passband, stopband);
+    auto found = designs.find(key);
+    if (found == designs.end()) {
+        float factor, mid_transition_band, trans_width;
+        stage_design(interpolation, passband, stopband, factor, mid_transition_band, trans_width);
+        found = designs.emplace(key, lowpass(factor, factor, mid_transition_band, trans_width)).first;
+    }
+    return found->second;
+}
+
+// what the stages cost with the padded branch length the kernels really run
+static double plan_cost(const ResamplerPlan &plan)
+{
+    double cost = 0;
+    double fin = plan.input_rate;
+    for (size_t s = 0; s < plan.stages.size(); s++) {
+        const ResamplerStage &st = plan.stages[s];
+        double fout = fin * st.interpolation / st.decimation;
+        float passband, stopband, factor, mid_transition_band, trans_width;
+        stage_band(plan, s, fin, fout, passband, stopband);
+        stage_design(st.interpolation, passband, stopband, factor, mid_transition_band, trans_width);
+
+        int ntaps = lowpass_ntaps(factor, trans_width);
+        int per_branch = (ntaps + st.interpolation - 1) / st.interpolation;
+        int padded = (2 * per_branch + FIR_TAP_ALIGN - 1) / FIR_TAP_ALIGN * FIR_TAP_ALIGN / 2;
+        cost += fout * padded;
+        if (s + 1 < plan.stages.size()) {
+            cost += fout * STAGE_HOP_COST;
+        }
+        fin = fout;
+    }
+    return cost;
+}
+
+// every ordered split of l into at most depth factors >= 2, the last one decimating by m
+static void search(ResamplerPlan &candidate, int l, int m, int depth, ResamplerPlan &best)
+{
+    if (l >= m) {
+        candidate.stages.push_back({l, m});
+        double cost = plan_cost(candidate);
+        if (!best.valid() || cost < best.cost) {
+            best.stages = candidate.stages;
+            best.cost = cost;
+        }
+        candidate.stages.pop_back();
+    }
+    if (depth <= 1) {
+        return;
+    }
+    for (int f = 2; f < l; f++) {
+        if (l % f == 0) {
+            candidate.stages.push_back({f, 1});
+            search(candidate, l / f, m, depth - 1, best);
+            candidate.stages.pop_back();
+        }
+    }
+}
+
+ResamplerPlan plan_resampler(int input_rate, double output_rate, int max_stages)
+{
+    ResamplerPlan best;
+    best.input_rate = input_rate;
+    if (input_rate <= 0 || !(output_rate > input_rate)) {
+        return best;
+    }
+
+    long long out = std::llround(output_rate);
+    long long g = std::gcd(out, (long long)input_rate);
+    long long l = out / g, m = input_rate / g;
+    if (l > RESAMPLER_MAX_INTERPOLATION) {
+        // closest ratio with a small decimation, a few ppm off at most
+        double ratio = output_rate / input_rate, error = HUGE_VAL;
+        for (long long d = 1; d <= RESAMPLER_MAX_DECIMATION; d++) {
+            long long n = std::llround(ratio * d);
+            if (n > d && n <= RESAMPLER_MAX_INTERPOLATION && std::fabs((double)n / d - ratio) < error) {
+                error = std::fabs((double)n / d - ratio);
+                l = n;
+                m = d;
+            }
+        }
+        if (error == HUGE_VAL) {
+            return best;
+        }
+        g = std::gcd(l, m);
+        l /= g;
+        m /= g;
+    }
+
+    ResamplerPlan candidate = best;
+    search(candidate, (int)l, (int)m, std::max(1, max_stages), best);
+    best.output_rate = (double)input_rate * l / m;
+    return best;
+}
+
+std::string resampler_plan_string(const ResamplerPlan &plan)
+{
+    if (!plan.valid()) {
+        return "none";
+    }
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%d -> %.0f S/s:", plan.input_rate, plan.output_rate);
+    std::string s = buf;
+    for (size_t i = 0; i < plan.stages.size(); i++) {
+        const ResamplerStage &st = plan.stages[i];
+        if (st.decimation > 1) {
+            std::snprintf(buf, sizeof(buf), "%s x%d/%d", i ? "," : "", st.interpolation, st.decimation);
+        } else {
+            std::snprintf(buf, sizeof(buf), "%s x%d", i ? "," : "", st.interpolation);
+        }
+        s += buf;
+    }
+    std::snprintf(buf, sizeof(buf), " (%.1f MMAC/s)", plan.cost / 1e6);
+    return s + buf;
+}
+
+Resampler::Resampler(const ResamplerPlan &plan)
+    : resampler_plan(plan)
+{
+    assert(plan.valid());
+    double fin = plan.input_rate;
+    for (size_t s = 0; s < plan.stages.size(); s++) {
+        const ResamplerStage &st = plan.stages[s];
+        double fout = fin * st.interpolation / st.decimation;
+        float passband, stopband;
+        stage_band(plan, s, fin, fout, passband, stopband);
+        stages.emplace_back(new FIRInterpolator(st.interpolation, stage_taps(st.interpolation, passband, stopband),
+                                                st.decimation));
+        if (s + 1 < plan.stages.size()) {
+            rings.emplace_back(new Ringbuffer_t());
+        }
+        fin = fout;
+    }
+    if (!rings.empty()) {
+        scratch.resize(BUFSIZE * 2);
+    }
+}
+
+Ringbuffer_t &Resampler::last_input(Ringbuffer_t &input)
+{
+    return rings.empty() ? input : *rings.back();
+}
+
+bool Resampler::pump(Ringbuffer_t &input)
+{
+    bool moved = false;
+    for (size_t s = 0; s < rings.size(); s++) {
+        Ringbuffer_t &in = s == 0 ? input : *rings[s - 1];
+        Ringbuffer_t &out = *rings[s];
+        size_t room = std::min(out.writeAvailable(), scratch.size());
+        if (room == 0) {
+            continue;
+        }
+        size_t produced;
+        int processed = stages[s]->resample(in, scratch.data(), room, produced);
+        in.remove(processed);
+        out.writeBuff(scratch.data(), produced);
+        moved |= processed > 0;
+    }
+    return moved;
+}
+
+size_t Resampler::process(Ringbuffer_t &input, std::complex<float> *output, size_t capacity)
+{
+    FIRInterpolator &last = *stages.back();
+    Ringbuffer_t &in = last_input(input);
+    while (true) {
+        bool moved = pump(input);
+        size_t produced;
+        int processed = last.resample(in, output, capacity, produced);
+        in.remove(processed);
+        if (produced > 0 || (processed == 0 && !moved)) {
+            return produced;
+        }
+    }
+}
+
+size_t Resampler::process(Ringbuffer_t &input, int8_t *output, size_t capacity, float scale)
+{
+    FIRInterpolator &last = *stages.back();
+    Ringbuffer_t &in = last_input(input);
+    while (true) {
+        bool moved = pump(input);
+        size_t produced;
+        int processed = last.resample(in, output, capacity, scale, produced);
+        in.remove(processed);
+        if (produced > 0 || (processed == 0 && !moved)) {
+            return produced;
+        }
+    }
+}
+
+void Resampler::reset()
+{
+    for (auto &ring : rings) {
+        ring->consumerClear();
+    }
+    for (auto &stage : stages) {
+        stage->set_phase(0);
+    }
+}
+
+void Resampler::save(State &state) const
+{
+    state.rings.resize(rings.size());
+    for (size_t s = 0; s < rings.size(); s++) {
+        Ringbuffer_t::Span first, second;
+        rings[s]->readSpans(first, second);
+        state.rings[s].assign(first.data, first.data + first.size);
+        state.rings[s].insert(state.rings[s].end(), second.data, second.data + second.size);
+    }
+    state.phases.resize(stages.size());
+    for (size_t s = 0; s < stages.size(); s++) {
+        state.phases[s] = stages[s]->phase();
+    }
+}
+
+void Resampler::restore(const State &state)
+{
+    for (size_t s = 0; s < rings.size(); s++) {
+        rings[s]->consumerClear();
+        rings[s]->writeBuff(state.rings[s].data(), state.rings[s].size());
+    }
+    for (size_t s = 0; s < stages.size(); s++) {
+        stages[s]->set_phase(state.phases[s]);
+    }
+}
+
+size_t Resampler::output_count(size_t input_samples) const
+{
+    // every stage keeps taps_per_branch - 1 samples of history it never emits
+    size_t count = input_samples;
+    for (size_t s = 0; s < stages.size(); s++) {
+        size_t history = stages[s]->taps_per_branch() - 1;
+        size_t processed = count > history ? count - history : 0;
+        count = stages[s]->output_count(processed);
+    }
+    return count;
+}
+
+size_t Resampler::block_size() const
+{
+    const FIRInterpolator &last = *stages.back();
+    return (size_t)BUFSIZE * 2 * ((last.interpolation() + last.decimation() - 1) / last.decimation());
+}
+
+size_t Resampler::period() const
+{
+    return resampler_plan.interpolation();
+}
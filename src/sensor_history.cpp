@@ -0,0 +1,269 @@
+#include "sensor_history.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+
+// SENSOR_FIELDS row of every stored column, -1 for the derived ones
+struct ColumnMap
+{
+    int field[SENSOR_FIELD_COUNT]; // column of each row, -1 for the timestamp
+    int timestamp_row;
+
+    ColumnMap() : timestamp_row(-1)
+    {
+        int next = 0;
+        for (size_t i = 0; i < SENSOR_FIELD_COUNT; i++)
+        {
+            if (std::strcmp(SENSOR_FIELDS[i].name, "timestamp") == 0)
+            {
+                field[i] = -1;
+                timestamp_row = (int)i;
+            }
+            else
+            {
+                field[i] = next++;
+            }
+        }
+    }
+};
+
+const ColumnMap &column_map()
+{
+    static const ColumnMap map;
+    return map;
+}
+
+float field_value(const MasterSensorData &data, const SensorField &field)
+{
+    const char *p = reinterpret_cast<const char *>(&data) + field.offset;
+    switch (field.type)
+    {
+    case FIELD_INT:
+        return (float)*reinterpret_cast<const int *>(p);
+    case FIELD_FLOAT:
+        return *reinterpret_cast<const float *>(p);
+    case FIELD_U8:
+        return (float)*reinterpret_cast<const uint8_t *>(p);
+    case FIELD_ULONG:
+        return (float)*reinterpret_cast<const unsigned long *>(p);
+    }
+    return 0.0f;
+}
+
+// one AVX register of floats; every lane is reduced on its own and the
+// lanes are combined at the end, so the loop has no serial dependency
+const int LANES = 8;
+
+struct Accumulator
+{
+    float lo[LANES];
+    float hi[LANES];
+    double n[LANES];
+    double sv[LANES];  // sum v
+    double st[LANES];  // sum t
+    double stt[LANES]; // sum t * t
+    double stv[LANES]; // sum t * v
+
+    Accumulator()
+    {
+        std::fill(lo, lo + LANES, std::numeric_limits<float>::infinity());
+        std::fill(hi, hi + LANES, -std::numeric_limits<float>::infinity());
+        std::fill(n, n + LANES, 0.0);
+        std::fill(sv, sv + LANES, 0.0);
+        std::fill(st, st + LANES, 0.0);
+        std::fill(stt, stt + LANES, 0.0);
+        std::fill(stv, stv + LANES, 0.0);
+    }
+
+    // NaN compares false everywhere, so it leaves min/max alone and is masked out of the sums
+    void add(int lane, float v, double t)
+    {
+        bool valid = v == v;
+        lo[lane] = v < lo[lane] ? v : lo[lane];
+        hi[lane] = v > hi[lane] ? v : hi[lane];
+        double w = valid ? 1.0 : 0.0;
+        double x = valid ? (double)v : 0.0;
+        n[lane] += w;
+        sv[lane] += x;
+        st[lane] += w * t;
+        stt[lane] += w * t * t;
+        stv[lane] += t * x;
+    }
+
+    // values[i] taken at times[i] - t0 ms
+    void run(const float *values, const unsigned long *times, size_t size, unsigned long t0)
+    {
+        size_t i = 0;
+        for (; i + LANES <= size; i += LANES)
+        {
+            for (int l = 0; l < LANES; l++)
+            {
+                add(l, values[i + l], (double)(times[i + l] - t0) * 1e-3);
+            }
+        }
+        for (int l = 0; i < size; i++, l++)
+        {
+            add(l, values[i], (double)(times[i] - t0) * 1e-3);
+        }
+    }
+
+    SensorStats result() const
+    {
+        float min = lo[0], max = hi[0];
+        double N = n[0], SV = sv[0], ST = st[0], STT = stt[0], STV = stv[0];
+        for (int l = 1; l < LANES; l++)
+        {
+            min = std::min(min, lo[l]);
+            max = std::max(max, hi[l]);
+            N += n[l];
+            SV += sv[l];
+            ST += st[l];
+            STT += stt[l];
+            STV += stv[l];
+        }
+
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        SensorStats stats;
+        stats.count = (size_t)N;
+        stats.min = N > 0 ? min : nan;
+        stats.max = N > 0 ? max : nan;
+        stats.mean = N > 0 ? (float)(SV / N) : nan;
+        double spread = N * STT - ST * ST; // 0 if every reading has the same time
+        stats.slope = N > 1 && spread > 0 ? (float)((N * STV - ST * SV) / spread) : nan;
+        return stats;
+    }
+};
+
+} // namespace
+
+SensorHistory::SensorHistory(size_t capacity)
+    : mask(1), head(0), count(0)
+{
+    size_t rounded = 1;
+    while (rounded < std::max<size_t>(capacity, 2))
+    {
+        rounded <<= 1;
+    }
+    mask = rounded - 1;
+    timestamps.assign(rounded, 0);
+    columns.assign(COLUMN_COUNT * rounded, 0.0f);
+}
+
+void SensorHistory::clear()
+{
+    head = 0;
+    count = 0;
+}
+
+int SensorHistory::column(const char *name)
+{
+    const SensorField *field = sensor_field_find(name, std::strlen(name));
+    if (field)
+    {
+        return column_map().field[field - SENSOR_FIELDS];
+    }
+    for (size_t d = 0; d < SENSOR_DERIVED_COUNT; d++)
+    {
+        if (std::strcmp(name, SENSOR_DERIVED_COLUMNS[d]) == 0)
+        {
+            return (int)(SENSOR_FIELD_COUNT - 1 + d);
+        }
+    }
+    return -1;
+}
+
+bool SensorHistory::append(const MasterSensorData &data)
+{
+    if (count > 0)
+    {
+        unsigned long newest = timestamps[(head - 1) & mask];
+        if (data.timestamp == newest)
+        {
+            return false;
+        }
+        if (data.timestamp < newest)
+        {
+            clear();
+        }
+    }
+
+    const size_t size = capacity();
+    const size_t at = head;
+    float *base = columns.data() + at;
+    const ColumnMap &map = column_map();
+    for (size_t i = 0; i < SENSOR_FIELD_COUNT; i++)
+    {
+        if (map.field[i] >= 0)
+        {
+            base[(size_t)map.field[i] * size] = field_value(data, SENSOR_FIELDS[i]);
+        }
+    }
+    float *derived = base + (SENSOR_FIELD_COUNT - 1) * size;
+    derived[0] = std::sqrt(data.lsm_accel_x * data.lsm_accel_x + data.lsm_accel_y * data.lsm_accel_y +
+                           data.lsm_accel_z * data.lsm_accel_z);
+    derived[size] = std::sqrt(data.bno_linear_accel_x * data.bno_linear_accel_x +
+                              data.bno_linear_accel_y * data.bno_linear_accel_y +
+                              data.bno_linear_accel_z * data.bno_linear_accel_z);
+    static_assert(SENSOR_DERIVED_COUNT == 2, "one line above per derived column");
+
+    timestamps[at] = data.timestamp;
+    head = (head + 1) & mask;
+    count = std::min(count + 1, size);
+    return true;
+}
+
+unsigned long SensorHistory::timestamp(size_t age) const
+{
+    return timestamps[slot(count - 1 - age)];
+}
+
+float SensorHistory::value(int column, size_t age) const
+{
+    return columns[(size_t)column * capacity() + slot(count - 1 - age)];
+}
+
+size_t SensorHistory::lower_bound(unsigned long t) const
+{
+    size_t lo = 0, hi = count;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (timestamps[slot(mid)] < t)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+SensorStats SensorHistory::stats(int column, unsigned long span_ms) const
+{
+    Accumulator acc;
+    if (column < 0 || (size_t)column >= COLUMN_COUNT || count == 0)
+    {
+        return acc.result();
+    }
+
+    unsigned long newest = timestamp();
+    unsigned long since = newest > span_ms ? newest - span_ms : 0;
+    size_t first = lower_bound(since);
+
+    // the window is [first, count) from the oldest sample, as one or two runs of the ring
+    const float *values = columns.data() + (size_t)column * capacity();
+    size_t start = slot(first);
+    size_t n = count - first;
+    size_t run = std::min(n, capacity() - start);
+    unsigned long t0 = timestamps[start];
+    acc.run(values + start, timestamps.data() + start, run, t0);
+    acc.run(values, timestamps.data(), n - run, t0);
+    return acc.result();
+}
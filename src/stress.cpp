@@ -0,0 +1,188 @@
+#include "stress.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <complex>
+#include <cstdio>
+#include <fcntl.h>
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "ax25.h"
+#include "dsp.h"
+#include "modulator.h"
+
+namespace
+{
+
+typedef std::chrono::steady_clock StressClock;
+
+// info fields of the synthetic packets, from a short status to a long
+// comment; a sequence number keeps every frame different
+const char *const STRESS_MESSAGES[] = {
+    ">FRANC stress %u",
+    "!4903.50N/07201.75W-FRANC stress %u",
+    ">FRANC stress %u: Temp 21.4C Press 1013.2hPa Hum 41.2%%RH Alt 123m AccZ 9.8m/s2 SysCal 3",
+};
+const int STRESS_MESSAGE_COUNT = sizeof(STRESS_MESSAGES) / sizeof(STRESS_MESSAGES[0]);
+const size_t STRESS_INFO_MAX = 128;
+
+struct WorkerResult
+{
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    std::vector<uint32_t> latency_ns;
+    bool pinned = false;
+};
+
+bool pin_to_core(std::thread &thread, unsigned core)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+}
+
+double percentile_ms(const std::vector<uint32_t> &sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0.0;
+    }
+    size_t index = std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5));
+    return sorted[index] / 1e6;
+}
+
+} // namespace
+
+int run_stress(quill::Logger *logger, const Config &config)
+{
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned max_threads = config.stress_threads > 0 ? (unsigned)config.stress_threads : cores;
+    const double seconds = config.stress_seconds > 0 ? config.stress_seconds : STRESS_SECONDS;
+    const OutputFormat iq_sf = config.iq_sf;
+
+    int devnull = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (devnull < 0)
+    {
+        LOG_ERROR(logger, "Stress: cannot open /dev/null");
+        return 1;
+    }
+
+    // one modulator per thread, built before any timing starts
+    std::vector<std::unique_ptr<Modulator>> modulators;
+    for (unsigned t = 0; t < max_threads; t++)
+    {
+        modulators.emplace_back(new Modulator(config.modulator, config.preamble_flags, config.silence_ms,
+                                              config.sampleRate, config.resampler_stages, config.chain));
+    }
+    const size_t frame = iq_sf == IQ_S8 ? 2 : iq_sf == IQ_F32 ? sizeof(std::complex<float>) : sizeof(float);
+    const double rate = iq_sf == PCM_F32 ? (double)AUDIO_SAMPLE_RATE : modulators[0]->sample_rate();
+
+    LOG_INFO(logger, "Stress: up to {} threads on {} cores, {:.1f} s each, {:.0f} S/s {}", max_threads, cores,
+             seconds, rate, iq_sf == IQ_S8 ? "IQ_S8" : iq_sf == IQ_F32 ? "IQ_F32" : "PCM_F32");
+
+    std::vector<unsigned> counts;
+    for (unsigned n = 1; n < max_threads; n *= 2)
+    {
+        counts.push_back(n);
+    }
+    counts.push_back(max_threads);
+
+    double single_msps = 0.0;
+    for (unsigned nthreads : counts)
+    {
+        std::vector<WorkerResult> results(nthreads);
+        std::atomic<unsigned> ready{0};
+        std::atomic<bool> go{false};
+        std::atomic<bool> stop{false};
+
+        auto work = [&](unsigned t)
+        {
+            Modulator &modulator = *modulators[t];
+            WorkerResult &result = results[t];
+            result.latency_ns.reserve((size_t)(seconds * 1000));
+            IQWriter write = [&result, devnull](const void *data, size_t size)
+            {
+                ssize_t n = ::write(devnull, data, size);
+                (void)n;
+                result.bytes += size;
+            };
+            PackedBits bits;
+            char info[STRESS_INFO_MAX];
+
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            for (unsigned seq = 0; !stop.load(std::memory_order_relaxed); seq++)
+            {
+                std::snprintf(info, sizeof(info), STRESS_MESSAGES[seq % STRESS_MESSAGE_COUNT], seq);
+                StressClock::time_point start = StressClock::now();
+                ax25frame_nrzi(config.callsign.c_str(), config.dest.c_str(), config.path.c_str(), info, bits,
+                               config.preamble_flags);
+                std::vector<float> wave = config.modulator == MOD_NCO ? afsk_nco(bits) : afsk(bits);
+                modulator.modulate(wave, write, iq_sf);
+                result.latency_ns.push_back(
+                    (uint32_t)std::min<int64_t>(UINT32_MAX, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                                StressClock::now() - start)
+                                                                .count()));
+                result.packets++;
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(nthreads);
+        for (unsigned t = 0; t < nthreads; t++)
+        {
+            threads.emplace_back(work, t);
+            results[t].pinned = pin_to_core(threads.back(), t % cores);
+        }
+        while (ready.load() < nthreads)
+        {
+            std::this_thread::yield();
+        }
+        StressClock::time_point start = StressClock::now();
+        go.store(true, std::memory_order_release);
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        stop.store(true);
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+        double wall = std::chrono::duration<double>(StressClock::now() - start).count();
+
+        uint64_t packets = 0, bytes = 0;
+        bool pinned = true;
+        std::vector<uint32_t> latency;
+        for (WorkerResult &result : results)
+        {
+            packets += result.packets;
+            bytes += result.bytes;
+            pinned = pinned && result.pinned;
+            latency.insert(latency.end(), result.latency_ns.begin(), result.latency_ns.end());
+        }
+        std::sort(latency.begin(), latency.end());
+
+        double msps = bytes / frame / wall / 1e6;
+        if (nthreads == 1)
+        {
+            single_msps = msps;
+        }
+        LOG_INFO(logger,
+                 "Stress: {} threads{}: {:.2f} MSPS, {:.1f} packets/s, x{:.1f} real time, "
+                 "latency p50/p90/p99/max {:.2f}/{:.2f}/{:.2f}/{:.2f} ms, efficiency {:.0f}%",
+                 nthreads, pinned ? "" : " (not pinned)", msps, packets / wall, msps * 1e6 / rate,
+                 percentile_ms(latency, 0.50), percentile_ms(latency, 0.90), percentile_ms(latency, 0.99),
+                 percentile_ms(latency, 1.0), single_msps > 0 ? 100.0 * msps / (nthreads * single_msps) : 0.0);
+    }
+
+    ::close(devnull);
+    return 0;
+}
@@ -0,0 +1,462 @@
+#include "telemetry.h"
+#include "sensor_fields.h"
+#include "instrument.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <limits>
+
+#ifdef FRANC_HAVE_FLATBUFFERS
+#include "sensors_generated.h"
+#endif
+
+// Zeroes `out` and marks every float reading missing (NaN), so a sensor
+// the message leaves out is told apart from one that reads 0.
+static void clear_sensor_data(MasterSensorData &out)
+{
+    std::memset(&out, 0, sizeof(out));
+    const float missing = std::numeric_limits<float>::quiet_NaN();
+    char *base = reinterpret_cast<char *>(&out);
+    for (const SensorField &field : SENSOR_FIELDS)
+    {
+        if (field.type == FIELD_FLOAT)
+        {
+            std::memcpy(base + field.offset, &missing, sizeof(missing));
+        }
+    }
+}
+
+// Stores a decoded number into the member described by `field`, converting
+// like nlohmann's j.value<T>() did (floats truncate into integer fields).
+static void store_field(MasterSensorData &out, const SensorField &field, double value, bool integral,
+                        long long ivalue)
+{
+    char *base = reinterpret_cast<char *>(&out);
+    switch (field.type)
+    {
+    case FIELD_ULONG:
+    {
+        unsigned long v = integral ? (unsigned long)ivalue : (unsigned long)value;
+        std::memcpy(base + field.offset, &v, sizeof(v));
+        break;
+    }
+    case FIELD_INT:
+    {
+        int v = integral ? (int)ivalue : (int)value;
+        std::memcpy(base + field.offset, &v, sizeof(v));
+        break;
+    }
+    case FIELD_FLOAT:
+    {
+        float v = integral ? (float)ivalue : (float)value;
+        std::memcpy(base + field.offset, &v, sizeof(v));
+        break;
+    }
+    case FIELD_U8:
+    {
+        uint8_t v = integral ? (uint8_t)ivalue : (uint8_t)value;
+        std::memcpy(base + field.offset, &v, sizeof(v));
+        break;
+    }
+    }
+}
+
+// ---------------------------------------------------------------------
+// JSON
+// ---------------------------------------------------------------------
+// Single pass over the text, no DOM and no allocation: every key is looked
+// up in SENSOR_FIELDS and its number written straight into the struct.
+// Unknown keys and non-numeric values (strings, arrays, objects) are skipped.
+
+namespace
+{
+struct JsonCursor
+{
+    const char *p;
+    const char *end;
+
+    bool done() const { return p >= end; }
+    char peek() const { return p < end ? *p : '\0'; }
+
+    void skip_ws()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        {
+            p++;
+        }
+    }
+
+    bool consume(char c)
+    {
+        skip_ws();
+        if (peek() != c)
+        {
+            return false;
+        }
+        p++;
+        return true;
+    }
+
+    // Raw contents between the quotes; escapes are skipped over, not decoded
+    // (no sensor key needs them).
+    bool string(const char *&s, size_t &len)
+    {
+        if (!consume('"'))
+        {
+            return false;
+        }
+        s = p;
+        while (p < end && *p != '"')
+        {
+            if (*p == '\\')
+            {
+                p++;
+            }
+            p++;
+        }
+        if (p >= end)
+        {
+            return false;
+        }
+        len = p - s;
+        p++;
+        return true;
+    }
+
+    bool literal(const char *word)
+    {
+        size_t n = std::strlen(word);
+        if ((size_t)(end - p) < n || std::memcmp(p, word, n) != 0)
+        {
+            return false;
+        }
+        p += n;
+        return true;
+    }
+
+    bool number(double &value, bool &integral, long long &ivalue)
+    {
+        // copy the token so strtod/strtoll never read past `end`
+        char token[64];
+        size_t n = 0;
+        integral = true;
+        while (p < end && n < sizeof(token) - 1)
+        {
+            char c = *p;
+            if (c == '.' || c == 'e' || c == 'E')
+            {
+                integral = false;
+            }
+            else if (!(c == '-' || c == '+' || (c >= '0' && c <= '9')))
+            {
+                break;
+            }
+            token[n++] = c;
+            p++;
+        }
+        token[n] = '\0';
+        if (n == 0)
+        {
+            return false;
+        }
+
+        char *stop = nullptr;
+        if (integral)
+        {
+            ivalue = std::strtoll(token, &stop, 10);
+            value = (double)ivalue;
+        }
+        else
+        {
+            value = std::strtod(token, &stop);
+        }
+        return stop == token + n;
+    }
+
+    // Skips any value, nested containers included.
+    bool skip_value()
+    {
+        skip_ws();
+        int depth = 0;
+        do
+        {
+            skip_ws();
+            char c = peek();
+            if (c == '"')
+            {
+                const char *s;
+                size_t len;
+                if (!string(s, len))
+                {
+                    return false;
+                }
+            }
+            else if (c == '{' || c == '[')
+            {
+                depth++;
+                p++;
+            }
+            else if (c == '}' || c == ']')
+            {
+                if (depth == 0)
+                {
+                    return false;
+                }
+                depth--;
+                p++;
+            }
+            else if (c == ',' || c == ':')
+            {
+                if (depth == 0)
+                {
+                    return false;
+                }
+                p++;
+            }
+            else if (c == 't' || c == 'f' || c == 'n')
+            {
+                if (!literal("true") && !literal("false") && !literal("null"))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                double d;
+                bool integral;
+                long long i;
+                if (!number(d, integral, i))
+                {
+                    return false;
+                }
+            }
+        } while (depth > 0);
+        return true;
+    }
+};
+} // namespace
+
+SensorJsonStatus sensor_data_from_json(const char *msg, size_t len, MasterSensorData &out, size_t *error_offset)
+{
+    clear_sensor_data(out);
+    JsonCursor cur{msg, msg + len};
+    bool have_timestamp = false;
+
+    bool ok = cur.consume('{');
+    if (ok && !cur.consume('}'))
+    {
+        do
+        {
+            const char *key;
+            size_t key_len;
+            if (!cur.string(key, key_len) || !cur.consume(':'))
+            {
+                ok = false;
+                break;
+            }
+
+            const SensorField *field = sensor_field_find(key, key_len);
+            cur.skip_ws();
+            char c = cur.peek();
+            if (field && (c == '-' || (c >= '0' && c <= '9')))
+            {
+                double value;
+                bool integral;
+                long long ivalue;
+                if (!cur.number(value, integral, ivalue))
+                {
+                    ok = false;
+                    break;
+                }
+                store_field(out, *field, value, integral, ivalue);
+                have_timestamp |= (field->table == FB_SENSOR_BATCH);
+            }
+            else if (field && (c == 't' || c == 'f') && (cur.literal("true") || cur.literal("false")))
+            {
+                store_field(out, *field, 0, true, c == 't' ? 1 : 0);
+                have_timestamp |= (field->table == FB_SENSOR_BATCH);
+            }
+            else if (!cur.skip_value())
+            {
+                ok = false;
+                break;
+            }
+        } while (cur.consume(','));
+        ok = ok && cur.consume('}');
+    }
+
+    cur.skip_ws();
+    if (!ok || !cur.done())
+    {
+        if (error_offset)
+        {
+            *error_offset = cur.p - msg;
+        }
+        return SENSOR_JSON_MALFORMED;
+    }
+    return have_timestamp ? SENSOR_JSON_OK : SENSOR_JSON_NOT_SENSOR;
+}
+
+// ---------------------------------------------------------------------
+// FlatBuffers
+// ---------------------------------------------------------------------
+#ifdef FRANC_HAVE_FLATBUFFERS
+
+// Reads every SENSOR_FIELDS row that belongs to `table` straight out of the
+// receive buffer, by vtable slot. The buffer has been verified already.
+static void read_table(const flatbuffers::Table *fb, SensorFieldTable table, MasterSensorData &out)
+{
+    for (const SensorField &field : SENSOR_FIELDS)
+    {
+        if (field.table != table)
+        {
+            continue;
+        }
+        flatbuffers::voffset_t slot = flatbuffers::FieldIndexToOffset(field.fb_index);
+        switch (field.type)
+        {
+        case FIELD_ULONG:
+            store_field(out, field, 0, true, (long long)fb->GetField<uint64_t>(slot, 0));
+            break;
+        case FIELD_INT:
+            store_field(out, field, 0, true, fb->GetField<int32_t>(slot, 0));
+            break;
+        case FIELD_FLOAT:
+            store_field(out, field, fb->GetField<float>(slot, 0.0f), false, 0);
+            break;
+        case FIELD_U8:
+            store_field(out, field, 0, true, (uint8_t)fb->GetField<int8_t>(slot, 0));
+            break;
+        }
+    }
+}
+
+bool sensor_data_from_batch(const uint8_t *buf, size_t len, MasterSensorData &out)
+{
+    flatbuffers::Verifier verifier(buf, len);
+    if (!SensorLog::VerifySizePrefixedSensorBatchBuffer(verifier))
+    {
+        return false;
+    }
+
+    const SensorLog::SensorBatch *batch = SensorLog::GetSizePrefixedSensorBatch(buf);
+    clear_sensor_data(out);
+    read_table(batch, FB_SENSOR_BATCH, out);
+
+    // Each message fills the block of its sensor. FlatBuffers leaves out
+    // fields equal to their default, so inside a block an absent float is
+    // 0; the floats of a sensor missing from the batch stay NaN. Unknown
+    // sensors from newer firmware are ignored.
+    auto messages = batch->messages();
+    if (messages)
+    {
+        for (auto msg : *messages)
+        {
+            auto table = static_cast<const flatbuffers::Table *>(msg->data());
+            if (table && msg->data_type() >= FB_BME688 && msg->data_type() <= FB_BNO055)
+            {
+                read_table(table, (SensorFieldTable)msg->data_type(), out);
+            }
+        }
+    }
+    return true;
+}
+
+bool sensor_batch_supported()
+{
+    return true;
+}
+
+#else
+
+bool sensor_data_from_batch(const uint8_t *, size_t, MasterSensorData &)
+{
+    return false;
+}
+
+bool sensor_batch_supported()
+{
+    return false;
+}
+
+#endif
+
+// ---------------------------------------------------------------------
+// TelemetryReader
+// ---------------------------------------------------------------------
+TelemetryReader::TelemetryReader(quill::Logger *logger, SerialLink &link)
+    : logger(logger), link(link), sink(nullptr)
+{
+    frame.reserve(LINK_FRAME_MAX + 4);
+}
+
+bool TelemetryReader::poll(MasterSensorData &out)
+{
+    if (!request(out))
+    {
+        return false;
+    }
+    if (sink)
+    {
+        sink->append(out);
+    }
+    return true;
+}
+
+bool TelemetryReader::request(MasterSensorData &out)
+{
+    if (link.mode() == LINK_FLATBUFFERS)
+    {
+        // Binary link: the batch is verified and read in place.
+        bool received;
+        {
+            FRANC_TIMED(STAGE_SERIAL_REQUEST);
+            received = link.request_batch(frame);
+        }
+        if (!received)
+        {
+            LOG_ERROR(logger, "SensorBatch frame missing.");
+            return false;
+        }
+        bool decoded;
+        {
+            FRANC_TIMED(STAGE_TELEMETRY_DECODE);
+            decoded = sensor_data_from_batch(frame.data(), frame.size(), out);
+        }
+        if (!decoded)
+        {
+            LOG_ERROR(logger, "SensorBatch verification failed.");
+            return false;
+        }
+        return true;
+    }
+
+    bool received;
+    {
+        FRANC_TIMED(STAGE_SERIAL_REQUEST);
+        received = link.request_json(json_msg);
+    }
+    if (!received)
+    {
+        LOG_ERROR(logger, "JSON empty.");
+        return false;
+    }
+    size_t error_offset = 0;
+    SensorJsonStatus status;
+    {
+        FRANC_TIMED(STAGE_TELEMETRY_DECODE);
+        status = sensor_data_from_json(json_msg.data(), json_msg.size(), out, &error_offset);
+    }
+    switch (status)
+    {
+    case SENSOR_JSON_OK:
+        return true;
+    case SENSOR_JSON_NOT_SENSOR:
+        LOG_INFO(logger, "JSON matching error.");
+        return false;
+    case SENSOR_JSON_MALFORMED:
+        LOG_ERROR(logger, "JSON parse error at byte {}", error_offset);
+        return false;
+    }
+    return false;
+}
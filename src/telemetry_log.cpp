@@ -0,0 +1,268 @@
+#include "telemetry_log.h"
+#include "ax25.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+TelemetryLog::TelemetryLog(quill::Logger *logger, const std::string &path, uint64_t max_bytes, int keep_files,
+                           int fsync_ms)
+    : logger(logger),
+      path(path),
+      max_bytes(std::max<uint64_t>(max_bytes, sizeof(TelemetryLogHeader) + sizeof(TelemetryRecord))),
+      keep_files(std::max(1, keep_files)),
+      fsync_ms(std::max(0, fsync_ms)),
+      next_seq(0),
+      fd(-1),
+      file_size(0),
+      dirty(false),
+      running(false)
+{
+    staging.resize(QUEUE_SIZE);
+}
+
+TelemetryLog::~TelemetryLog()
+{
+    stop();
+}
+
+bool TelemetryLog::start()
+{
+    if (running.load())
+    {
+        return true;
+    }
+    if (!open_file())
+    {
+        return false;
+    }
+    running.store(true);
+    writer = std::thread(&TelemetryLog::writer_loop, this);
+    LOG_INFO(logger, "Telemetry log: {} ({} byte records, rotating at {} bytes, {} kept)", path,
+             sizeof(TelemetryRecord), max_bytes, keep_files);
+    return true;
+}
+
+void TelemetryLog::stop()
+{
+    if (!running.exchange(false))
+    {
+        return;
+    }
+    wake.notify_one();
+    writer.join();
+    close_file();
+    LOG_INFO(logger, "Telemetry log closed: {} records written, {} dropped", written(), dropped());
+}
+
+bool TelemetryLog::append(const MasterSensorData &data)
+{
+    TelemetryRecord record;
+    std::memset(&record, 0, sizeof(record)); // padding bytes end up on disk
+    record.data = data;
+    record.header.seq = next_seq++;
+    record.header.crc = ax25_fcs(reinterpret_cast<const uint8_t *>(&record.data), sizeof(record.data));
+    record.header.unix_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::system_clock::now().time_since_epoch())
+                                .count();
+
+    if (!queue.insert(&record))
+    {
+        records_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    // unlocked notify: a wakeup lost to the race only delays the write to
+    // the next fsync_ms tick
+    wake.notify_one();
+    return true;
+}
+
+// ---------------------------------------------------------------------
+// Writer thread
+// ---------------------------------------------------------------------
+void TelemetryLog::writer_loop()
+{
+    typedef std::chrono::steady_clock Clock;
+    const auto sync_interval = std::chrono::milliseconds(std::max(1, fsync_ms));
+    Clock::time_point last_sync = Clock::now();
+
+    while (true)
+    {
+        bool stopping = !running.load();
+        if (!stopping && queue.isEmpty())
+        {
+            std::unique_lock<std::mutex> guard(wake_lock);
+            wake.wait_for(guard, sync_interval, [this]()
+                          { return !queue.isEmpty() || !running.load(); });
+        }
+
+        size_t n = queue.readBuff(staging.data(), staging.size());
+        if (n > 0 && fd >= 0)
+        {
+            // records never straddle two files
+            size_t fit = (size_t)((max_bytes - std::min(max_bytes, file_size)) / sizeof(TelemetryRecord));
+            size_t first = std::min(n, std::max<size_t>(fit, 1));
+            if (write_all(staging.data(), first * sizeof(TelemetryRecord)))
+            {
+                records_written.fetch_add(first, std::memory_order_relaxed);
+            }
+            if (first < n)
+            {
+                rotate();
+                if (fd >= 0 && write_all(staging.data() + first, (n - first) * sizeof(TelemetryRecord)))
+                {
+                    records_written.fetch_add(n - first, std::memory_order_relaxed);
+                }
+            }
+            else if (file_size >= max_bytes)
+            {
+                rotate();
+            }
+        }
+        else if (n > 0)
+        {
+            // the file could not be (re)opened; try again on the next batch
+            records_dropped.fetch_add(n, std::memory_order_relaxed);
+            open_file();
+        }
+
+        Clock::time_point now = Clock::now();
+        if (dirty && (now - last_sync >= sync_interval || fsync_ms == 0 || stopping))
+        {
+            fdatasync(fd);
+            dirty = false;
+            last_sync = now;
+        }
+
+        if (stopping && queue.isEmpty())
+        {
+            break;
+        }
+    }
+}
+
+bool TelemetryLog::write_all(const void *data, size_t size)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    while (size > 0)
+    {
+        ssize_t n = ::write(fd, p, size);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            LOG_ERROR(logger, "Telemetry log write failed: {}", strerror(errno));
+            // start over on a fresh file rather than appending after a torn record
+            close_file();
+            return false;
+        }
+        p += n;
+        size -= n;
+        file_size += n;
+        dirty = true;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------
+// Files
+// ---------------------------------------------------------------------
+bool TelemetryLog::open_file()
+{
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        LOG_ERROR(logger, "Cannot open telemetry log '{}': {}", path, strerror(errno));
+        return false;
+    }
+
+    TelemetryLogHeader expected;
+    std::memset(&expected, 0, sizeof(expected));
+    std::memcpy(expected.magic, TELEMETRY_LOG_MAGIC, sizeof(expected.magic));
+    expected.version = TELEMETRY_LOG_VERSION;
+    expected.record_size = sizeof(TelemetryRecord);
+    expected.data_size = sizeof(MasterSensorData);
+
+    struct stat st;
+    file_size = (fstat(fd, &st) == 0 ? (uint64_t)st.st_size : 0);
+    if (file_size > 0)
+    {
+        TelemetryLogHeader existing;
+        bool same = pread(fd, &existing, sizeof(existing), 0) == (ssize_t)sizeof(existing) &&
+                    std::memcmp(&existing, &expected, sizeof(expected)) == 0;
+        if (!same)
+        {
+            // other layout (or garbage): keep it, but don't mix records
+            LOG_WARNING(logger, "Telemetry log '{}' has a different layout, rotating it", path);
+            ::close(fd);
+            fd = -1;
+            rotate();
+            return fd >= 0;
+        }
+
+        // drop a record torn by a power cut so appends stay aligned
+        uint64_t whole = (file_size - sizeof(expected)) / sizeof(TelemetryRecord) * sizeof(TelemetryRecord) +
+                         sizeof(expected);
+        if (whole != file_size)
+        {
+            LOG_WARNING(logger, "Telemetry log '{}': dropping {} byte partial record", path, file_size - whole);
+            if (ftruncate(fd, whole) == 0)
+            {
+                file_size = whole;
+            }
+        }
+        if (file_size >= max_bytes)
+        {
+            ::close(fd);
+            fd = -1;
+            rotate();
+            return fd >= 0;
+        }
+        return true;
+    }
+
+    if (!write_all(&expected, sizeof(expected)))
+    {
+        return false;
+    }
+    return true;
+}
+
+void TelemetryLog::close_file()
+{
+    if (fd >= 0)
+    {
+        if (dirty)
+        {
+            fdatasync(fd);
+            dirty = false;
+        }
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void TelemetryLog::rotate()
+{
+    close_file();
+
+    // path.<keep-1> -> path.<keep>, ..., path -> path.1; the oldest is overwritten
+    for (int i = keep_files - 1; i >= 0; i--)
+    {
+        std::string from = (i == 0 ? path : path + "." + std::to_string(i));
+        std::string to = path + "." + std::to_string(i + 1);
+        if (std::rename(from.c_str(), to.c_str()) != 0 && errno != ENOENT)
+        {
+            LOG_ERROR(logger, "Telemetry log rotation {} -> {} failed: {}", from, to, strerror(errno));
+        }
+    }
+    LOG_INFO(logger, "Telemetry log rotated, {} records written so far", written());
+    open_file();
+}
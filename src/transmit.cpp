@@ -4,71 +4,216 @@
 #include <iostream>
 #include <unistd.h>
 
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "transmitter.h"
 #include "logger.h"
 #include "config.h"
+#include "instrument.h"
+
+/**
+ * @brief Set by a TX callback when it returns -1 at the end of its burst;
+ *        wakes run_burst() right away instead of on its next poll.
+ */
+struct HackRfBurstEnd
+{
+    std::atomic<bool> finished{false};
+    std::mutex lock;
+    std::condition_variable cond;
+
+    void finish()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            finished.store(true, std::memory_order_release);
+        }
+        cond.notify_all();
+    }
+};
 
 /**
- * @brief Simple context structure to hold file pointer for the TX callback.
+ * @brief Context for the in-memory TX callback.
  */
-struct HackRfTxContext
+struct HackRfStreamContext
 {
-    FILE *fp = nullptr;
+    IQStream *stream = nullptr;
+    std::atomic<size_t> underruns{0};
+    HackRfBurstEnd end; // finished when the stream was drained
 };
 
 /**
- * @brief HackRF TX callback, called repeatedly by the HackRF driver.
+ * @brief HackRF TX callback that drains an IQStream.
  *
- * Reads bytes from the file into HackRF's buffer (I/Q interleaved int8_t).
- * If EOF is reached, returns -1 to stop the stream.
+ * Copies whatever the modulator has produced so far; if it is behind, the rest
+ * of the transfer is padded with zeros (carrier with no deviation) and an
+ * underrun is counted. Returns -1 once the stream is closed and fully drained.
  */
-static int tx_callback(hackrf_transfer *transfer)
+static int tx_stream_callback(hackrf_transfer *transfer)
 {
-    // Retrieve custom context, contains the file pointer
-    HackRfTxContext *ctx = static_cast<HackRfTxContext *>(transfer->tx_ctx);
-    if (!ctx || !ctx->fp)
+    HackRfStreamContext *ctx = static_cast<HackRfStreamContext *>(transfer->tx_ctx);
+    if (!ctx || !ctx->stream)
     {
-        // Fill with zeros in case the buffer doesn't exist
         std::memset(transfer->buffer, 0, transfer->buffer_length);
         return 0;
     }
 
-    // Read exactly 'transfer->buffer_length' bytes (which is typically 262,144).
-    size_t nread = std::fread(transfer->buffer, 1, transfer->buffer_length, ctx->fp);
-
-    if (nread < transfer->buffer_length)
+    const size_t wanted = transfer->buffer_length;
+    size_t nread = ctx->stream->read(reinterpret_cast<int8_t *>(transfer->buffer), wanted);
+    if (nread < wanted)
     {
-        // We hit EOF (or an error). Fill remainder with zeros.
-        if (std::feof(ctx->fp))
+        std::memset(transfer->buffer + nread, 0, wanted - nread);
+        if (ctx->stream->drained())
         {
-            std::memset(transfer->buffer + nread, 0, transfer->buffer_length - nread);
-            // Return -1 to signal the HackRF library that we want to stop transmission.
+            ctx->end.finish();
             return -1;
         }
-        else
+        if (ctx->stream->aborted())
         {
-            // A read error occurred; also stop streaming.
             return -1;
         }
+        ctx->underruns.fetch_add(1, std::memory_order_relaxed);
     }
+    return 0;
+}
+
+/**
+ * @brief Context for the TX callback that sends a finished burst from memory.
+ */
+struct HackRfBufferContext
+{
+    const int8_t *data = nullptr;
+    size_t size = 0;
+    size_t offset = 0;
+    HackRfBurstEnd end; // finished when the whole burst was handed over
+};
 
-    // Returning 0 means "keep streaming."
+static int tx_buffer_callback(hackrf_transfer *transfer)
+{
+    HackRfBufferContext *ctx = static_cast<HackRfBufferContext *>(transfer->tx_ctx);
+    const size_t wanted = transfer->buffer_length;
+    size_t n = 0;
+    if (ctx && ctx->data)
+    {
+        n = std::min(wanted, ctx->size - ctx->offset);
+        std::memcpy(transfer->buffer, ctx->data + ctx->offset, n);
+        ctx->offset += n;
+    }
+    if (n < wanted)
+    {
+        std::memset(transfer->buffer + n, 0, wanted - n);
+        if (ctx)
+        {
+            ctx->end.finish();
+        }
+        return -1;
+    }
     return 0;
 }
 
 /**
- * @brief Transmits a .s8 file (I/Q interleaved, signed 8-bit) using HackRF at:
- *        - Frequency:  144.39 MHz
- *        - SampleRate: 2.4 MSPS
- *        - Amplifier:  enabled (gain stage)
- *        - TX VGA gain: 40
- *
- * @param filename path to the s8 file
- * @return true on success, false otherwise
+ * @brief Context for the TX callback of transmit_source().
  */
-bool transmit_s8_iq_file(const std::string &filename, quill::Logger *logger, Config config)
+struct HackRfSourceContext
+{
+    const HackRfTransmitter::TxSource *fill = nullptr;
+    HackRfBurstEnd end; // finished when the source ended the session
+};
+
+static int tx_source_callback(hackrf_transfer *transfer)
 {
-    hackrf_device *device = nullptr;
+    HackRfSourceContext *ctx = static_cast<HackRfSourceContext *>(transfer->tx_ctx);
+    if (!ctx || !ctx->fill)
+    {
+        std::memset(transfer->buffer, 0, transfer->buffer_length);
+        return 0;
+    }
+    if (!(*ctx->fill)(reinterpret_cast<int8_t *>(transfer->buffer), transfer->buffer_length))
+    {
+        ctx->end.finish();
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief True for errors after which the device handle is no longer usable
+ *        and the USB session has to be rebuilt.
+ */
+static bool is_usb_error(int result)
+{
+    return result == HACKRF_ERROR_LIBUSB ||
+           result == HACKRF_ERROR_NOT_FOUND ||
+           result == HACKRF_ERROR_BUSY ||
+           result == HACKRF_ERROR_STREAMING_THREAD_ERR ||
+           result == HACKRF_ERROR_OTHER;
+}
+
+HackRfTransmitter::HackRfTransmitter(quill::Logger *logger)
+    : logger(logger), device(nullptr), frequency(0), sampleRate(0), amplifier(0), txvga_gain(0),
+      update_pending(false), next_frequency(0), next_amplifier(0), next_txvga_gain(0), total_underruns(0)
+{
+}
+
+HackRfTransmitter::~HackRfTransmitter()
+{
+    close();
+}
+
+bool HackRfTransmitter::open(const Config &config)
+{
+    frequency = config.frequency;
+    sampleRate = config.sampleRate;
+    amplifier = config.amplifier;
+    txvga_gain = config.txvga_gain;
+    return reopen();
+}
+
+void HackRfTransmitter::update(const Config &config)
+{
+    std::lock_guard<std::mutex> guard(update_lock);
+    next_frequency = config.frequency;
+    next_amplifier = config.amplifier;
+    next_txvga_gain = config.txvga_gain;
+    update_pending = true;
+}
+
+bool HackRfTransmitter::take_update()
+{
+    std::lock_guard<std::mutex> guard(update_lock);
+    if (!update_pending)
+    {
+        return false;
+    }
+    update_pending = false;
+    if (next_frequency == frequency && next_amplifier == amplifier && next_txvga_gain == txvga_gain)
+    {
+        return false;
+    }
+    frequency = next_frequency;
+    amplifier = next_amplifier;
+    txvga_gain = next_txvga_gain;
+    return true;
+}
+
+void HackRfTransmitter::close()
+{
+    if (device)
+    {
+        hackrf_close(device);
+        hackrf_exit();
+        device = nullptr;
+    }
+}
+
+bool HackRfTransmitter::reopen()
+{
+    close();
 
     // 1. Initialize HackRF
     int result = hackrf_init();
@@ -83,54 +228,58 @@ bool transmit_s8_iq_file(const std::string &filename, quill::Logger *logger, Con
     if (result != HACKRF_SUCCESS)
     {
         LOG_CRITICAL(logger, "hackrf_open() failed: {}", hackrf_error_name((hackrf_error)result));
+        device = nullptr;
         hackrf_exit();
         return false;
     }
 
+    if (!configure())
+    {
+        close();
+        return false;
+    }
+
+    LOG_INFO(logger, "HackRF opened: {} Hz, {} S/s", frequency, sampleRate);
+    return true;
+}
+
+bool HackRfTransmitter::configure()
+{
     // 3. Set frequency (144.390 MHz)
-    const uint64_t freq_hz = config.frequency;
+    const uint64_t freq_hz = frequency;
     LOG_DEBUG(logger, "Frequency set: {}", freq_hz);
-    result = hackrf_set_freq(device, freq_hz);
+    int result = hackrf_set_freq(device, freq_hz);
     if (result != HACKRF_SUCCESS)
     {
         LOG_CRITICAL(logger, "hackrf_set_freq() failed: {}", hackrf_error_name((hackrf_error)result));
-        hackrf_close(device);
-        hackrf_exit();
         return false;
     }
 
-    // 4. Set sample rate (2.4 MSPS)
-    const double sample_rate_hz = config.sampleRate;
+    // 4. Set sample rate (the modulator resamples to the same config.sampleRate)
+    const double sample_rate_hz = sampleRate;
     LOG_DEBUG(logger, "Sample rate set: {}", sample_rate_hz);
     result = hackrf_set_sample_rate(device, sample_rate_hz);
     if (result != HACKRF_SUCCESS)
     {
         LOG_CRITICAL(logger, "hackrf_set_sample_rate() failed: {}", hackrf_error_name((hackrf_error)result));
-        hackrf_close(device);
-        hackrf_exit();
         return false;
     }
 
     // 5. Enable amplifier (-a 1)
-    result = hackrf_set_amp_enable(device, config.amplifier);
+    result = hackrf_set_amp_enable(device, amplifier);
     LOG_DEBUG(logger, "Amplifier enable: {}", result);
     if (result != HACKRF_SUCCESS)
     {
         LOG_CRITICAL(logger, "hackrf_set_amp_enable(): {}", hackrf_error_name((hackrf_error)result));
-        hackrf_close(device);
-        hackrf_exit();
         return false;
     }
 
     // 6. Set TX VGA gain to 40 (-x 40)
-    const int txvga_gain = config.txvga_gain;
     LOG_DEBUG(logger, "Internal gain set: {}", txvga_gain);
     result = hackrf_set_txvga_gain(device, txvga_gain);
     if (result != HACKRF_SUCCESS)
     {
         LOG_CRITICAL(logger, "hackrf_set_txvga_gain(): {}", hackrf_error_name((hackrf_error)result));
-        hackrf_close(device);
-        hackrf_exit();
         return false;
     }
 
@@ -138,54 +287,212 @@ bool transmit_s8_iq_file(const std::string &filename, quill::Logger *logger, Con
     // hackrf_set_lna_gain(device, 8); // Example
     // hackrf_set_baseband_filter_bandwidth(device, 1750000); // Example
 
-    // 7. Open the .s8 file
-    FILE *fp = std::fopen(filename.c_str(), "rb");
-    if (!fp)
+    return true;
+}
+
+bool HackRfTransmitter::run_burst(hackrf_sample_block_cb_fn callback, void *ctx, HackRfBurstEnd &end)
+{
+    FRANC_TIMED(STAGE_TRANSMIT);
+
+    // Settings from a config reload; a failure leaves the device to be reopened below.
+    if (take_update() && device)
     {
-        LOG_CRITICAL(logger, "Failed to open file: {}", filename);
-        hackrf_close(device);
-        hackrf_exit();
-        return false;
+        LOG_INFO(logger, "HackRF retuned: {} Hz, amp {}, TX VGA {} dB", frequency, amplifier, txvga_gain);
+        if (!configure())
+        {
+            close();
+        }
     }
 
-    // 8. Prepare context (pass file pointer to callback)
-    HackRfTxContext ctx;
-    ctx.fp = fp;
+    // A previous burst may have dropped the device after a USB error.
+    if (!device && !reopen())
+    {
+        return false;
+    }
 
-    // 9. Start TX streaming
-    result = hackrf_start_tx(device, tx_callback, &ctx);
+    int result = hackrf_start_tx(device, callback, ctx);
+    if (result != HACKRF_SUCCESS && is_usb_error(result))
+    {
+        // Nothing has been consumed yet, so one retry on a fresh session is safe.
+        LOG_WARNING(logger, "hackrf_start_tx() failed: {}; reopening device",
+                    hackrf_error_name((hackrf_error)result));
+        if (!reopen())
+        {
+            return false;
+        }
+        result = hackrf_start_tx(device, callback, ctx);
+    }
     if (result != HACKRF_SUCCESS)
     {
         LOG_CRITICAL(logger, "hackrf_start_tx() failed: {}", hackrf_error_name((hackrf_error)result));
-        std::fclose(fp);
-        hackrf_close(device);
-        hackrf_exit();
         return false;
     }
 
-    // 10. Wait until streaming stops (callback returns -1 at EOF).
-    while (hackrf_is_streaming(device) == HACKRF_TRUE)
+    // Wait until the callback signals the end of the burst; the streaming
+    // state is only polled to notice a transfer thread that died.
     {
-        // Sleep briefly so we don't busy-wait.
-        usleep(50000); // 50 ms
+        std::unique_lock<std::mutex> guard(end.lock);
+        while (!end.finished.load(std::memory_order_acquire) && hackrf_is_streaming(device) == HACKRF_TRUE)
+        {
+            end.cond.wait_for(guard, std::chrono::milliseconds(HACKRF_STREAM_CHECK_MS));
+        }
     }
 
-    // 11. Cleanly stop TX
+    // Cleanly stop TX, leaving the device open and tuned for the next burst.
     result = hackrf_stop_tx(device);
     if (result != HACKRF_SUCCESS)
     {
         LOG_CRITICAL(logger, "hackrf_stop_tx() failed: {}", hackrf_error_name((hackrf_error)result));
-        std::fclose(fp);
-        hackrf_close(device);
-        hackrf_exit();
+        close(); // reopened on the next burst
+        return false;
+    }
+
+    if (!end.finished.load(std::memory_order_acquire))
+    {
+        // Streaming ended without the callback asking for it: the transfer
+        // thread died (USB error, device unplugged, ...).
+        LOG_ERROR(logger, "HackRF streaming stopped unexpectedly; device will be reopened");
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool HackRfTransmitter::transmit_file(const std::string &filename)
+{
+    // Open the .s8 file
+    FILE *fp = std::fopen(filename.c_str(), "rb");
+    if (!fp)
+    {
+        LOG_CRITICAL(logger, "Failed to open file: {}", filename);
         return false;
     }
 
-    // 12. Cleanup
+    // The file is read ahead into the IQ stream by its own thread, so the
+    // USB callback only copies from memory and a slow read shows up as an
+    // underrun instead of stalling the transfer thread.
+    if (!file_stream)
+    {
+        file_stream.reset(new IQStream());
+    }
+    IQStream &stream = *file_stream;
+    stream.reset();
+    bool read_error = false;
+    std::thread reader([fp, &stream, &read_error]()
+                       {
+                           std::vector<int8_t> chunk(HACKRF_TRANSFER_SIZE);
+                           size_t n;
+                           while ((n = std::fread(chunk.data(), 1, chunk.size(), fp)) > 0)
+                           {
+                               if (stream.write(chunk.data(), n) < n)
+                               {
+                                   break; // TX gave up
+                               }
+                           }
+                           // what was read still goes out; the burst ends normally
+                           read_error = std::ferror(fp) != 0;
+                           stream.close(); });
+
+    bool success = transmit_stream(stream);
+    reader.join();
     std::fclose(fp);
-    hackrf_close(device);
-    hackrf_exit();
 
-    LOG_INFO(logger, "Finished transmitting: {}", filename);
-    return true;
+    if (read_error)
+    {
+        LOG_ERROR(logger, "Read error on {}, burst was cut short", filename);
+        success = false;
+    }
+    if (success)
+    {
+        LOG_INFO(logger, "Finished transmitting: {}", filename);
+    }
+    return success;
+}
+
+bool HackRfTransmitter::transmit_stream(IQStream &stream)
+{
+    if (!device && !reopen())
+    {
+        stream.abort();
+        return false;
+    }
+
+    // Let the modulator get one USB transfer ahead so the first callbacks
+    // don't underrun (or the whole packet, if it is shorter than that).
+    const size_t prefill = HACKRF_TRANSFER_SIZE;
+    while (stream.available() < prefill && !stream.closed() && !stream.aborted())
+    {
+        usleep(1000);
+    }
+
+    HackRfStreamContext ctx;
+    ctx.stream = &stream;
+
+    bool success = run_burst(tx_stream_callback, &ctx, ctx.end);
+    // The callback is gone now; make sure the producer can't block forever.
+    stream.abort();
+
+    size_t underruns = ctx.underruns.load(std::memory_order_relaxed);
+    total_underruns += underruns;
+    if (underruns > 0)
+    {
+        LOG_WARNING(logger, "TX stream underran {} time(s), {} since start", underruns, total_underruns);
+    }
+    if (success)
+    {
+        LOG_INFO(logger, "Finished transmitting in-memory stream");
+    }
+    return success;
+}
+
+bool HackRfTransmitter::transmit_buffer(const int8_t *data, size_t size)
+{
+    HackRfBufferContext ctx;
+    ctx.data = data;
+    ctx.size = size;
+
+    bool success = run_burst(tx_buffer_callback, &ctx, ctx.end);
+    if (success)
+    {
+        LOG_INFO(logger, "Finished transmitting {} byte burst", size);
+    }
+    return success;
+}
+
+bool HackRfTransmitter::transmit_source(const TxSource &fill)
+{
+    HackRfSourceContext ctx;
+    ctx.fill = &fill;
+    return run_burst(tx_source_callback, &ctx, ctx.end);
+}
+
+/**
+ * @brief Transmits a .s8 file (I/Q interleaved, signed 8-bit) using HackRF at:
+ *        - Frequency:  144.39 MHz
+ *        - SampleRate: config.sampleRate (2.4 MSPS in config.cfg)
+ *        - Amplifier:  enabled (gain stage)
+ *        - TX VGA gain: 40
+ *
+ * @param filename path to the s8 file
+ * @return true on success, false otherwise
+ */
+bool transmit_s8_iq_file(const std::string &filename, quill::Logger *logger, const Config &config)
+{
+    HackRfTransmitter transmitter(logger);
+    if (!transmitter.open(config))
+    {
+        return false;
+    }
+    return transmitter.transmit_file(filename);
+}
+
+bool transmit_s8_iq_stream(IQStream &stream, quill::Logger *logger, const Config &config)
+{
+    HackRfTransmitter transmitter(logger);
+    if (!transmitter.open(config))
+    {
+        stream.abort();
+        return false;
+    }
+    return transmitter.transmit_stream(stream);
 }
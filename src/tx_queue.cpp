@@ -0,0 +1,199 @@
+#include "tx_queue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+TxQueue::TxQueue(quill::Logger *logger, HackRfTransmitter &transmitter, int idle_ms)
+    : logger(logger),
+      transmitter(transmitter),
+      idle_ms(std::max(0, idle_ms)),
+      idle_limit(0),
+      next_ticket(1),
+      forgotten(0),
+      stopping(false),
+      current_offset(0),
+      have_current(false),
+      idle_bytes(0),
+      session_count(0),
+      packet_count(0)
+{
+    session_thread = std::thread(&TxQueue::session_loop, this);
+}
+
+TxQueue::~TxQueue()
+{
+    stop();
+}
+
+uint64_t TxQueue::submit(const int8_t *data, size_t size)
+{
+    Packet packet;
+    packet.iq.assign(data, data + size);
+
+    uint64_t ticket;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ticket = next_ticket++;
+        packet.ticket = ticket;
+        outstanding.insert(ticket);
+        if (stopping)
+        {
+            complete(ticket, false);
+            return ticket;
+        }
+        pending.push_back(std::move(packet));
+    }
+    queued.notify_one();
+    return ticket;
+}
+
+bool TxQueue::wait(uint64_t ticket)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    done.wait(guard, [&]()
+              { return outstanding.count(ticket) == 0; });
+    return failed.erase(ticket) == 0 && ticket > forgotten;
+}
+
+void TxQueue::stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    queued.notify_one();
+    if (session_thread.joinable())
+    {
+        session_thread.join();
+    }
+}
+
+uint64_t TxQueue::sessions() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return session_count;
+}
+
+uint64_t TxQueue::packets() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return packet_count;
+}
+
+void TxQueue::complete(uint64_t ticket, bool sent)
+{
+    outstanding.erase(ticket);
+    if (!sent)
+    {
+        failed.insert(ticket);
+    }
+    else
+    {
+        packet_count++;
+    }
+    if (ticket > TX_RESULTS_KEPT && ticket - TX_RESULTS_KEPT > forgotten)
+    {
+        forgotten = ticket - TX_RESULTS_KEPT;
+        failed.erase(failed.begin(), failed.upper_bound(forgotten));
+    }
+    done.notify_all();
+}
+
+void TxQueue::session_loop()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            queued.wait(guard, [this]()
+                        { return !pending.empty() || stopping; });
+            if (pending.empty())
+            {
+                return; // stopping with nothing left to send
+            }
+            session_count++;
+        }
+
+        // the rate is only known once the transmitter was opened
+        idle_limit = 2 * (size_t)std::llround(transmitter.sample_rate() * idle_ms / 1000.0);
+        idle_bytes = 0;
+        have_current = false;
+
+        auto start = std::chrono::steady_clock::now();
+        bool ok = transmitter.transmit_source([this](int8_t *buffer, size_t size)
+                                              { return fill(buffer, size); });
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+        std::lock_guard<std::mutex> guard(lock);
+        if (!ok)
+        {
+            // the packet on air is lost, and with the device gone so is the rest
+            size_t dropped = pending.size() + (have_current ? 1 : 0);
+            if (have_current)
+            {
+                complete(current.ticket, false);
+                have_current = false;
+            }
+            while (!pending.empty())
+            {
+                complete(pending.front().ticket, false);
+                pending.pop_front();
+            }
+            LOG_ERROR(logger, "TX session failed after {} ms, {} packet(s) dropped", ms.count(), dropped);
+        }
+        else
+        {
+            LOG_DEBUG(logger, "TX session {} ended after {} ms idle ({} ms on air)", session_count, idle_ms,
+                      ms.count());
+        }
+    }
+}
+
+bool TxQueue::fill(int8_t *buffer, size_t size)
+{
+    size_t offset = 0;
+    while (offset < size)
+    {
+        if (!have_current)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (pending.empty())
+            {
+                break;
+            }
+            current = std::move(pending.front());
+            pending.pop_front();
+            current_offset = 0;
+            have_current = true;
+        }
+
+        size_t n = std::min(size - offset, current.iq.size() - current_offset);
+        std::memcpy(buffer + offset, current.iq.data() + current_offset, n);
+        offset += n;
+        current_offset += n;
+        if (current_offset == current.iq.size())
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            complete(current.ticket, true);
+            have_current = false;
+        }
+    }
+
+    if (offset > 0)
+    {
+        idle_bytes = 0;
+    }
+    if (offset < size)
+    {
+        // queue ran dry: zero amplitude until the next packet or the idle timeout
+        std::memset(buffer + offset, 0, size - offset);
+        idle_bytes += size - offset;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    bool idle = !have_current && pending.empty();
+    return !(idle && (idle_bytes >= idle_limit || stopping));
+}